@@ -13,11 +13,15 @@ Function : Operation for SI446x
 #include <math.h>
 #include <stdint.h>
 
+#ifdef SI446X_SIM
+#include "si446x_sim.h"     //host build, radio and board simulated
+#else
 #include "inc/hw_memmap.h"
 #include "driverlib/gpio.h"
 #include "driverlib/sysctl.h"
 #include "utils/uartstdio.h"
 #include "drivers/spi0.h"
+#endif
 
 
 /*Data type definations*/
@@ -27,6 +31,7 @@ typedef uint16_t INT16U;
 typedef int16_t  INT16S;
 typedef uint32_t INT32U;
 typedef int32_t  INT32S;
+typedef uint64_t INT64U;
 typedef enum
 {
 	BOOL_FALSE = 0,
@@ -52,12 +57,126 @@ typedef enum
 /*Exchange a byte via the SPI bus*/
 INT8U SPI_ExchangeByte( INT8U input );
 
+/*Completion callback of a block transfer, called from the SSI interrupt*/
+typedef void ( *SPI_BLOCK_CALLBACK )( void );
+
+/*Exchange a block of bytes via the SPI bus, uDMA driven*/
+void SPI_ExchangeBlock( const INT8U *txbuf, INT8U *rxbuf, INT16U size,
+                        SPI_BLOCK_CALLBACK callback );
+
+/*nIRQ handler of a radio bus, arg as given to Si4463_BUS_IRQ_INIT*/
+typedef void ( *SI4463_BUS_CALLBACK )( void *arg );
+
+/*Peripherals and pins of one radio. CTS and nIRQ share one GPIO port*/
+typedef struct
+{
+    INT32U ssi_base;            //SSI module of the SPI bus
+    INT32U ssi_int;             //its NVIC interrupt
+    INT32U dma_rx;              //its uDMA channels
+    INT32U dma_tx;
+    INT32U csn_port;            //0: chip select driven by the SPI0 driver
+    INT8U  csn_pin;
+    INT32U sdn_port;
+    INT8U  sdn_pin;
+    INT32U cts_port;            //CTS and nIRQ
+    INT8U  cts_pin;
+    INT8U  irq_pin;
+    INT32U gpio_int;            //NVIC interrupt of cts_port
+}SI4463_PINS;
+
+/*One radio bus: its pins and the board state that goes with them*/
+typedef struct
+{
+    const SI4463_PINS *pins;
+    volatile BOOLEAN cts_edge;          //CTS rising edge seen since the last idle
+    volatile BOOLEAN dma_busy;          //block transfer in flight
+    SPI_BLOCK_CALLBACK dma_callback;
+    SI4463_BUS_CALLBACK irq_callback;
+    void *irq_arg;
+}SI4463_BUS;
+
+/*The radio on SPI0 and port G, which the functions without a bus use*/
+extern SI4463_BUS g_sSi4463Bus0;
+
+#ifdef SI446X_SIM
+/*Bus wired to one simulated radio, bus 0 follows SI446X_SIM_SELECT( )*/
+SI4463_BUS *SI446X_SIM_BUS( uint8_t radio );
+#endif
+
+/*Set up the SSI, uDMA and GPIOs of a bus; the pin mux is left to the caller*/
+void Si4463_BUS_INIT( SI4463_BUS *bus );
+
+/*Exchange a byte, or a block, on the SPI bus of a radio*/
+INT8U Si4463_BUS_BYTE( SI4463_BUS *bus, INT8U input );
+void Si4463_BUS_BLOCK( SI4463_BUS *bus, const INT8U *txbuf, INT8U *rxbuf, INT16U size,
+                       SPI_BLOCK_CALLBACK callback );
+
+/*Wait for the block started with a callback to end*/
+void Si4463_BUS_WAIT( SI4463_BUS *bus );
+
+/*Drive the chip select and the shutdown pin of a radio*/
+void Si4463_BUS_CSN( SI4463_BUS *bus, BOOLEAN high );
+void Si4463_BUS_SDN( SI4463_BUS *bus, BOOLEAN high );
+
+/*Level of the CTS pin of a radio*/
+BOOLEAN Si4463_BUS_CTS( SI4463_BUS *bus );
+
+/*Idle until the CTS edge of a radio or any other interrupt arrives*/
+void Si4463_BUS_CTS_IDLE( SI4463_BUS *bus );
+
+/*Idle until the nIRQ handler of a radio sets *events or any other interrupt arrives*/
+void Si4463_BUS_IRQ_IDLE( SI4463_BUS *bus, volatile const INT8U *events );
+
+/*Route the nIRQ falling edge of a radio to callback, NULL disables it*/
+void Si4463_BUS_IRQ_INIT( SI4463_BUS *bus, SI4463_BUS_CALLBACK callback, void *arg );
+
+/*Mask or unmask the nIRQ interrupt of a radio*/
+void Si4463_BUS_IRQ_MASK( SI4463_BUS *bus, BOOLEAN mask );
+
+/*GPIO port and SSI interrupt handlers of a radio, for its vector table entries*/
+void Si4463_BUS_GPIO_IntHandler( SI4463_BUS *bus );
+void Si4463_BUS_SSI_IntHandler( SI4463_BUS *bus );
+
+/*Initialize the uDMA channels of the SPI bus*/
+void Si4463_DMA_INIT( void );
+
+/*SSI interrupt handler, signals the end of a block transfer*/
+void Si4463_SSI_IntHandler( void );
+
 /*Initialize the SPI bus*/
 void Si4463_SPI_INIT( void );
 
 /*Initialize the other GPIOs of the board*/
 void Si4463_GPIO_INIT( void );
 
+/*GPIO port interrupt handler, CTS rising edge*/
+void Si4463_GPIO_IntHandler( void );
+
+/*nIRQ handler, called from the GPIO port interrupt on the falling edge*/
+typedef void ( *SI4463_IRQ_CALLBACK )( void );
+
+/*Route the nIRQ falling edge to callback, NULL disables it*/
+void Si4463_IRQ_INIT( SI4463_IRQ_CALLBACK callback );
+
+/*Mask or unmask the nIRQ interrupt, edges seen while masked stay pending*/
+void Si4463_IRQ_MASK( BOOLEAN mask );
+
+/*Idle until the CTS edge or any other interrupt arrives*/
+void Si4463_CTS_IDLE( void );
+
+/*Enable the free running cycle counter*/
+void Si4463_CYCLES_INIT( void );
+
+/*Read the free running cycle counter, DWT CYCCNT*/
+#ifdef SI446X_SIM
+#define Si4463_CYCLES( )    SI446X_SIM_CYCLES( )
+#else
+#define Si4463_CYCLES( )    ( *( volatile INT32U * )0xE0001004 )
+#endif
+
+#define SI4463_CSN_PORT	0       //SPI0_nss_set( ) and SPI0_nss_clear( )
+#define SI4463_CSN_PIN	0
+
 #define SI4463_IRQ_PORT	GPIO_PORTG_BASE
 #define SI4463_IRQ_PIN	GPIO_PIN_0
 
@@ -67,6 +186,23 @@ void Si4463_GPIO_INIT( void );
 #define SI4463_CTS_PORT	GPIO_PORTG_BASE
 #define SI4463_CTS_PIN	GPIO_PIN_3
 
+#define SI4463_GPIO_INT	INT_GPIOG
+
+/*1: sleep with WFI while the radio is busy, a periodic interrupt (SysTick)
+  must be running so the CTS timeout is still checked. 0: spin on the flag*/
+#define SI4463_CTS_SLEEP	1
+
+/*SSI module behind SPI0 and its uDMA channels*/
+#define SI4463_SSI_BASE	SSI0_BASE
+#define SI4463_SSI_INT	INT_SSI0
+#define SI4463_DMA_RX	UDMA_CH10_SSI0RX
+#define SI4463_DMA_TX	UDMA_CH11_SSI0TX
+
+/*Blocks shorter than this are cheaper to send with SPI_ExchangeByte( )*/
+#define SPI_DMA_MIN_BLOCK	8
+/*Maximum items of a single uDMA basic mode transfer*/
+#define SPI_DMA_MAX_BLOCK	1024
+
 #endif //_BOARD_H_
 /*
 =================================================================================
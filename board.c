@@ -4,7 +4,49 @@ Function : Operation for SI446x
 ================================================================================
 */
 #include "board.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_nvic.h"
+#include "inc/hw_ssi.h"
+#include "inc/hw_types.h"
+#include "driverlib/cpu.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/ssi.h"
+#include "driverlib/udma.h"
 
+extern uint32_t g_ui32SysClock;
+
+/*uDMA channel control table, the controller needs it 1024 bytes aligned*/
+#if defined(ewarm)
+#pragma data_alignment=1024
+static tDMAControlTable g_psDMAControlTable[64];
+#elif defined(ccs)
+#pragma DATA_ALIGN(g_psDMAControlTable, 1024)
+static tDMAControlTable g_psDMAControlTable[64];
+#else
+static tDMAControlTable g_psDMAControlTable[64] __attribute__ ((aligned(1024)));
+#endif
+
+/*Dummy source/sink for transfers which only read or only write*/
+static INT8U g_ui8DMADummyTx = 0xFF;
+static INT8U g_ui8DMADummyRx;
+
+/*Pins of the radio on SPI0 and port G*/
+static const SI4463_PINS g_sSi4463Pins0 =
+{
+    SI4463_SSI_BASE, SI4463_SSI_INT, SI4463_DMA_RX, SI4463_DMA_TX,
+    SI4463_CSN_PORT, SI4463_CSN_PIN,
+    SI4463_SDN_PORT, SI4463_SDN_PIN,
+    SI4463_CTS_PORT, SI4463_CTS_PIN, SI4463_IRQ_PIN,
+    SI4463_GPIO_INT
+};
+
+SI4463_BUS g_sSi4463Bus0 = { &g_sSi4463Pins0, BOOL_FALSE, BOOL_FALSE, NULL, NULL, NULL };
+
+/*nIRQ handler given to Si4463_IRQ_INIT( )*/
+static SI4463_IRQ_CALLBACK g_pfnIrqCallback;
+
+static void Si4463_DMA_CHANNELS( SI4463_BUS *bus );
+static void Si4463_BUS_GPIO( SI4463_BUS *bus );
 
 /*
 =================================================================================
@@ -29,6 +71,74 @@ OUTPUT   : None
 void Si4463_SPI_INIT( void )
 {
 	SPI0_init(8000000);
+	Si4463_DMA_INIT( );
+}
+/*
+=================================================================================
+Si4463_DMA_INIT( );
+Function : Initialize the uDMA channels of the SPI bus
+INTPUT   : None
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_DMA_INIT( void )
+{
+    Si4463_DMA_CHANNELS( &g_sSi4463Bus0 );
+}
+/*
+=================================================================================
+Si4463_DMA_CHANNELS( );
+Function : Initialize the uDMA controller once, and the channels of a bus
+INTPUT   : bus, the radio bus
+OUTPUT   : None
+=================================================================================
+*/
+static void Si4463_DMA_CHANNELS( SI4463_BUS *bus )
+{
+    const SI4463_PINS *pins = bus->pins;
+
+    if( !uDMAControlBaseGet( ) )
+    {
+        SysCtlPeripheralEnable( SYSCTL_PERIPH_UDMA );
+        uDMAEnable( );
+        uDMAControlBaseSet( g_psDMAControlTable );
+    }
+
+    uDMAChannelAssign( pins->dma_rx );
+    uDMAChannelAssign( pins->dma_tx );
+    uDMAChannelAttributeDisable( pins->dma_rx, UDMA_ATTR_ALL );
+    uDMAChannelAttributeDisable( pins->dma_tx, UDMA_ATTR_ALL );
+    // RX must win arbitration, or the 8 entry SSI RX FIFO overflows
+    uDMAChannelAttributeEnable( pins->dma_rx, UDMA_ATTR_HIGH_PRIORITY );
+
+    // The SSI raises DMARX once the RX channel has stored the last byte
+    SSIIntEnable( pins->ssi_base, SSI_DMARX );
+    IntEnable( pins->ssi_int );
+}
+/*
+=================================================================================
+SPI_ExchangeBlock( );
+Function : Exchange a block of bytes via the SPI bus of the radio on SPI0
+INTPUT   : see Si4463_BUS_BLOCK( )
+OUTPUT   : None
+=================================================================================
+*/
+void SPI_ExchangeBlock( const INT8U *txbuf, INT8U *rxbuf, INT16U size,
+                        SPI_BLOCK_CALLBACK callback )
+{
+    Si4463_BUS_BLOCK( &g_sSi4463Bus0, txbuf, rxbuf, size, callback );
+}
+/*
+=================================================================================
+Si4463_SSI_IntHandler( );
+Function : Called by the NVIC as a result of the SSI0 interrupt
+INTPUT   : None
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_SSI_IntHandler( void )
+{
+    Si4463_BUS_SSI_IntHandler( &g_sSi4463Bus0 );
 }
 /*
 =================================================================================
@@ -40,8 +150,439 @@ OUTPUT   : None
 */
 void Si4463_GPIO_INIT( void )
 {
-    GPIOPinTypeGPIOOutput(SI4463_SDN_PORT, SI4463_SDN_PIN);
-    GPIOPinTypeGPIOInput(SI4463_CTS_PORT, SI4463_CTS_PIN);
+    Si4463_BUS_GPIO( &g_sSi4463Bus0 );
+    Si4463_CYCLES_INIT( );
+}
+/*
+=================================================================================
+Si4463_GPIO_IntHandler( );
+Function : Called by the NVIC as a result of the GPIO port G interrupt
+INTPUT   : None
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_GPIO_IntHandler( void )
+{
+    Si4463_BUS_GPIO_IntHandler( &g_sSi4463Bus0 );
+}
+/*
+=================================================================================
+Si4463_IRQ_INIT( );
+Function : Route the nIRQ falling edge of the radio on SPI0 to a handler
+INTPUT   : callback, the handler, NULL disables the interrupt
+OUTPUT   : None
+=================================================================================
+*/
+static void Si4463_IRQ_CALL( void *arg )
+{
+    g_pfnIrqCallback( );
+}
+void Si4463_IRQ_INIT( SI4463_IRQ_CALLBACK callback )
+{
+    g_pfnIrqCallback = callback;
+    Si4463_BUS_IRQ_INIT( &g_sSi4463Bus0, callback ? Si4463_IRQ_CALL : NULL, NULL );
+}
+/*
+=================================================================================
+Si4463_IRQ_MASK( );
+Function : Mask the nIRQ interrupt of the radio on SPI0
+INTPUT   : mask, BOOL_TRUE to mask
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_IRQ_MASK( BOOLEAN mask )
+{
+    Si4463_BUS_IRQ_MASK( &g_sSi4463Bus0, mask );
+}
+/*
+=================================================================================
+Si4463_CTS_IDLE( );
+Function : Idle until the CTS edge of the radio on SPI0 or any other interrupt
+INTPUT   : None
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_CTS_IDLE( void )
+{
+    Si4463_BUS_CTS_IDLE( &g_sSi4463Bus0 );
+}
+/*
+=================================================================================
+Si4463_BUS_INIT( );
+Function : Set up a radio bus other than the one on SPI0: SSI as an 8 MHz
+           master, its uDMA channels, chip select, SDN, CTS and the port
+           interrupt. Peripheral clocks and the pin mux are left to the caller.
+INTPUT   : bus, the radio bus
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_INIT( SI4463_BUS *bus )
+{
+    const SI4463_PINS *pins = bus->pins;
+
+    SSIDisable( pins->ssi_base );
+    SSIConfigSetExpClk( pins->ssi_base, g_ui32SysClock, SSI_FRF_MOTO_MODE_0,
+                        SSI_MODE_MASTER, 8000000, 8 );
+    SSIEnable( pins->ssi_base );
+    Si4463_DMA_CHANNELS( bus );
+
+    if( pins->csn_port )
+    {
+        GPIOPinTypeGPIOOutput( pins->csn_port, pins->csn_pin );
+        GPIOPinWrite( pins->csn_port, pins->csn_pin, pins->csn_pin );
+    }
+    Si4463_BUS_GPIO( bus );
+}
+/*
+=================================================================================
+Si4463_BUS_GPIO( );
+Function : SDN output, CTS input with its rising edge interrupt
+INTPUT   : bus, the radio bus
+OUTPUT   : None
+=================================================================================
+*/
+static void Si4463_BUS_GPIO( SI4463_BUS *bus )
+{
+    const SI4463_PINS *pins = bus->pins;
+
+    GPIOPinTypeGPIOOutput(pins->sdn_port, pins->sdn_pin);
+    GPIOPinTypeGPIOInput(pins->cts_port, pins->cts_pin);
+
+    // CTS goes high when the radio is ready for the next command
+    GPIOIntTypeSet(pins->cts_port, pins->cts_pin, GPIO_RISING_EDGE);
+    GPIOIntClear(pins->cts_port, pins->cts_pin);
+    GPIOIntEnable(pins->cts_port, pins->cts_pin);
+    IntEnable(pins->gpio_int);
+}
+/*
+=================================================================================
+Si4463_BUS_BYTE( );
+Function : Exchange a byte via the SPI bus of a radio
+INTPUT   : bus, the radio bus
+           input, The input byte
+OUTPUT   : The output byte from SPI bus
+=================================================================================
+*/
+INT8U Si4463_BUS_BYTE( SI4463_BUS *bus, INT8U input )
+{
+    INT32U output;
+
+    if( bus->pins->csn_port == 0 )  { return SPI0_transfer(input); }
+
+    SSIDataPut( bus->pins->ssi_base, input );
+    SSIDataGet( bus->pins->ssi_base, &output );
+    return output;
+}
+/*
+=================================================================================
+Si4463_BUS_WAIT( );
+Function : Wait for the block transfer in flight on the bus of a radio, if any
+INTPUT   : bus, the radio bus
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_WAIT( SI4463_BUS *bus )
+{
+    while( bus->dma_busy );
+}
+/*
+=================================================================================
+Si4463_BUS_BLOCK( );
+Function : Exchange a block of bytes via the SPI bus of a radio. The TX and RX
+           uDMA channels feed the SSI back to back, so there is no per-byte
+           call overhead. The chip select is left to the caller.
+INTPUT   : bus, the radio bus
+           txbuf, bytes to send, NULL sends 0xFF
+           rxbuf, bytes received, NULL discards them
+           size, number of bytes, longer than SPI_DMA_MAX_BLOCK goes in pieces
+           callback, called from the SSI interrupt when done. If NULL, the
+           function returns after the transfer is complete.
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_BLOCK( SI4463_BUS *bus, const INT8U *txbuf, INT8U *rxbuf, INT16U size,
+                       SPI_BLOCK_CALLBACK callback )
+{
+    const SI4463_PINS *pins = bus->pins;
+    INT32U dummy;
+    INT16U i;
+
+    // A block started with a callback owns the SSI until it ends, bytes put
+    // by the CPU meanwhile would interleave with it
+    Si4463_BUS_WAIT( bus );
+    if( size < SPI_DMA_MIN_BLOCK )
+    {
+        for( i = 0; i < size; i ++ )
+        {
+            dummy = Si4463_BUS_BYTE( bus, txbuf ? txbuf[i] : 0xFF );
+            if( rxbuf )     { rxbuf[i] = dummy; }
+        }
+        if( callback )      { callback( ); }
+        return;
+    }
+    // One uDMA transfer moves SPI_DMA_MAX_BLOCK bytes at most, the pieces
+    // before the last one are waited for
+    while( size > SPI_DMA_MAX_BLOCK )
+    {
+        Si4463_BUS_BLOCK( bus, txbuf, rxbuf, SPI_DMA_MAX_BLOCK, NULL );
+        if( txbuf ) { txbuf += SPI_DMA_MAX_BLOCK; }
+        if( rxbuf ) { rxbuf += SPI_DMA_MAX_BLOCK; }
+        size -= SPI_DMA_MAX_BLOCK;
+    }
+
+    // Drop anything left in the RX FIFO, it would shift the received block
+    while( SSIDataGetNonBlocking( pins->ssi_base, &dummy ) );
+
+    bus->dma_callback = callback;
+    bus->dma_busy = BOOL_TRUE;
+
+    uDMAChannelControlSet( pins->dma_rx | UDMA_PRI_SELECT,
+                           UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_ARB_4 |
+                           ( rxbuf ? UDMA_DST_INC_8 : UDMA_DST_INC_NONE ) );
+    uDMAChannelTransferSet( pins->dma_rx | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                            ( void * )( pins->ssi_base + SSI_O_DR ),
+                            rxbuf ? rxbuf : &g_ui8DMADummyRx, size );
+
+    uDMAChannelControlSet( pins->dma_tx | UDMA_PRI_SELECT,
+                           UDMA_SIZE_8 | UDMA_DST_INC_NONE | UDMA_ARB_4 |
+                           ( txbuf ? UDMA_SRC_INC_8 : UDMA_SRC_INC_NONE ) );
+    uDMAChannelTransferSet( pins->dma_tx | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                            txbuf ? ( void * )txbuf : &g_ui8DMADummyTx,
+                            ( void * )( pins->ssi_base + SSI_O_DR ), size );
+
+    uDMAChannelEnable( pins->dma_rx );
+    uDMAChannelEnable( pins->dma_tx );
+    SSIDMAEnable( pins->ssi_base, SSI_DMA_RX | SSI_DMA_TX );
+
+    if( callback == NULL )
+    {
+        // Poll the channel rather than wait for the interrupt, so the block
+        // path also works from handlers at or above the SSI priority
+        while( uDMAChannelModeGet( pins->dma_rx | UDMA_PRI_SELECT ) != UDMA_MODE_STOP );
+        SSIDMADisable( pins->ssi_base, SSI_DMA_RX | SSI_DMA_TX );
+        bus->dma_busy = BOOL_FALSE;
+    }
+}
+/*
+=================================================================================
+Si4463_BUS_SSI_IntHandler( );
+Function : Called from the SSI interrupt of a radio bus. Finishes a block
+           transfer started with a callback once the RX channel stopped.
+INTPUT   : bus, the radio bus
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_SSI_IntHandler( SI4463_BUS *bus )
+{
+    const SI4463_PINS *pins = bus->pins;
+    SPI_BLOCK_CALLBACK callback;
+    INT32U status;
+
+    status = SSIIntStatus( pins->ssi_base, true );
+    SSIIntClear( pins->ssi_base, status );
+
+    if( bus->dma_busy && bus->dma_callback &&
+        uDMAChannelModeGet( pins->dma_rx | UDMA_PRI_SELECT ) == UDMA_MODE_STOP )
+    {
+        SSIDMADisable( pins->ssi_base, SSI_DMA_RX | SSI_DMA_TX );
+        callback = bus->dma_callback;
+        bus->dma_callback = NULL;
+        bus->dma_busy = BOOL_FALSE;
+        if( callback )  { callback( ); }
+    }
+}
+/*
+=================================================================================
+Si4463_BUS_CSN( );
+Function : Drive the chip select of a radio
+INTPUT   : bus, the radio bus
+           high, BOOL_TRUE to deselect
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_CSN( SI4463_BUS *bus, BOOLEAN high )
+{
+    const SI4463_PINS *pins = bus->pins;
+
+    if( pins->csn_port == 0 )
+    {
+        if( high )  { SPI0_nss_set(); }
+        else        { SPI0_nss_clear(); }
+        return;
+    }
+    GPIOPinWrite(pins->csn_port, pins->csn_pin, high ? pins->csn_pin : 0);
+}
+/*
+=================================================================================
+Si4463_BUS_SDN( );
+Function : Drive the shutdown pin of a radio
+INTPUT   : bus, the radio bus
+           high, BOOL_TRUE to shut the radio down
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_SDN( SI4463_BUS *bus, BOOLEAN high )
+{
+    const SI4463_PINS *pins = bus->pins;
+
+    GPIOPinWrite(pins->sdn_port, pins->sdn_pin, high ? pins->sdn_pin : 0);
+}
+/*
+=================================================================================
+Si4463_BUS_CTS( );
+Function : Level of the CTS pin of a radio
+INTPUT   : bus, the radio bus
+OUTPUT   : BOOL_TRUE when the radio is ready for a command
+=================================================================================
+*/
+BOOLEAN Si4463_BUS_CTS( SI4463_BUS *bus )
+{
+    return GPIOPinRead(bus->pins->cts_port, bus->pins->cts_pin) ? BOOL_TRUE : BOOL_FALSE;
+}
+/*
+=================================================================================
+Si4463_BUS_GPIO_IntHandler( );
+Function : Called from the GPIO port interrupt of a radio. Flags the CTS rising
+           edge, which also wakes the core, and passes the nIRQ falling edge
+           to the radio driver.
+INTPUT   : bus, the radio bus
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_GPIO_IntHandler( SI4463_BUS *bus )
+{
+    const SI4463_PINS *pins = bus->pins;
+    INT32U status;
+
+    status = GPIOIntStatus(pins->cts_port, true);
+    GPIOIntClear(pins->cts_port, status);
+
+    if( status & pins->cts_pin )
+    {
+        bus->cts_edge = BOOL_TRUE;
+    }
+    if( ( status & pins->irq_pin ) && bus->irq_callback )
+    {
+        bus->irq_callback( bus->irq_arg );
+    }
+}
+/*
+=================================================================================
+Si4463_BUS_IRQ_INIT( );
+Function : Route the nIRQ falling edge of a radio to a handler of the driver
+INTPUT   : bus, the radio bus
+           callback, the handler, NULL disables the interrupt
+           arg, passed to the handler
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_IRQ_INIT( SI4463_BUS *bus, SI4463_BUS_CALLBACK callback, void *arg )
+{
+    const SI4463_PINS *pins = bus->pins;
+
+    GPIOIntDisable(pins->cts_port, pins->irq_pin);
+    bus->irq_callback = callback;
+    bus->irq_arg = arg;
+    if( callback )
+    {
+        GPIOPinTypeGPIOInput(pins->cts_port, pins->irq_pin);
+        GPIOIntTypeSet(pins->cts_port, pins->irq_pin, GPIO_FALLING_EDGE);
+        GPIOIntClear(pins->cts_port, pins->irq_pin);
+        GPIOIntEnable(pins->cts_port, pins->irq_pin);
+    }
+}
+/*
+=================================================================================
+Si4463_BUS_IRQ_MASK( );
+Function : Mask the nIRQ interrupt of a radio while the driver owns its bus.
+           The edge detector keeps latching, so an edge seen while masked is
+           served as soon as it is unmasked. Other radios are not affected.
+INTPUT   : bus, the radio bus
+           mask, BOOL_TRUE to mask
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_IRQ_MASK( SI4463_BUS *bus, BOOLEAN mask )
+{
+    const SI4463_PINS *pins = bus->pins;
+
+    if( mask || bus->irq_callback == NULL )
+    {
+        GPIOIntDisable(pins->cts_port, pins->irq_pin);
+    }
+    else
+    {
+        GPIOIntEnable(pins->cts_port, pins->irq_pin);
+    }
+}
+/*
+=================================================================================
+Si4463_BUS_CTS_IDLE( );
+Function : Idle until the CTS edge of a radio or any other interrupt arrives.
+           The check and the WFI run with interrupts masked, so an edge in
+           between is left pending and WFI returns at once. In handler mode
+           the CTS interrupt cannot preempt, so the caller just spins on the pin.
+INTPUT   : bus, the radio bus
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_CTS_IDLE( SI4463_BUS *bus )
+{
+#if SI4463_CTS_SLEEP
+    bool masked;
+
+    if( HWREG( NVIC_INT_CTRL ) & NVIC_INT_CTRL_VEC_ACT_M )  { return; }
+
+    masked = IntMasterDisable( );
+    if( !bus->cts_edge && !Si4463_BUS_CTS( bus ) )
+    {
+        CPUwfi( );
+    }
+    bus->cts_edge = BOOL_FALSE;
+    if( !masked )   { IntMasterEnable( ); }
+#else
+    bus->cts_edge = BOOL_FALSE;
+#endif
+}
+/*
+=================================================================================
+Si4463_BUS_IRQ_IDLE( );
+Function : Idle until the nIRQ handler of a radio has something for the main
+           loop, or any other interrupt arrives. As with the CTS edge, the
+           check and the WFI run with interrupts masked. In handler mode nIRQ
+           cannot preempt, so it returns at once.
+INTPUT   : bus, the radio bus
+           events, set by the nIRQ handler, 0 until then
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_BUS_IRQ_IDLE( SI4463_BUS *bus, volatile const INT8U *events )
+{
+#if SI4463_CTS_SLEEP
+    bool masked;
+
+    if( HWREG( NVIC_INT_CTRL ) & NVIC_INT_CTRL_VEC_ACT_M )  { return; }
+
+    masked = IntMasterDisable( );
+    if( *events == 0 )
+    {
+        CPUwfi( );
+    }
+    if( !masked )   { IntMasterEnable( ); }
+#endif
+}
+/*
+=================================================================================
+Si4463_CYCLES_INIT( );
+Function : Enable the DWT cycle counter used for timeouts and statistics
+INTPUT   : None
+OUTPUT   : None
+=================================================================================
+*/
+void Si4463_CYCLES_INIT( void )
+{
+    HWREG( 0xE000EDFC ) |= 0x01000000;     // DEMCR.TRCENA
+    HWREG( 0xE0001000 ) |= 0x00000001;     // DWT_CTRL.CYCCNTENA
 }
 
 /*
@@ -0,0 +1,173 @@
+/*
+================================================================================
+Function : Aggregation of small records into full SI446x frames
+================================================================================
+*/
+
+/*
+Every frame pays for the preamble, the sync word, the length byte, the CRC
+and a turnaround, whatever its size. Records sent to the same destination
+are collected into one frame instead:
+
+    appkey (2), dst, src, then per record: length (1..AGG_RECORD_MAX), data
+
+A frame goes out when the next record does not fit or when its oldest record
+has waited for the deadline, which bounds the latency added to a record.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef SI446X_SIM
+#include "../global.h"
+#endif
+#include "radio_agg.h"
+
+/*!
+ * Set up an aggregator for one destination
+ *
+ * @param agg           the aggregator
+ * @param radio         its radio, NULL for the one on SPI0
+ * @param appkey        2 bytes
+ * @param dst           destination of the frames
+ * @param src           address of this node
+ * @param channel       tx channel
+ * @param condition     tx condition, STATE_RX << 4 while the RX engine runs
+ * @param deadline_us   longest a record waits, 0 for AGG_DEADLINE_US
+ */
+void AGG_INIT( AGG_BUFFER *agg, SI446X_DEV *radio, const INT8U *appkey, INT8U dst, INT8U src,
+               INT8U channel, INT8U condition, INT32U deadline_us )
+{
+    memset( agg, 0, sizeof( *agg ) );
+    agg->radio = radio ? radio : &g_sSi446xDev0;
+    agg->header[0] = appkey[0];
+    agg->header[1] = appkey[1];
+    agg->header[2] = dst;
+    agg->header[3] = src;
+    agg->channel = channel;
+    agg->condition = condition;
+    agg->deadline = SI446X_US_CYCLES( deadline_us ? deadline_us : AGG_DEADLINE_US );
+}
+/*!
+ * Send the waiting records now. They are kept while the radio is still on
+ * the previous frame, or when the driver does not take the frame.
+ *
+ * @param agg       the aggregator
+ * @return AGG_OK, AGG_ERR_BUSY if the radio is still sending, AGG_ERR_RADIO
+ */
+INT8U AGG_FLUSH( AGG_BUFFER *agg )
+{
+    SI446X_SEG seg[2];
+
+    if( agg->used == 0 )    { return AGG_OK; }
+    if( SI446X_DEV_TX_BUSY( agg->radio ) )  { return AGG_ERR_BUSY; }
+
+    seg[0].data = agg->header;
+    seg[0].length = sizeof( agg->header );
+    seg[1].data = agg->payload;
+    seg[1].length = agg->used;
+    if( SI446X_DEV_SEND_SEG( agg->radio, seg, 2, agg->channel, agg->condition ) != SI446X_OK )
+    {
+        return AGG_ERR_RADIO;
+    }
+
+    agg->stats.frames ++;
+    agg->stats.bytes += agg->used;
+    agg->used = 0;
+    return AGG_OK;
+}
+/*!
+ * Add a record. The waiting records are sent first if it does not fit.
+ *
+ * @param agg       the aggregator
+ * @param record    the record, copied
+ * @param length    1..AGG_RECORD_MAX bytes
+ * @return AGG_OK, AGG_ERR_PARAM, or the error of AGG_FLUSH; the record is
+ *         not taken then
+ */
+INT8U AGG_PUT( AGG_BUFFER *agg, const INT8U *record, INT8U length )
+{
+    INT8U status;
+
+    if( length == 0 || length > AGG_RECORD_MAX )    { return AGG_ERR_PARAM; }
+    if( agg->used + 1 + length > AGG_PAYLOAD_MAX )
+    {
+        if( ( status = AGG_FLUSH( agg ) ) != AGG_OK )   { return status; }
+        agg->stats.flush_full ++;
+    }
+    if( agg->used == 0 )    { agg->first_at = Si4463_CYCLES( ); }
+    agg->payload[agg->used] = length;
+    memcpy( agg->payload + agg->used + 1, record, length );
+    agg->used += 1 + length;
+    agg->stats.records ++;
+    return AGG_OK;
+}
+/*!
+ * Send the waiting records once the oldest has waited for the deadline
+ *
+ * @param agg       the aggregator
+ * @return AGG_OK, or the error of AGG_FLUSH
+ */
+INT8U AGG_POLL( AGG_BUFFER *agg )
+{
+    INT8U status;
+
+    if( agg->used == 0 || Si4463_CYCLES( ) - agg->first_at < agg->deadline )
+    {
+        return AGG_OK;
+    }
+    status = AGG_FLUSH( agg );
+    if( status == AGG_OK )  { agg->stats.flush_deadline ++; }
+    return status;
+}
+/*!
+ * Read the aggregator statistics
+ *
+ * @param agg       the aggregator
+ */
+const AGG_STATS *AGG_STATS_GET( AGG_BUFFER *agg )
+{
+    return &agg->stats;
+}
+/*!
+ * Start splitting a received frame, e.g. the data of an SI446X_RX_SLOT
+ *
+ * @param iter      the iterator
+ * @param frame     appkey, dst, src and the records
+ * @param length    frame length
+ */
+void AGG_SPLIT( AGG_ITER *iter, const INT8U *frame, INT8U length )
+{
+    iter->data = frame;
+    iter->length = length;
+    iter->offset = length < 4 ? length : 4;
+}
+/*!
+ * Next record of the frame. A length prefix running past the end of the frame
+ * ends the frame, the records before it are good.
+ *
+ * @param iter      the iterator
+ * @param record    set to the record, inside the frame
+ * @return record length, 0 at the end of the frame
+ */
+INT8U AGG_NEXT( AGG_ITER *iter, const INT8U **record )
+{
+    INT8U length;
+
+    if( iter->offset >= iter->length )  { return 0; }
+    length = iter->data[iter->offset];
+    if( length == 0 || length > iter->length - iter->offset - 1 )
+    {
+        iter->offset = iter->length;
+        return 0;
+    }
+    *record = iter->data + iter->offset + 1;
+    iter->offset += 1 + length;
+    return length;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
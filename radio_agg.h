@@ -0,0 +1,89 @@
+/*
+================================================================================
+Function : Aggregation of small records into full SI446x frames
+================================================================================
+*/
+
+#ifndef _RADIO_AGG_H_
+#define _RADIO_AGG_H_
+
+#include "si446x.h"
+
+/*
+=================================================================================
+------------------------------INTERNAL EXPORT APIs-------------------------------
+=================================================================================
+*/
+
+#define  AGG_PAYLOAD_MAX        VMX_MAX_BUFFER          //record bytes of one frame, length prefixes included
+#define  AGG_RECORD_MAX         ( AGG_PAYLOAD_MAX - 1 ) //longest record
+#define  AGG_DEADLINE_US        50000   //default longest wait of a record for company
+
+/*Status codes*/
+#define  AGG_OK                 0
+#define  AGG_ERR_PARAM          1       //the record is empty or over AGG_RECORD_MAX
+#define  AGG_ERR_BUSY           2       //the radio is still sending, call again
+#define  AGG_ERR_RADIO          3       //the driver did not take the frame, the records are kept
+
+/*Aggregator statistics*/
+typedef struct
+{
+    INT32U records;             //records put
+    INT32U frames;              //frames sent
+    INT32U flush_full;          //frames sent because the next record did not fit
+    INT32U flush_deadline;      //frames sent because the oldest record was due
+    INT32U bytes;               //record bytes sent, length prefixes included
+}AGG_STATS;
+
+/*Records waiting for one destination. Set up with AGG_INIT*/
+typedef struct
+{
+    SI446X_DEV *radio;
+    INT8U  header[4];           //appkey, dst, src
+    INT8U  channel;
+    INT8U  condition;           //START_TX condition
+    INT32U deadline;            //CPU cycles a record may wait
+    INT32U first_at;            //when the oldest waiting record was put
+    INT8U  used;                //bytes in payload
+    INT8U  payload[AGG_PAYLOAD_MAX];
+    AGG_STATS stats;
+}AGG_BUFFER;
+
+/*Records of a received frame, for AGG_NEXT*/
+typedef struct
+{
+    const INT8U *data;
+    INT8U  length;
+    INT8U  offset;
+}AGG_ITER;
+
+/*Set up an aggregator for one destination on radio, NULL for the one on SPI0,
+deadline_us 0 for AGG_DEADLINE_US*/
+void AGG_INIT( AGG_BUFFER *agg, SI446X_DEV *radio, const INT8U *appkey, INT8U dst, INT8U src,
+               INT8U channel, INT8U condition, INT32U deadline_us );
+
+/*Add a record, a frame goes out when it is full*/
+INT8U AGG_PUT( AGG_BUFFER *agg, const INT8U *record, INT8U length );
+
+/*Send the waiting records if the oldest is due; call from the main loop*/
+INT8U AGG_POLL( AGG_BUFFER *agg );
+
+/*Send the waiting records now*/
+INT8U AGG_FLUSH( AGG_BUFFER *agg );
+
+/*Read the aggregator statistics*/
+const AGG_STATS *AGG_STATS_GET( AGG_BUFFER *agg );
+
+/*Start splitting a received frame: appkey, dst, src and the records*/
+void AGG_SPLIT( AGG_ITER *iter, const INT8U *frame, INT8U length );
+
+/*Next record of the frame, returns its length, 0 at the end or on a bad prefix*/
+INT8U AGG_NEXT( AGG_ITER *iter, const INT8U **record );
+
+#endif //_RADIO_AGG_H_
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
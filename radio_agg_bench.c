@@ -0,0 +1,126 @@
+/*
+================================================================================
+Function : Frames and latency of record aggregation, on the host simulation
+================================================================================
+*/
+
+/*
+    gcc -std=c99 -O2 -DSI446X_SIM -I. -o radio_agg_bench \
+        radio_agg_bench.c radio_agg.c si446x_sim.c si446x.c
+    ./radio_agg_bench
+
+Radio 0 produces an AGG_BENCH_SIZE byte record every AGG_BENCH_PERIOD_US
+and sends it to radio 1 through an aggregator; a deadline of 1 us is one
+frame per record. Reported per deadline are the frames sent, records per
+frame and the latency from making a record to the nIRQ handler of the
+receiver; a record AGG_PUT turns away while the radio is busy is put again.
+The exit code is 1 if a record was lost, reordered or took longer than its
+deadline plus AGG_BENCH_SLACK_US.
+*/
+
+#include "radio_agg.h"
+
+#define AGG_BENCH_RECORDS   120
+#define AGG_BENCH_SIZE      8
+#define AGG_BENCH_PERIOD_US 25000
+#define AGG_BENCH_SLACK_US  60000       //air time of a full frame and polling
+#define AGG_BENCH_CHANNEL   4
+
+static const INT32U AGG_BENCH_DEADLINES[] = { 1, 50000, 100000, 200000 };
+static const INT8U appkey[2] = { 0xA5, 0x5A };
+
+static int failures;
+
+static void AGG_BENCH_RUN( INT32U deadline_us )
+{
+    static SI446X_DEV radio[2];
+    AGG_BUFFER agg;
+    AGG_ITER iter;
+    const SI446X_RX_SLOT *slot;
+    const INT8U *record;
+    INT8U data[AGG_BENCH_SIZE];
+    INT16U made = 0, put = 0, got = 0, seq;
+    INT32U put_at, latency, max = 0, cycles_us = SI446X_SIM_SYSCLK_HZ / 1000000;
+    uint64_t next = 0, sum = 0;
+    INT8U i, length;
+
+    SI446X_SIM_INIT( 2, 1 );
+    for( i = 0; i < 2; i ++ )   { SI446X_SIM_RADIO_UP( &radio[i], i ); }
+    SI446X_DEV_RX_ENGINE_START( &radio[1], AGG_BENCH_CHANNEL );
+    AGG_INIT( &agg, &radio[0], appkey, 0x11, 0x10, AGG_BENCH_CHANNEL, 0, deadline_us );
+    SI446X_SIM_RUN( 1000 );
+
+    while( got < AGG_BENCH_RECORDS && SI446X_SIM_NOW( ) < 60000000000ULL )
+    {
+        if( put < AGG_BENCH_RECORDS && SI446X_SIM_NOW( ) >= next )
+        {
+            // A record the radio was too busy to take is put again as it was
+            if( made == put )
+            {
+                put_at = Si4463_CYCLES( );
+                data[0] = ( INT8U )put;
+                data[1] = ( INT8U )( put >> 8 );
+                memcpy( data + 2, &put_at, 4 );
+                data[6] = data[7] = 0xEE;
+                made ++;
+            }
+            if( AGG_PUT( &agg, data, AGG_BENCH_SIZE ) == AGG_OK )
+            {
+                put ++;
+                next += AGG_BENCH_PERIOD_US * 1000ULL;
+            }
+        }
+        if( put == AGG_BENCH_RECORDS )  { AGG_FLUSH( &agg ); }
+        else                            { AGG_POLL( &agg ); }
+
+        while( ( slot = SI446X_DEV_RX_PEEK( &radio[1] ) ) != NULL )
+        {
+            AGG_SPLIT( &iter, slot->data, slot->length );
+            while( ( length = AGG_NEXT( &iter, &record ) ) != 0 )
+            {
+                seq = record[0] | record[1] << 8;
+                memcpy( &put_at, record + 2, 4 );
+                if( length != AGG_BENCH_SIZE || seq != got )
+                {
+                    printf( "FAIL: record %u, got %u\n", got, seq );
+                    failures ++;
+                }
+                latency = ( slot->timestamp - put_at ) / cycles_us;
+                sum += latency;
+                if( latency > max ) { max = latency; }
+                got = seq + 1;
+            }
+            SI446X_DEV_RX_RELEASE( &radio[1] );
+        }
+        SI446X_SIM_RUN( 500 );
+    }
+    if( got != AGG_BENCH_RECORDS || max > deadline_us + AGG_BENCH_SLACK_US )
+    {
+        printf( "FAIL: %u of %u records, latency %u us\n", got, AGG_BENCH_RECORDS, max );
+        failures ++;
+    }
+    SI446X_SIM_SELECT( 0 );
+    printf( "%9u %7u %7u %9.2f %9.1f %9.1f\n", deadline_us, agg.stats.records,
+            SI446X_SIM_STATS_GET( )->frames_sent,
+            agg.stats.records / ( double )agg.stats.frames,
+            got ? sum / 1000.0 / got : 0.0, max / 1000.0 );
+}
+
+int main( void )
+{
+    INT8U d;
+
+    printf( "%9s %7s %7s %9s %9s %9s\n", "wait us", "records", "frames",
+            "rec/frame", "mean ms", "max ms" );
+    for( d = 0; d < sizeof( AGG_BENCH_DEADLINES ) / sizeof( AGG_BENCH_DEADLINES[0] ); d ++ )
+    {
+        AGG_BENCH_RUN( AGG_BENCH_DEADLINES[d] );
+    }
+    return failures ? 1 : 0;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
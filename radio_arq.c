@@ -0,0 +1,434 @@
+/*
+================================================================================
+Function : Sliding window reliable transport over the SI446x driver
+================================================================================
+*/
+
+/*
+Frames are normal SI446x frames, appkey, dst and src first, followed by
+
+    type    ARQ_TYPE_DATA or ARQ_TYPE_ACK, ARQ_FLAG_POLL
+    seq     sequence number of a data frame, the poll answered by an ack
+    ack     next sequence number the receiver misses, everything before is held
+    sack    16 bits, low byte first: bit i set when ack + 1 + i is held
+    data    ARQ_DATA_MAX bytes at most, data frames only
+
+The radio is half duplex, so a sender sends a burst of up to a window of
+frames and flags the last one ARQ_FLAG_POLL. The receiver answers the poll
+with an ack at once and sends nothing else unasked, which would only cut
+short the rest of a burst; every frame carries the ack fields though, so data
+going the other way acks as well. Whatever the ack answering a poll does not
+cover was lost and is sent again first in the next burst. A poll left unanswered for the retransmission
+timeout sends every unacknowledged frame again, with the timeout doubled.
+The timeout follows the RTT of the polls as in RFC 6298; polls on frames sent
+again give no sample (Karn).
+
+A link owns the RX engine and the PACKET_SENT report of its radio; frames for
+other links are dropped by ARQ_POLL, feed them to ARQ_INPUT when several
+links share a radio.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef SI446X_SIM
+#include "../global.h"
+#endif
+#include "radio_arq.h"
+
+#define ARQ_MASK            ( ARQ_WINDOW_MAX - 1 )
+
+/*
+=================================================================================
+------------------------------------Internal-------------------------------------
+=================================================================================
+*/
+
+/*!
+ * Take a round trip sample into the retransmission timeout
+ *
+ * @param link      the link
+ * @param sample    round trip, CPU cycles
+ */
+static void ARQ_RTT_UPDATE( ARQ_LINK *link, INT32U sample )
+{
+    INT32U delta;
+
+    if( link->stats.rtt_samples ++ == 0 )
+    {
+        link->srtt = sample;
+        link->rttvar = sample / 2;
+    }
+    else
+    {
+        delta = link->srtt > sample ? link->srtt - sample : sample - link->srtt;
+        link->rttvar = link->rttvar - link->rttvar / 4 + delta / 4;
+        link->srtt = link->srtt - link->srtt / 8 + sample / 8;
+    }
+    link->rto = link->srtt + 4 * link->rttvar;
+    if( link->rto < SI446X_US_CYCLES( ARQ_RTO_MIN_US ) )  { link->rto = SI446X_US_CYCLES( ARQ_RTO_MIN_US ); }
+    if( link->rto > SI446X_US_CYCLES( ARQ_RTO_MAX_US ) )  { link->rto = SI446X_US_CYCLES( ARQ_RTO_MAX_US ); }
+}
+/*!
+ * Send one frame; it also carries the ack of what the link has received
+ *
+ * @param link      the link
+ * @param type      ARQ_TYPE_DATA or ARQ_TYPE_ACK, ARQ_FLAG_POLL
+ * @param seq       the seq field
+ * @param data      payload, NULL for an ack
+ * @param length    its length
+ */
+static void ARQ_TX( ARQ_LINK *link, INT8U type, INT8U seq, const INT8U *data, INT8U length )
+{
+    INT8U header[4 + ARQ_HEADER_SIZE];
+    SI446X_SEG seg[2];
+
+    header[0] = link->appkey[0];
+    header[1] = link->appkey[1];
+    header[2] = link->peer;
+    header[3] = link->local;
+    header[4] = type;
+    header[5] = seq;
+    header[6] = link->rx.next;
+    header[7] = ( INT8U )link->rx.sack;
+    header[8] = ( INT8U )( link->rx.sack >> 8 );
+    seg[0].data = header;
+    seg[0].length = sizeof( header );
+    seg[1].data = data;
+    seg[1].length = length;
+
+    SI446X_DEV_SEND_SEG( link->radio, seg, data ? 2 : 1, link->channel, STATE_RX << 4 );
+    link->tx.busy = BOOL_TRUE;
+    link->tx.busy_at = Si4463_CYCLES( );
+    link->rx.ack_due = BOOL_FALSE;
+}
+/*!
+ * Check the radio is done with the last frame
+ *
+ * @param link      the link
+ * @return BOOL_TRUE if a frame can be sent
+ */
+static BOOLEAN ARQ_TX_READY( ARQ_LINK *link )
+{
+    if( !link->tx.busy )    { return BOOL_TRUE; }
+    if( SI446X_DEV_RX_ENGINE_TX_DONE( link->radio ) ||
+        Si4463_CYCLES( ) - link->tx.busy_at >= SI446X_US_CYCLES( ARQ_TX_TIMEOUT_US ) )
+    {
+        link->tx.busy = BOOL_FALSE;
+    }
+    return link->tx.busy ? BOOL_FALSE : BOOL_TRUE;
+}
+/*!
+ * Apply the ack fields of a frame from the peer
+ *
+ * @param link      the link
+ * @param ack       cumulative ack
+ * @param sack      selective acks above it
+ * @param answer    BOOL_TRUE when the frame answers the pending poll
+ */
+static void ARQ_ACK_IN( ARQ_LINK *link, INT8U ack, INT16U sack, BOOLEAN answer )
+{
+    INT8U inflight = link->tx.next - link->tx.base;
+    INT8U seq, i;
+
+    if( ( INT8U )( ack - link->tx.base ) > inflight )   { return; }    //stale or bogus
+    for( i = 0; i < 16; i ++ )
+    {
+        seq = ack + 1 + i;
+        if( ( sack & ( 1u << i ) ) && ( INT8U )( seq - link->tx.base ) < inflight )
+        {
+            link->tx.slot[seq & ARQ_MASK].acked = BOOL_TRUE;
+        }
+    }
+    link->tx.base = ack;
+    while( link->tx.base != link->tx.next && link->tx.slot[link->tx.base & ARQ_MASK].acked )
+    {
+        link->tx.base ++;
+    }
+    if( !answer )   { return; }
+
+    // The poll was the last frame sent, whatever it does not cover was lost
+    for( seq = link->tx.base; seq != link->tx.next; seq ++ )
+    {
+        if( !link->tx.slot[seq & ARQ_MASK].acked )  { link->tx.slot[seq & ARQ_MASK].resend = BOOL_TRUE; }
+    }
+    if( link->tx.poll_fresh )   { ARQ_RTT_UPDATE( link, Si4463_CYCLES( ) - link->tx.poll_at ); }
+    link->tx.waiting = BOOL_FALSE;
+    link->tx.backoff = 0;
+}
+/*!
+ * Store a data frame from the peer and work out the ack for it
+ *
+ * @param link      the link
+ * @param seq       its sequence number
+ * @param data      its payload
+ * @param length    payload length
+ */
+static void ARQ_DATA_IN( ARQ_LINK *link, INT8U seq, const INT8U *data, INT8U length )
+{
+    INT8U i;
+
+    if( ( INT8U )( seq - link->rx.next ) >= 128 )               //behind next, had it before
+    {
+        link->stats.duplicates ++;
+        return;
+    }
+    if( ( INT8U )( seq - link->rx.read ) >= ARQ_WINDOW_MAX )    { return; }    //no room yet
+    if( link->rx.slot[seq & ARQ_MASK].held )
+    {
+        link->stats.duplicates ++;
+        return;
+    }
+
+    link->rx.slot[seq & ARQ_MASK].held = BOOL_TRUE;
+    link->rx.slot[seq & ARQ_MASK].length = length;
+    memcpy( link->rx.slot[seq & ARQ_MASK].data, data, length );
+
+    while( ( INT8U )( link->rx.next - link->rx.read ) < ARQ_WINDOW_MAX &&
+           link->rx.slot[link->rx.next & ARQ_MASK].held )
+    {
+        link->rx.next ++;
+    }
+    link->rx.sack = 0;
+    for( i = 0; i < 16; i ++ )
+    {
+        seq = link->rx.next + 1 + i;
+        if( ( INT8U )( seq - link->rx.read ) < ARQ_WINDOW_MAX && link->rx.slot[seq & ARQ_MASK].held )
+        {
+            link->rx.sack |= 1u << i;
+        }
+    }
+}
+
+/*
+=================================================================================
+-------------------------------------Exports-------------------------------------
+=================================================================================
+*/
+
+/*!
+ * Set up one end of a link. Both ends must use the same window. The RX engine
+ * of the radio must run on channel, with a filter passing local if any.
+ *
+ * @param link      the link
+ * @param radio     its radio, NULL for the one on SPI0
+ * @param appkey    2 bytes
+ * @param local     address of this end, src of its frames
+ * @param peer      address of the other end
+ * @param channel   channel of both ends
+ * @param window    frames in flight, clipped to 1..ARQ_WINDOW_MAX
+ */
+void ARQ_INIT( ARQ_LINK *link, SI446X_DEV *radio, const INT8U *appkey, INT8U local,
+               INT8U peer, INT8U channel, INT8U window )
+{
+    memset( link, 0, sizeof( *link ) );
+    link->radio = radio ? radio : &g_sSi446xDev0;
+    link->appkey[0] = appkey[0];
+    link->appkey[1] = appkey[1];
+    link->local = local;
+    link->peer = peer;
+    link->channel = channel;
+    link->window = window == 0 ? 1 : GetMin( window, ARQ_WINDOW_MAX );
+    link->rto = SI446X_US_CYCLES( ARQ_RTO_INIT_US );
+}
+/*!
+ * Queue a payload. It goes out with the next burst ARQ_POLL sends; queue a
+ * whole window before polling to send it as one burst.
+ *
+ * @param link      the link
+ * @param data      the payload
+ * @param length    1..ARQ_DATA_MAX bytes
+ * @return ARQ_OK, ARQ_ERR_FULL if a window of payloads is not acked yet,
+ *         ARQ_ERR_PARAM, ARQ_ERR_LINK
+ */
+INT8U ARQ_SEND( ARQ_LINK *link, const INT8U *data, INT8U length )
+{
+    INT8U index = link->tx.tail & ARQ_MASK;
+
+    if( link->status != ARQ_OK )                            { return link->status; }
+    if( length == 0 || length > ARQ_DATA_MAX )              { return ARQ_ERR_PARAM; }
+    if( ( INT8U )( link->tx.tail - link->tx.base ) >= link->window )   { return ARQ_ERR_FULL; }
+
+    link->tx.slot[index].length = length;
+    link->tx.slot[index].tries = 0;
+    link->tx.slot[index].acked = BOOL_FALSE;
+    link->tx.slot[index].resend = BOOL_FALSE;
+    memcpy( link->tx.slot[index].data, data, length );
+    link->tx.tail ++;
+    return ARQ_OK;
+}
+/*!
+ * Take a frame received by the RX engine
+ *
+ * @param link      the link
+ * @param slot      the frame, as returned by SI446X_RX_PEEK
+ * @return BOOL_FALSE if it is not for this link
+ */
+BOOLEAN ARQ_INPUT( ARQ_LINK *link, const SI446X_RX_SLOT *slot )
+{
+    const INT8U *frame = slot->data;
+    INT8U type, seq;
+    INT16U sack;
+
+    if( slot->length < 4 + ARQ_HEADER_SIZE || frame[0] != link->appkey[0] ||
+        frame[1] != link->appkey[1] || frame[2] != link->local || frame[3] != link->peer )
+    {
+        return BOOL_FALSE;
+    }
+    type = frame[4];
+    seq = frame[5];
+    sack = frame[7] | ( INT16U )frame[8] << 8;
+
+    if( ( type & ~ARQ_FLAG_POLL ) == ARQ_TYPE_ACK )
+    {
+        link->stats.acks_received ++;
+        ARQ_ACK_IN( link, frame[6], sack, link->tx.waiting && seq == link->tx.poll_seq );
+        return BOOL_TRUE;
+    }
+    ARQ_ACK_IN( link, frame[6], sack, BOOL_FALSE );
+    ARQ_DATA_IN( link, seq, frame + 4 + ARQ_HEADER_SIZE,
+                 GetMin( slot->length - 4 - ARQ_HEADER_SIZE, ARQ_DATA_MAX ) );
+    if( type & ARQ_FLAG_POLL )
+    {
+        link->rx.echo = seq;
+        link->rx.ack_due = BOOL_TRUE;
+    }
+    return BOOL_TRUE;
+}
+/*!
+ * Run the link: take the frames the RX engine holds, then send at most one
+ * frame, an ack first, then data sent again, then new data.
+ *
+ * @param link      the link
+ * @return ARQ_OK, ARQ_ERR_LINK after ARQ_RETRIES timeouts in a row
+ */
+INT8U ARQ_POLL( ARQ_LINK *link )
+{
+    const SI446X_RX_SLOT *slot;
+    INT8U seq, pick = 0, index, type;
+    BOOLEAN found = BOOL_FALSE, more = BOOL_FALSE;
+    INT32U now;
+
+    while( ( slot = SI446X_DEV_RX_PEEK( link->radio ) ) != NULL )
+    {
+        ARQ_INPUT( link, slot );
+        SI446X_DEV_RX_RELEASE( link->radio );
+    }
+    if( link->status != ARQ_OK || !ARQ_TX_READY( link ) )    { return link->status; }
+    now = Si4463_CYCLES( );
+
+    if( link->rx.ack_due )
+    {
+        ARQ_TX( link, ARQ_TYPE_ACK, link->rx.echo, NULL, 0 );
+        link->stats.acks_sent ++;
+        return ARQ_OK;
+    }
+    if( link->tx.waiting )
+    {
+        if( now - link->tx.poll_at < link->rto )    { return ARQ_OK; }
+        link->stats.timeouts ++;
+        link->tx.waiting = BOOL_FALSE;
+        if( ++ link->tx.backoff > ARQ_RETRIES )
+        {
+            link->status = ARQ_ERR_LINK;
+            return link->status;
+        }
+        link->rto = GetMin( link->rto * 2, SI446X_US_CYCLES( ARQ_RTO_MAX_US ) );
+        for( seq = link->tx.base; seq != link->tx.next; seq ++ )
+        {
+            if( !link->tx.slot[seq & ARQ_MASK].acked )  { link->tx.slot[seq & ARQ_MASK].resend = BOOL_TRUE; }
+        }
+    }
+
+    // Lost frames first, then new ones while the window allows
+    for( seq = link->tx.base; seq != link->tx.next; seq ++ )
+    {
+        if( !link->tx.slot[seq & ARQ_MASK].resend ) { continue; }
+        if( found ) { more = BOOL_TRUE; break; }
+        found = BOOL_TRUE;
+        pick = seq;
+    }
+    if( !found && link->tx.next != link->tx.tail &&
+        ( INT8U )( link->tx.next - link->tx.base ) < link->window )
+    {
+        found = BOOL_TRUE;
+        pick = link->tx.next ++;
+    }
+    if( !found )    { return ARQ_OK; }
+    if( !more )
+    {
+        more = link->tx.next != link->tx.tail &&
+               ( INT8U )( link->tx.next - link->tx.base ) < link->window;
+    }
+    seq = pick;
+    index = seq & ARQ_MASK;
+
+    type = ARQ_TYPE_DATA;
+    if( !more ) { type |= ARQ_FLAG_POLL; }
+    link->tx.slot[index].resend = BOOL_FALSE;
+    if( link->tx.slot[index].tries ++ )  { link->stats.retransmits ++; }
+    link->stats.sent ++;
+    ARQ_TX( link, type, seq, link->tx.slot[index].data, link->tx.slot[index].length );
+    if( !more )
+    {
+        link->tx.waiting = BOOL_TRUE;
+        link->tx.poll_seq = seq;
+        link->tx.poll_fresh = link->tx.slot[index].tries == 1 ? BOOL_TRUE : BOOL_FALSE;
+        link->tx.poll_at = link->tx.busy_at;
+    }
+    return ARQ_OK;
+}
+/*!
+ * Hand out the next payload in order
+ *
+ * @param link      the link
+ * @param buffer    ARQ_DATA_MAX bytes
+ * @return payload length, 0 if the next one has not arrived yet
+ */
+INT8U ARQ_RECV( ARQ_LINK *link, INT8U *buffer )
+{
+    INT8U index = link->rx.read & ARQ_MASK;
+    INT8U length;
+
+    if( link->rx.read == link->rx.next )    { return 0; }
+    length = link->rx.slot[index].length;
+    memcpy( buffer, link->rx.slot[index].data, length );
+    link->rx.slot[index].held = BOOL_FALSE;
+    link->rx.read ++;
+    link->stats.delivered ++;
+    return length;
+}
+/*!
+ * Check every payload queued has been acknowledged
+ *
+ * @param link      the link
+ */
+BOOLEAN ARQ_IDLE( ARQ_LINK *link )
+{
+    return link->tx.base == link->tx.tail ? BOOL_TRUE : BOOL_FALSE;
+}
+/*!
+ * Read the link statistics
+ *
+ * @param link      the link
+ */
+const ARQ_STATS *ARQ_STATS_GET( ARQ_LINK *link )
+{
+    return &link->stats;
+}
+/*!
+ * Current retransmission timeout
+ *
+ * @param link      the link
+ * @return the timeout, us
+ */
+INT32U ARQ_RTO_US( ARQ_LINK *link )
+{
+    return SI446X_CYCLES_US( link->rto );
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
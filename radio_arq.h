@@ -0,0 +1,135 @@
+/*
+================================================================================
+Function : Sliding window reliable transport over the SI446x driver
+================================================================================
+*/
+
+#ifndef _RADIO_ARQ_H_
+#define _RADIO_ARQ_H_
+
+#include "si446x.h"
+
+/*
+=================================================================================
+------------------------------INTERNAL EXPORT APIs-------------------------------
+=================================================================================
+*/
+
+#define  ARQ_WINDOW_MAX         16      //frames in flight, power of 2, the SACK bitmap is 16 bits
+#define  ARQ_HEADER_SIZE        5       //type, seq, ack, sack (2), after appkey, dst and src
+#define  ARQ_DATA_MAX           ( VMX_MAX_BUFFER - ARQ_HEADER_SIZE )    //payload of one frame
+
+#define  ARQ_RTO_INIT_US        200000  //retransmission timeout before the first RTT sample
+#define  ARQ_RTO_MIN_US         10000
+#define  ARQ_RTO_MAX_US         2000000
+#define  ARQ_RETRIES            12      //timeouts in a row before the link is given up
+#define  ARQ_TX_TIMEOUT_US      200000  //longest wait for PACKET_SENT
+
+/*Frame types, the type byte*/
+#define  ARQ_TYPE_DATA          0x01
+#define  ARQ_TYPE_ACK           0x02
+#define  ARQ_FLAG_POLL          0x80    //the sender waits for an ack before sending more
+
+/*Status codes*/
+#define  ARQ_OK                 0
+#define  ARQ_ERR_FULL           1       //the window is full, poll and try again
+#define  ARQ_ERR_PARAM          2       //an argument is out of range
+#define  ARQ_ERR_LINK           3       //the peer stopped answering, ARQ_INIT to restart
+
+/*Link statistics*/
+typedef struct
+{
+    INT32U sent;            //data frames sent, retransmissions included
+    INT32U retransmits;     //data frames sent again
+    INT32U timeouts;        //polls not answered within the RTO
+    INT32U acks_sent;
+    INT32U acks_received;
+    INT32U delivered;       //payloads handed to ARQ_RECV in order
+    INT32U duplicates;      //data frames received twice
+    INT32U rtt_samples;
+}ARQ_STATS;
+
+/*One end of a link. Set up with ARQ_INIT, then only touched by radio_arq.c*/
+typedef struct
+{
+    SI446X_DEV *radio;              //radio of the link
+    INT8U  appkey[2];
+    INT8U  local, peer;             //addresses, dst and src of the frames
+    INT8U  channel;
+    INT8U  window;                  //frames in flight, ARQ_WINDOW_MAX at most
+    INT8U  status;                  //ARQ_OK or ARQ_ERR_LINK
+
+    /*Sender: frames from base to next are in flight, next to tail are queued*/
+    struct
+    {
+        INT8U base, next, tail;
+        INT8U poll_seq;             //frame which asked for the pending ack
+        BOOLEAN poll_fresh;         //it was a first transmission, its ack times the RTT
+        BOOLEAN waiting;            //a poll is out, nothing is sent until its ack
+        BOOLEAN busy;               //PACKET_SENT not seen yet
+        INT32U busy_at;
+        INT32U poll_at;             //when the poll was sent
+        INT8U  backoff;             //timeouts in a row
+        struct
+        {
+            INT8U  length;
+            INT8U  tries;           //transmissions, 0 while queued
+            BOOLEAN acked;
+            BOOLEAN resend;
+            INT8U  data[ARQ_DATA_MAX];
+        }slot[ARQ_WINDOW_MAX];
+    }tx;
+
+    /*Receiver: read to next are in order, above next only what sack says*/
+    struct
+    {
+        INT8U read, next;
+        INT16U sack;                //bit i: frame next + 1 + i is held
+        INT8U  echo;                //last poll seen, answered by the ack
+        BOOLEAN ack_due;            //a poll is not answered yet
+        struct
+        {
+            INT8U  length;
+            BOOLEAN held;
+            INT8U  data[ARQ_DATA_MAX];
+        }slot[ARQ_WINDOW_MAX];
+    }rx;
+
+    /*Retransmission timer, CPU cycles, as in RFC 6298*/
+    INT32U srtt, rttvar, rto;
+
+    ARQ_STATS stats;
+}ARQ_LINK;
+
+/*Set up one end of a link on radio, NULL for the one on SPI0; its RX engine must run*/
+void ARQ_INIT( ARQ_LINK *link, SI446X_DEV *radio, const INT8U *appkey, INT8U local,
+               INT8U peer, INT8U channel, INT8U window );
+
+/*Queue a payload of ARQ_DATA_MAX bytes at most*/
+INT8U ARQ_SEND( ARQ_LINK *link, const INT8U *data, INT8U length );
+
+/*Take a received frame, BOOL_FALSE if it is not for this link*/
+BOOLEAN ARQ_INPUT( ARQ_LINK *link, const SI446X_RX_SLOT *slot );
+
+/*Drain the RX ring into the link, then send what is due; call from the main loop*/
+INT8U ARQ_POLL( ARQ_LINK *link );
+
+/*Next payload in order, returns its length, 0 if there is none*/
+INT8U ARQ_RECV( ARQ_LINK *link, INT8U *buffer );
+
+/*BOOL_TRUE when every queued payload has been acknowledged*/
+BOOLEAN ARQ_IDLE( ARQ_LINK *link );
+
+/*Read the link statistics*/
+const ARQ_STATS *ARQ_STATS_GET( ARQ_LINK *link );
+
+/*Current retransmission timeout, us*/
+INT32U ARQ_RTO_US( ARQ_LINK *link );
+
+#endif //_RADIO_ARQ_H_
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
@@ -0,0 +1,120 @@
+/*
+================================================================================
+Function : Throughput of the ARQ transport, on the host simulation
+================================================================================
+*/
+
+/*
+    gcc -std=c99 -O2 -DSI446X_SIM -I. -o radio_arq_bench \
+        radio_arq_bench.c radio_arq.c si446x_sim.c si446x.c
+    ./radio_arq_bench [loss %] [window]
+
+Radio 0 sends ARQ_BENCH_FRAMES full payloads to radio 1 over a link, each on
+a bus of its own. Without arguments every window of ARQ_BENCH_WINDOWS is run
+at every loss rate of ARQ_BENCH_LOSS. Throughput is payload bytes delivered
+in order per second of simulated time; the exit code is 1 if a payload was
+lost, reordered or corrupted.
+*/
+
+#include <stdlib.h>
+
+#include "radio_arq.h"
+
+#define ARQ_BENCH_FRAMES    200
+#define ARQ_BENCH_CHANNEL   2
+#define ARQ_BENCH_LIMIT_US  600000000ULL    //simulated time a run may take
+
+static const uint8_t ARQ_BENCH_LOSS[] = { 0, 5, 10, 20, 30 };
+static const uint8_t ARQ_BENCH_WINDOWS[] = { 1, 4, 8, 16 };
+static const INT8U appkey[2] = { 0xA5, 0x5A };
+
+static int failures;
+
+/*Payload number n*/
+static void ARQ_BENCH_PAYLOAD( INT8U *data, INT16U n )
+{
+    INT8U i;
+
+    for( i = 0; i < ARQ_DATA_MAX; i ++ )    { data[i] = ( INT8U )( n * 7 + i ); }
+}
+/*One transfer, returns payload bytes per second*/
+static double ARQ_BENCH_RUN( uint8_t loss, uint8_t window )
+{
+    static SI446X_DEV radio[2];
+    static ARQ_LINK link[2];
+    INT8U data[ARQ_DATA_MAX], expect[ARQ_DATA_MAX];
+    INT16U queued = 0, received = 0;
+    uint64_t start;
+    INT8U i, length;
+
+    SI446X_SIM_INIT( 2, 1 + loss );
+    for( i = 0; i < 2; i ++ )
+    {
+        SI446X_SIM_RADIO_UP( &radio[i], i );
+        SI446X_DEV_ADDRESS_FILTER( &radio[i], 0x10 + i, 0xFF );
+        SI446X_DEV_RX_ENGINE_START( &radio[i], ARQ_BENCH_CHANNEL );
+        ARQ_INIT( &link[i], &radio[i], appkey, 0x10 + i, 0x11 - i, ARQ_BENCH_CHANNEL, window );
+    }
+    SI446X_SIM_RUN( 1000 );
+    SI446X_SIM_LOSS( loss );
+
+    start = SI446X_SIM_NOW( );
+    while( received < ARQ_BENCH_FRAMES && SI446X_SIM_NOW( ) - start < ARQ_BENCH_LIMIT_US * 1000 )
+    {
+        ARQ_BENCH_PAYLOAD( data, queued );
+        while( queued < ARQ_BENCH_FRAMES && ARQ_SEND( &link[0], data, ARQ_DATA_MAX ) == ARQ_OK )
+        {
+            ARQ_BENCH_PAYLOAD( data, ++ queued );
+        }
+        if( ARQ_POLL( &link[0] ) != ARQ_OK || ARQ_POLL( &link[1] ) != ARQ_OK )   { break; }
+        while( ( length = ARQ_RECV( &link[1], data ) ) != 0 )
+        {
+            ARQ_BENCH_PAYLOAD( expect, received ++ );
+            if( length != ARQ_DATA_MAX || memcmp( data, expect, length ) != 0 )
+            {
+                printf( "FAIL: payload %u corrupted\n", received - 1 );
+                failures ++;
+            }
+        }
+        SI446X_SIM_RUN( 200 );
+    }
+    if( received < ARQ_BENCH_FRAMES )
+    {
+        printf( "FAIL: %u of %u payloads, link status %u\n", received, ARQ_BENCH_FRAMES,
+                link[0].status );
+        failures ++;
+    }
+    printf( "%6u %6u %9.0f %7u %7u %7u %8u %8.1f\n", loss, window,
+            received * ARQ_DATA_MAX * 1e9 / ( SI446X_SIM_NOW( ) - start ),
+            ARQ_STATS_GET( &link[0] )->sent, ARQ_STATS_GET( &link[0] )->retransmits,
+            ARQ_STATS_GET( &link[0] )->timeouts, ARQ_STATS_GET( &link[1] )->duplicates,
+            ARQ_RTO_US( &link[0] ) / 1000.0 );
+    return received * ARQ_DATA_MAX * 1e9 / ( SI446X_SIM_NOW( ) - start );
+}
+
+int main( int argc, char **argv )
+{
+    uint8_t l, w;
+
+    printf( "%6s %6s %9s %7s %7s %7s %8s %8s\n", "loss %", "window", "bytes/s",
+            "sent", "resent", "timeout", "dups", "rto ms" );
+    if( argc > 1 )
+    {
+        ARQ_BENCH_RUN( ( uint8_t )atoi( argv[1] ), argc > 2 ? ( uint8_t )atoi( argv[2] ) : 8 );
+        return failures ? 1 : 0;
+    }
+    for( l = 0; l < sizeof( ARQ_BENCH_LOSS ); l ++ )
+    {
+        for( w = 0; w < sizeof( ARQ_BENCH_WINDOWS ); w ++ )
+        {
+            ARQ_BENCH_RUN( ARQ_BENCH_LOSS[l], ARQ_BENCH_WINDOWS[w] );
+        }
+    }
+    return failures ? 1 : 0;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
@@ -0,0 +1,574 @@
+/*
+================================================================================
+Function : AES-CCM authenticated encryption of SI446x frames
+================================================================================
+*/
+
+/*
+Frames are normal SI446x frames, appkey, dst and src first, followed by
+
+    counter     frame counter of src, 4 bytes big endian, in the clear
+    data        the payload, encrypted
+    MIC         CCM_TAG_SIZE bytes
+
+The 8 bytes up to the counter are authenticated but not encrypted, so the
+receiver filters and rebuilds the nonce before decrypting: appkey, src and
+counter, zero filled to CCM_NONCE_SIZE. A key must never see a nonce twice,
+so the counter of a sender starts where the last one left off and a link
+stops sending before it wraps. A receiver takes a src's counters only
+rising, which drops replayed frames.
+
+On the TM4C129 the AES engine does CCM itself. The payload goes through it
+a block at a time on two uDMA channels, and SI446X_SEND_SOURCE writes each
+encrypted block to the TX FIFO while the engine works on the next one; the
+ciphertext is never put together in memory. Received frames are decrypted
+out of their RX slot straight into the caller's buffer, or in place. On the
+host, SI446X_SIM, a software AES-128 stands in for the engine.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef SI446X_SIM
+#include "../global.h"
+#include "inc/hw_aes.h"
+#include "driverlib/aes.h"
+#include "driverlib/udma.h"
+#endif
+#include "radio_ccm.h"
+
+/*B0 flags: Adata, M and L*/
+#define CCM_FLAGS( aad )    ( ( ( aad ) ? 0x40 : 0 ) | ( ( CCM_TAG_SIZE - 2 ) / 2 ) << 3 | ( 2 - 1 ) )
+
+/*State of CCM_SEND between the chunks of its frame*/
+typedef struct
+{
+    CCM_LINK *link;
+    const INT8U *data;
+    INT8U length;
+    INT8U done;             //payload bytes encrypted
+    BOOLEAN tagged;         //the MIC went too
+}CCM_SOURCE;
+
+/*
+=================================================================================
+------------------------------------Internal-------------------------------------
+=================================================================================
+*/
+
+#ifdef SI446X_SIM
+
+static const INT8U CCM_SBOX[256] =
+{
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+    0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+    0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+    0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+    0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+    0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+    0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+    0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+    0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+    0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+    0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+/*Multiply by x in GF(2^8)*/
+#define CCM_XTIME( b )      ( ( INT8U )( ( b ) << 1 ^ ( ( b ) & 0x80 ? 0x1B : 0 ) ) )
+
+/*!
+ * Encrypt one block in place with the expanded key, AES-128
+ *
+ * @param link      the link
+ * @param block     16 bytes
+ */
+static void CCM_AES( const CCM_LINK *link, INT8U *block )
+{
+    const INT8U *rk = link->round_key;
+    INT8U s[16], a, b, c, d, e;
+    INT8U round, i;
+
+    for( i = 0; i < 16; i ++ )  { block[i] ^= rk[i]; }
+    for( round = 1; round <= 10; round ++ )
+    {
+        // SubBytes and ShiftRows together, the state is column major
+        for( i = 0; i < 16; i ++ )  { s[i] = CCM_SBOX[block[( i + 4 * ( i & 3 ) ) & 15]]; }
+        if( round < 10 )
+        {
+            for( i = 0; i < 16; i += 4 )
+            {
+                a = s[i]; b = s[i + 1]; c = s[i + 2]; d = s[i + 3];
+                e = a ^ b ^ c ^ d;
+                s[i]     ^= e ^ CCM_XTIME( a ^ b );
+                s[i + 1] ^= e ^ CCM_XTIME( b ^ c );
+                s[i + 2] ^= e ^ CCM_XTIME( c ^ d );
+                s[i + 3] ^= e ^ CCM_XTIME( d ^ a );
+            }
+        }
+        rk += 16;
+        for( i = 0; i < 16; i ++ )  { block[i] = s[i] ^ rk[i]; }
+    }
+}
+/*!
+ * Expand the key of the link for the software engine
+ *
+ * @param link      the link, key set
+ */
+static void CCM_ENGINE_INIT( CCM_LINK *link )
+{
+    INT8U *rk = link->round_key;
+    INT8U rcon = 0x01, t[4], first, i;
+
+    memcpy( rk, link->key, CCM_KEY_SIZE );
+    for( i = 16; i < 176; i += 4 )
+    {
+        memcpy( t, rk + i - 4, 4 );
+        if( i % 16 == 0 )
+        {
+            first = t[0];
+            t[0] = CCM_SBOX[t[1]] ^ rcon;
+            t[1] = CCM_SBOX[t[2]];
+            t[2] = CCM_SBOX[t[3]];
+            t[3] = CCM_SBOX[first];
+            rcon = CCM_XTIME( rcon );
+        }
+        rk[i]     = rk[i - 16] ^ t[0];
+        rk[i + 1] = rk[i - 15] ^ t[1];
+        rk[i + 2] = rk[i - 14] ^ t[2];
+        rk[i + 3] = rk[i - 13] ^ t[3];
+    }
+}
+/*!
+ * Start a message: B0 and the authenticated header into the CBC-MAC, the
+ * counter block at A0
+ *
+ * @param link      the link
+ * @param nonce     CCM_NONCE_SIZE bytes
+ * @param aad       authenticated header
+ * @param aad_length    CCM_AAD_MAX bytes at most
+ * @param length    payload bytes to come
+ * @param encrypt   BOOL_TRUE to encrypt, BOOL_FALSE to decrypt
+ */
+static void CCM_ENGINE_START( CCM_LINK *link, const INT8U *nonce, const INT8U *aad,
+                              INT8U aad_length, INT8U length, BOOLEAN encrypt )
+{
+    INT8U i;
+
+    link->encrypt = encrypt;
+    link->mac[0] = CCM_FLAGS( aad_length );
+    memcpy( link->mac + 1, nonce, CCM_NONCE_SIZE );
+    link->mac[14] = 0;
+    link->mac[15] = length;
+    CCM_AES( link, link->mac );
+    if( aad_length )
+    {
+        link->mac[1] ^= aad_length;
+        for( i = 0; i < aad_length; i ++ )  { link->mac[2 + i] ^= aad[i]; }
+        CCM_AES( link, link->mac );
+    }
+    link->ctr[0] = 2 - 1;
+    memcpy( link->ctr + 1, nonce, CCM_NONCE_SIZE );
+    link->ctr[14] = 0;
+    link->ctr[15] = 0;
+}
+/*!
+ * Encrypt or decrypt the next block of the message, in place if in is out
+ *
+ * @param link      the link
+ * @param in        the block
+ * @param out       where it goes
+ * @param n         16 bytes, fewer for the last block only
+ */
+static void CCM_ENGINE_BLOCK( CCM_LINK *link, const INT8U *in, INT8U *out, INT8U n )
+{
+    INT8U stream[16], i;
+
+    if( ++ link->ctr[15] == 0 ) { link->ctr[14] ++; }
+    memcpy( stream, link->ctr, 16 );
+    CCM_AES( link, stream );
+    for( i = 0; i < n; i ++ )
+    {
+        if( link->encrypt ) { link->mac[i] ^= in[i]; out[i] = in[i] ^ stream[i]; }
+        else                { out[i] = in[i] ^ stream[i]; link->mac[i] ^= out[i]; }
+    }
+    CCM_AES( link, link->mac );
+}
+/*!
+ * End the message: its MIC, the CBC-MAC encrypted with A0
+ *
+ * @param link      the link
+ * @param tag       CCM_TAG_SIZE bytes
+ */
+static void CCM_ENGINE_FINISH( CCM_LINK *link, INT8U *tag )
+{
+    INT8U i;
+
+    link->ctr[14] = 0;
+    link->ctr[15] = 0;
+    CCM_AES( link, link->ctr );
+    for( i = 0; i < CCM_TAG_SIZE; i ++ )    { tag[i] = link->mac[i] ^ link->ctr[i]; }
+}
+
+#else
+
+/*uDMA channels of the AES engine, data in and data out; 14 and 15 carry its context*/
+#define CCM_DMA_IN          UDMA_CH16_AES0DIN
+#define CCM_DMA_OUT         UDMA_CH17_AES0DOUT
+
+/*!
+ * Power the AES engine and set up its uDMA channels, once. The uDMA
+ * controller must be on, as Si4463_BUS_INIT( ) leaves it.
+ *
+ * @param link      the link
+ */
+static void CCM_ENGINE_INIT( CCM_LINK *link )
+{
+    static BOOLEAN ready = BOOL_FALSE;
+
+    if( ready ) { return; }
+    SysCtlPeripheralEnable( SYSCTL_PERIPH_CCM0 );
+    while( !SysCtlPeripheralReady( SYSCTL_PERIPH_CCM0 ) );
+    AESReset( AES_BASE );
+
+    uDMAChannelAssign( CCM_DMA_IN );
+    uDMAChannelAssign( CCM_DMA_OUT );
+    uDMAChannelAttributeDisable( CCM_DMA_IN, UDMA_ATTR_ALL );
+    uDMAChannelAttributeDisable( CCM_DMA_OUT, UDMA_ATTR_ALL );
+    uDMAChannelControlSet( CCM_DMA_IN | UDMA_PRI_SELECT,
+                           UDMA_SIZE_32 | UDMA_SRC_INC_32 | UDMA_DST_INC_NONE | UDMA_ARB_4 );
+    uDMAChannelControlSet( CCM_DMA_OUT | UDMA_PRI_SELECT,
+                           UDMA_SIZE_32 | UDMA_SRC_INC_NONE | UDMA_DST_INC_32 | UDMA_ARB_4 );
+    ready = BOOL_TRUE;
+}
+/*!
+ * Start a message: the engine builds B0 and the counter blocks from A0, the
+ * authenticated header goes in by the CPU, the payload by the uDMA
+ *
+ * @param link      the link
+ * @param nonce     CCM_NONCE_SIZE bytes
+ * @param aad       authenticated header
+ * @param aad_length    CCM_AAD_MAX bytes at most
+ * @param length    payload bytes to come
+ * @param encrypt   BOOL_TRUE to encrypt, BOOL_FALSE to decrypt
+ */
+static void CCM_ENGINE_START( CCM_LINK *link, const INT8U *nonce, const INT8U *aad,
+                              INT8U aad_length, INT8U length, BOOLEAN encrypt )
+{
+    INT32U key[4], iv[4], block[4];
+
+    link->encrypt = encrypt;
+    memcpy( key, link->key, CCM_KEY_SIZE );
+    ( ( INT8U * )iv )[0] = 2 - 1;
+    memcpy( ( INT8U * )iv + 1, nonce, CCM_NONCE_SIZE );
+    ( ( INT8U * )iv )[14] = 0;
+    ( ( INT8U * )iv )[15] = 0;
+
+    AESConfigSet( AES_BASE, AES_CFG_KEY_SIZE_128BIT | AES_CFG_MODE_CCM | AES_CFG_CTR_WIDTH_128 |
+                            AES_CFG_CCM_L_2 | AES_CFG_CCM_M_8 |
+                            ( encrypt ? AES_CFG_DIR_ENCRYPT : AES_CFG_DIR_DECRYPT ) );
+    AESKey1Set( AES_BASE, key, AES_CFG_KEY_SIZE_128BIT );
+    AESIVSet( AES_BASE, iv );
+    AESLengthSet( AES_BASE, length );
+    AESAuthLengthSet( AES_BASE, aad_length );
+    if( aad_length )
+    {
+        memset( block, 0, sizeof( block ) );
+        memcpy( block, aad, aad_length );
+        AESDataWrite( AES_BASE, block );
+    }
+    AESDMAEnable( AES_BASE, AES_DMA_DATA_IN | AES_DMA_DATA_OUT );
+}
+/*!
+ * Encrypt or decrypt the next block of the message, in place if in is out.
+ * The block is staged word aligned and zero padded, then the uDMA carries it
+ * through the engine; the SPI transfer of the previous chunk runs meanwhile.
+ *
+ * @param link      the link
+ * @param in        the block
+ * @param out       where it goes
+ * @param n         16 bytes, fewer for the last block only
+ */
+static void CCM_ENGINE_BLOCK( CCM_LINK *link, const INT8U *in, INT8U *out, INT8U n )
+{
+    INT32U in_block[4], out_block[4];
+
+    memset( in_block, 0, sizeof( in_block ) );
+    memcpy( in_block, in, n );
+    uDMAChannelTransferSet( CCM_DMA_OUT | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                            ( void * )( AES_BASE + AES_O_DATA_IN_0 ), out_block, 4 );
+    uDMAChannelTransferSet( CCM_DMA_IN | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                            in_block, ( void * )( AES_BASE + AES_O_DATA_IN_0 ), 4 );
+    uDMAChannelEnable( CCM_DMA_OUT );
+    uDMAChannelEnable( CCM_DMA_IN );
+    while( uDMAChannelModeGet( CCM_DMA_OUT | UDMA_PRI_SELECT ) != UDMA_MODE_STOP );
+    memcpy( out, out_block, n );
+}
+/*!
+ * End the message and read its MIC from the engine
+ *
+ * @param link      the link
+ * @param tag       CCM_TAG_SIZE bytes
+ */
+static void CCM_ENGINE_FINISH( CCM_LINK *link, INT8U *tag )
+{
+    INT32U words[4];
+
+    AESDMADisable( AES_BASE, AES_DMA_DATA_IN | AES_DMA_DATA_OUT );
+    AESTagRead( AES_BASE, words );
+    memcpy( tag, words, CCM_TAG_SIZE );
+}
+
+#endif //SI446X_SIM
+
+/*!
+ * Nonce of a frame: appkey, src and counter, zero filled
+ *
+ * @param nonce     CCM_NONCE_SIZE bytes
+ * @param header    the frame, its first CCM_HEADER_SIZE bytes
+ */
+static void CCM_NONCE( INT8U *nonce, const INT8U *header )
+{
+    memset( nonce, 0, CCM_NONCE_SIZE );
+    nonce[0] = header[0];
+    nonce[1] = header[1];
+    nonce[2] = header[3];
+    memcpy( nonce + 3, header + 4, 4 );
+}
+/*!
+ * Next chunk of a frame of CCM_SEND, an SI446X_TX_SOURCE: a block of
+ * ciphertext, then the MIC
+ *
+ * @param arg       the CCM_SOURCE of the frame
+ * @param chunk     SI446X_SOURCE_CHUNK bytes
+ * @return bytes made, 0 at the end
+ */
+static INT8U CCM_SOURCE_NEXT( void *arg, INT8U *chunk )
+{
+    CCM_SOURCE *source = ( CCM_SOURCE * )arg;
+    INT8U n;
+
+    if( source->done < source->length )
+    {
+        n = GetMin( source->length - source->done, 16 );
+        CCM_ENGINE_BLOCK( source->link, source->data + source->done, chunk, n );
+        source->done += n;
+        return n;
+    }
+    if( source->tagged )    { return 0; }
+    CCM_ENGINE_FINISH( source->link, chunk );
+    source->tagged = BOOL_TRUE;
+    return CCM_TAG_SIZE;
+}
+
+/*
+=================================================================================
+-------------------------------------Exports-------------------------------------
+=================================================================================
+*/
+
+/*!
+ * Set up one end of a link. Both ends share the key and the appkey.
+ *
+ * @param link      the link
+ * @param radio     its radio, NULL for the one on SPI0
+ * @param key       CCM_KEY_SIZE bytes, copied
+ * @param appkey    2 bytes
+ * @param address   src of the frames this end sends
+ * @param counter   counter of the first frame sent; it must never repeat
+ *                  under one key, e.g. kept in flash ahead of use and
+ *                  restored from there after a reset
+ */
+void CCM_INIT( CCM_LINK *link, SI446X_DEV *radio, const INT8U *key, const INT8U *appkey,
+               INT8U address, INT32U counter )
+{
+    memset( link, 0, sizeof( *link ) );
+    link->radio = radio ? radio : &g_sSi446xDev0;
+    memcpy( link->key, key, CCM_KEY_SIZE );
+    link->appkey[0] = appkey[0];
+    link->appkey[1] = appkey[1];
+    link->address = address;
+    link->counter = counter;
+    CCM_ENGINE_INIT( link );
+}
+/*!
+ * Encrypt a payload and send it. The header goes to the TX FIFO first, the
+ * ciphertext and MIC follow as the engine makes them.
+ *
+ * @param link      the link
+ * @param dst       destination of the frame
+ * @param data      the payload, read only
+ * @param length    0..CCM_DATA_MAX bytes
+ * @param channel   tx channel
+ * @param condition tx condition, STATE_RX << 4 while the RX engine runs
+ * @return CCM_OK, CCM_ERR_PARAM for a payload too long or a counter used
+ *         up, then a new key is due; CCM_ERR_RADIO
+ */
+INT8U CCM_SEND( CCM_LINK *link, INT8U dst, const INT8U *data, INT8U length, INT8U channel,
+                INT8U condition )
+{
+    INT32U start = Si4463_CYCLES( );
+    INT8U header[CCM_HEADER_SIZE], nonce[CCM_NONCE_SIZE];
+    CCM_SOURCE source;
+    SI446X_SEG seg;
+    INT8U status;
+
+    if( length > CCM_DATA_MAX || link->counter == 0xFFFFFFFFUL )    { return CCM_ERR_PARAM; }
+
+    header[0] = link->appkey[0];
+    header[1] = link->appkey[1];
+    header[2] = dst;
+    header[3] = link->address;
+    header[4] = ( INT8U )( link->counter >> 24 );
+    header[5] = ( INT8U )( link->counter >> 16 );
+    header[6] = ( INT8U )( link->counter >> 8 );
+    header[7] = ( INT8U )link->counter;
+    link->counter ++;
+    CCM_NONCE( nonce, header );
+
+    source.link = link;
+    source.data = data;
+    source.length = length;
+    source.done = 0;
+    source.tagged = BOOL_FALSE;
+    seg.data = header;
+    seg.length = CCM_HEADER_SIZE;
+    CCM_ENGINE_START( link, nonce, header, CCM_HEADER_SIZE, length, BOOL_TRUE );
+    status = SI446X_DEV_SEND_SOURCE( link->radio, &seg, 1, CCM_SOURCE_NEXT, &source,
+                                     length + CCM_TAG_SIZE, channel, condition );
+
+    if( status != SI446X_OK )   { return CCM_ERR_RADIO; }
+
+    link->stats.seal.frames ++;
+    link->stats.seal.bytes += length;
+    link->stats.seal.cycles += Si4463_CYCLES( ) - start;
+    return CCM_OK;
+}
+/*!
+ * Check and decrypt a received frame, e.g. the data of an SI446X_RX_SLOT.
+ * The payload is only handed out once its MIC matched.
+ *
+ * @param link      the link
+ * @param frame     the frame as received
+ * @param length    its length
+ * @param data      CCM_DATA_MAX bytes for the payload; frame + CCM_HEADER_SIZE
+ *                  decrypts in place
+ * @param data_length   set to the payload length
+ * @return CCM_OK, CCM_ERR_PARAM for a frame too short or of another appkey,
+ *         CCM_ERR_REPLAY, CCM_ERR_AUTH; data is cleared for the last one
+ */
+INT8U CCM_OPEN( CCM_LINK *link, const INT8U *frame, INT8U length, INT8U *data, INT8U *data_length )
+{
+    INT32U start = Si4463_CYCLES( ), counter;
+    INT8U nonce[CCM_NONCE_SIZE], status;
+    INT8U src = frame[3];
+
+    if( length < CCM_HEADER_SIZE + CCM_TAG_SIZE || length > CCM_HEADER_SIZE + CCM_DATA_MAX + CCM_TAG_SIZE ||
+        frame[0] != link->appkey[0] || frame[1] != link->appkey[1] )
+    {
+        return CCM_ERR_PARAM;
+    }
+    counter = ( INT32U )frame[4] << 24 | ( INT32U )frame[5] << 16 | ( INT32U )frame[6] << 8 | frame[7];
+    if( counter < link->next[src] )
+    {
+        link->stats.replays ++;
+        return CCM_ERR_REPLAY;
+    }
+
+    length -= CCM_HEADER_SIZE + CCM_TAG_SIZE;
+    CCM_NONCE( nonce, frame );
+    status = CCM_DECRYPT( link, nonce, frame, CCM_HEADER_SIZE, frame + CCM_HEADER_SIZE, data, length,
+                          frame + CCM_HEADER_SIZE + length );
+    if( status != CCM_OK )
+    {
+        link->stats.auth_failures ++;
+        return status;
+    }
+    // A counter of 0xFFFFFFFF is never sent, see CCM_SEND
+    link->next[src] = counter + 1;
+    *data_length = length;
+
+    link->stats.open.frames ++;
+    link->stats.open.bytes += length;
+    link->stats.open.cycles += Si4463_CYCLES( ) - start;
+    return CCM_OK;
+}
+/*!
+ * Encrypt a buffer and make its MIC with the key of the link
+ *
+ * @param link      the link
+ * @param nonce     CCM_NONCE_SIZE bytes
+ * @param aad       authenticated header, not encrypted
+ * @param aad_length    CCM_AAD_MAX bytes at most
+ * @param in        the plaintext
+ * @param out       the ciphertext, may be in
+ * @param length    bytes of both
+ * @param tag       CCM_TAG_SIZE bytes for the MIC
+ */
+void CCM_ENCRYPT( CCM_LINK *link, const INT8U *nonce, const INT8U *aad, INT8U aad_length,
+                  const INT8U *in, INT8U *out, INT8U length, INT8U *tag )
+{
+    INT8U done, n;
+
+    CCM_ENGINE_START( link, nonce, aad, GetMin( aad_length, CCM_AAD_MAX ), length, BOOL_TRUE );
+    for( done = 0; done < length; done += n )
+    {
+        n = GetMin( length - done, 16 );
+        CCM_ENGINE_BLOCK( link, in + done, out + done, n );
+    }
+    CCM_ENGINE_FINISH( link, tag );
+}
+/*!
+ * Decrypt a buffer and check its MIC with the key of the link
+ *
+ * @param link      the link
+ * @param nonce     CCM_NONCE_SIZE bytes
+ * @param aad       authenticated header
+ * @param aad_length    CCM_AAD_MAX bytes at most
+ * @param in        the ciphertext
+ * @param out       the plaintext, may be in
+ * @param length    bytes of both
+ * @param tag       the MIC received, CCM_TAG_SIZE bytes
+ * @return CCM_OK, CCM_ERR_AUTH with out cleared
+ */
+INT8U CCM_DECRYPT( CCM_LINK *link, const INT8U *nonce, const INT8U *aad, INT8U aad_length,
+                   const INT8U *in, INT8U *out, INT8U length, const INT8U *tag )
+{
+    INT8U mine[CCM_TAG_SIZE], diff = 0, done, n;
+
+    CCM_ENGINE_START( link, nonce, aad, GetMin( aad_length, CCM_AAD_MAX ), length, BOOL_FALSE );
+    for( done = 0; done < length; done += n )
+    {
+        n = GetMin( length - done, 16 );
+        CCM_ENGINE_BLOCK( link, in + done, out + done, n );
+    }
+    CCM_ENGINE_FINISH( link, mine );
+
+    // Every byte compared, the time taken tells nothing about the MIC
+    for( n = 0; n < CCM_TAG_SIZE; n ++ )    { diff |= mine[n] ^ tag[n]; }
+    if( diff )
+    {
+        memset( out, 0, length );
+        return CCM_ERR_AUTH;
+    }
+    return CCM_OK;
+}
+/*!
+ * Read the link statistics
+ *
+ * @param link      the link
+ */
+const CCM_STATS *CCM_STATS_GET( CCM_LINK *link )
+{
+    return &link->stats;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
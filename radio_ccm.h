@@ -0,0 +1,95 @@
+/*
+================================================================================
+Function : AES-CCM authenticated encryption of SI446x frames
+================================================================================
+*/
+
+#ifndef _RADIO_CCM_H_
+#define _RADIO_CCM_H_
+
+#include "si446x.h"
+
+/*
+=================================================================================
+------------------------------INTERNAL EXPORT APIs-------------------------------
+=================================================================================
+*/
+
+#define  CCM_KEY_SIZE           16      //AES-128
+#define  CCM_NONCE_SIZE         13      //15 - L, L = 2: payloads below 64 KB
+#define  CCM_TAG_SIZE           8       //M, bytes of the MIC
+#define  CCM_AAD_MAX            14      //authenticated header bytes, one block with their length
+#define  CCM_HEADER_SIZE        8       //appkey, dst, src, frame counter (4), in the clear
+#define  CCM_DATA_MAX           ( VMX_MAX_BUFFER + 4 - CCM_HEADER_SIZE - CCM_TAG_SIZE )  //payload of one frame
+
+/*Status codes*/
+#define  CCM_OK                 0
+#define  CCM_ERR_PARAM          1       //an argument is out of range
+#define  CCM_ERR_AUTH           2       //the MIC does not match: forged, corrupted or another key
+#define  CCM_ERR_REPLAY         3       //the frame counter is not above the last one of its src
+#define  CCM_ERR_RADIO          4       //the driver did not take the frame
+
+/*Frames and time of one direction. Cycles are Si4463_CYCLES( ), AES and SPI included*/
+typedef struct
+{
+    INT32U frames;
+    INT32U bytes;           //payload bytes
+    INT32U cycles;
+}CCM_PATH_STATS;
+
+/*Link statistics*/
+typedef struct
+{
+    CCM_PATH_STATS seal;    //CCM_SEND, encrypted into the TX FIFO
+    CCM_PATH_STATS open;    //CCM_OPEN, decrypted out of a received frame
+    INT32U auth_failures;
+    INT32U replays;
+}CCM_STATS;
+
+/*One end of an encrypted link. Set up with CCM_INIT, then only touched by radio_ccm.c*/
+typedef struct
+{
+    INT8U  key[CCM_KEY_SIZE];
+#ifdef SI446X_SIM
+    INT8U  round_key[176];          //expanded key of the software engine
+    INT8U  mac[16];                 //CBC-MAC of the frame in progress
+    INT8U  ctr[16];                 //its counter block
+#endif
+    SI446X_DEV *radio;              //radio CCM_SEND sends on
+    BOOLEAN encrypt;                //direction of the frame in progress
+    INT8U  appkey[2];
+    INT8U  address;
+    INT32U counter;                 //of the next frame sent
+    INT32U next[256];               //lowest counter taken from each src, 0 before its first frame
+    CCM_STATS stats;
+}CCM_LINK;
+
+/*Set up a link on radio, NULL for the one on SPI0; counter must never repeat under one key*/
+void CCM_INIT( CCM_LINK *link, SI446X_DEV *radio, const INT8U *key, const INT8U *appkey,
+               INT8U address, INT32U counter );
+
+/*Encrypt a payload of CCM_DATA_MAX bytes at most into the TX FIFO and send it*/
+INT8U CCM_SEND( CCM_LINK *link, INT8U dst, const INT8U *data, INT8U length, INT8U channel,
+                INT8U condition );
+
+/*Check and decrypt a received frame, data may be frame + CCM_HEADER_SIZE*/
+INT8U CCM_OPEN( CCM_LINK *link, const INT8U *frame, INT8U length, INT8U *data, INT8U *data_length );
+
+/*Encrypt a buffer and make its MIC, the RFC 3610 packet format with M = 8, L = 2*/
+void CCM_ENCRYPT( CCM_LINK *link, const INT8U *nonce, const INT8U *aad, INT8U aad_length,
+                  const INT8U *in, INT8U *out, INT8U length, INT8U *tag );
+
+/*Decrypt a buffer and check its MIC; out is cleared if it does not match*/
+INT8U CCM_DECRYPT( CCM_LINK *link, const INT8U *nonce, const INT8U *aad, INT8U aad_length,
+                   const INT8U *in, INT8U *out, INT8U length, const INT8U *tag );
+
+/*Read the link statistics*/
+const CCM_STATS *CCM_STATS_GET( CCM_LINK *link );
+
+#endif //_RADIO_CCM_H_
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
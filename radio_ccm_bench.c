@@ -0,0 +1,239 @@
+/*
+================================================================================
+Function : Vectors and cost of the AES-CCM link encryption, on the host simulation
+================================================================================
+*/
+
+/*
+    gcc -std=c99 -O2 -DSI446X_SIM -I. -o radio_ccm_bench \
+        radio_ccm_bench.c radio_ccm.c si446x_sim.c si446x.c
+    ./radio_ccm_bench
+
+The software engine is checked against the packet vectors of RFC 3610,
+which use the same M = 8, L = 2 and 8 header bytes as the frames. Then radio
+0 sends CCM_BENCH_FRAMES full payloads to radio 1, which opens them out of
+its RX slots; a replayed and a tampered frame must be refused.
+
+Per path, sim cyc/B is Si4463_CYCLES( ) per payload byte as CCM_STATS_GET
+counts it: in the simulation only the SPI and the radio take time, so it
+is what the encryption adds to the bus, against a plain SEND_SEG of the
+same frame. host ns/B is the software engine alone on this machine. On the
+target CCM_STATS_GET gives the AES engine and the SPI together. The exit
+code is 1 if a check failed.
+*/
+
+#include <time.h>
+
+#include "radio_ccm.h"
+
+#define CCM_BENCH_FRAMES    50
+#define CCM_BENCH_CHANNEL   2
+#define CCM_BENCH_LOOPS     20000       //host timing of the software engine
+
+static const INT8U appkey[2] = { 0xA5, 0x5A };
+static const INT8U bench_key[CCM_KEY_SIZE] =
+{
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+/*RFC 3610 packet vectors #1 to #3: key C0..CF, 8 header bytes*/
+typedef struct
+{
+    INT8U nonce[CCM_NONCE_SIZE];
+    INT8U length;                   //of the packet, header included
+    INT8U result[48];               //header, ciphertext and MIC
+}CCM_VECTOR;
+
+static const CCM_VECTOR vectors[] =
+{
+    {
+        { 0x00, 0x00, 0x00, 0x03, 0x02, 0x01, 0x00, 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5 }, 31,
+        {
+            0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x58, 0x8C, 0x97, 0x9A, 0x61, 0xC6, 0x63, 0xD2,
+            0xF0, 0x66, 0xD0, 0xC2, 0xC0, 0xF9, 0x89, 0x80, 0x6D, 0x5F, 0x6B, 0x61, 0xDA, 0xC3, 0x84, 0x17,
+            0xE8, 0xD1, 0x2C, 0xFD, 0xF9, 0x26, 0xE0
+        }
+    },
+    {
+        { 0x00, 0x00, 0x00, 0x04, 0x03, 0x02, 0x01, 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5 }, 32,
+        {
+            0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x72, 0xC9, 0x1A, 0x36, 0xE1, 0x35, 0xF8, 0xCF,
+            0x29, 0x1C, 0xA8, 0x94, 0x08, 0x5C, 0x87, 0xE3, 0xCC, 0x15, 0xC4, 0x39, 0xC9, 0xE4, 0x3A, 0x3B,
+            0xA0, 0x91, 0xD5, 0x6E, 0x10, 0x40, 0x09, 0x16
+        }
+    },
+    {
+        { 0x00, 0x00, 0x00, 0x05, 0x04, 0x03, 0x02, 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5 }, 33,
+        {
+            0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x51, 0xB1, 0xE5, 0xF4, 0x4A, 0x19, 0x7D, 0x1D,
+            0xA4, 0x6B, 0x0F, 0x8E, 0x2D, 0x28, 0x2A, 0xE8, 0x71, 0xE8, 0x38, 0xBB, 0x64, 0xDA, 0x85, 0x96,
+            0x57, 0x4A, 0xDA, 0xA7, 0x6F, 0xBD, 0x9F, 0xB0, 0xC5
+        }
+    }
+};
+
+static int failures;
+
+static void CCM_BENCH_CHECK( int ok, const char *what )
+{
+    if( !ok )
+    {
+        printf( "FAIL: %s\n", what );
+        failures ++;
+    }
+}
+
+/*RFC 3610 vectors, both ways, and a flipped bit*/
+static void CCM_BENCH_VECTORS( void )
+{
+    static CCM_LINK link;
+    INT8U key[CCM_KEY_SIZE], packet[48], out[48], tag[CCM_TAG_SIZE];
+    INT8U v, i, length;
+
+    for( i = 0; i < CCM_KEY_SIZE; i ++ )    { key[i] = 0xC0 + i; }
+    CCM_INIT( &link, NULL, key, appkey, 0x10, 0 );
+    for( v = 0; v < sizeof( vectors ) / sizeof( vectors[0] ); v ++ )
+    {
+        length = vectors[v].length - 8;
+        for( i = 0; i < vectors[v].length; i ++ )   { packet[i] = i; }
+
+        CCM_ENCRYPT( &link, vectors[v].nonce, packet, 8, packet + 8, out, length, tag );
+        CCM_BENCH_CHECK( memcmp( out, vectors[v].result + 8, length ) == 0 &&
+                         memcmp( tag, vectors[v].result + 8 + length, CCM_TAG_SIZE ) == 0,
+                         "RFC 3610 vector encrypted" );
+
+        memcpy( out, vectors[v].result + 8, length );
+        CCM_BENCH_CHECK( CCM_DECRYPT( &link, vectors[v].nonce, packet, 8, out, out, length,
+                                      vectors[v].result + 8 + length ) == CCM_OK &&
+                         memcmp( out, packet + 8, length ) == 0, "RFC 3610 vector decrypted in place" );
+
+        memcpy( out, vectors[v].result + 8, length );
+        out[length / 2] ^= 0x01;
+        CCM_BENCH_CHECK( CCM_DECRYPT( &link, vectors[v].nonce, packet, 8, out, out, length,
+                                      vectors[v].result + 8 + length ) == CCM_ERR_AUTH &&
+                         out[0] == 0 && out[length - 1] == 0, "flipped bit refused, output cleared" );
+    }
+}
+
+/*ns per byte of the software engine, one way*/
+static double CCM_BENCH_HOST( BOOLEAN encrypt )
+{
+    static CCM_LINK link;
+    INT8U nonce[CCM_NONCE_SIZE] = { 0 }, data[CCM_DATA_MAX], tag[CCM_TAG_SIZE] = { 0 };
+    clock_t start;
+    INT32U i;
+
+    CCM_INIT( &link, NULL, bench_key, appkey, 0x10, 0 );
+    memset( data, 0x3C, sizeof( data ) );
+    start = clock( );
+    for( i = 0; i < CCM_BENCH_LOOPS; i ++ )
+    {
+        nonce[3] = ( INT8U )i;
+        if( encrypt )   { CCM_ENCRYPT( &link, nonce, data, 8, data, data, sizeof( data ), tag ); }
+        else            { CCM_DECRYPT( &link, nonce, data, 8, data, data, sizeof( data ), tag ); }
+    }
+    return ( double )( clock( ) - start ) / CLOCKS_PER_SEC * 1e9 / ( ( double )CCM_BENCH_LOOPS * sizeof( data ) );
+}
+
+/*Full payloads over the air, radio 0 to radio 1*/
+static void CCM_BENCH_AIR( void )
+{
+    static SI446X_DEV radio[2];
+    static CCM_LINK tx, rx, fresh;
+    const SI446X_RX_SLOT *slot;
+    const CCM_STATS *stats;
+    INT8U data[CCM_DATA_MAX], got[CCM_DATA_MAX], frame[SI446X_RX_SLOT_SIZE], header[4];
+    INT8U last[SI446X_RX_SLOT_SIZE], last_length = 0, length, sent, opened = 0;
+    INT32U plain = 0, start;
+    SI446X_SEG seg[2];
+    uint64_t limit;
+
+    SI446X_SIM_INIT( 2, 1 );
+    SI446X_SIM_DMA_ASYNC( true );       //blocks stay in flight while the next one is sealed
+    SI446X_SIM_RADIO_UP( &radio[0], 0 );
+    SI446X_SIM_RADIO_UP( &radio[1], 1 );
+    SI446X_DEV_RX_ENGINE_START( &radio[1], CCM_BENCH_CHANNEL );
+    CCM_INIT( &rx, &radio[1], bench_key, appkey, 0x11, 0 );
+    CCM_INIT( &tx, &radio[0], bench_key, appkey, 0x10, 1000 );
+
+    for( sent = 0; sent < CCM_BENCH_FRAMES; sent ++ )
+    {
+        memset( data, sent, sizeof( data ) );
+        CCM_BENCH_CHECK( CCM_SEND( &tx, 0x11, data, sizeof( data ), CCM_BENCH_CHANNEL, 0 ) == CCM_OK,
+                         "CCM_SEND" );
+        for( limit = SI446X_SIM_NOW( ) + 100000000ULL; SI446X_SIM_NOW( ) < limit; )
+        {
+            SI446X_SIM_RUN( 500 );
+            slot = SI446X_DEV_RX_PEEK( &radio[1] );
+            if( slot != NULL )
+            {
+                CCM_BENCH_CHECK( CCM_OPEN( &rx, slot->data, slot->length, got, &length ) == CCM_OK &&
+                                 length == sizeof( data ) && memcmp( got, data, length ) == 0,
+                                 "payload opened" );
+                memcpy( last, slot->data, slot->length );
+                last_length = slot->length;
+                SI446X_DEV_RX_RELEASE( &radio[1] );
+                opened ++;
+                break;
+            }
+        }
+    }
+    CCM_BENCH_CHECK( opened == CCM_BENCH_FRAMES, "every frame received" );
+    SI446X_SIM_SELECT( 0 );
+    CCM_BENCH_CHECK( SI446X_SIM_STATS_GET( )->dma_conflicts == 0, "no bus access with a block in flight" );
+
+    CCM_BENCH_CHECK( CCM_OPEN( &rx, last, last_length, got, &length ) == CCM_ERR_REPLAY, "replay refused" );
+    memcpy( frame, last, last_length );
+    frame[7] ++;
+    CCM_BENCH_CHECK( CCM_OPEN( &rx, frame, last_length, got, &length ) == CCM_ERR_AUTH,
+                     "forged counter refused" );
+    memcpy( frame, last, last_length );
+    frame[last_length - 1] ^= 0x80;
+    frame[7] += 2;
+    CCM_BENCH_CHECK( CCM_OPEN( &rx, frame, last_length, got, &length ) == CCM_ERR_AUTH,
+                     "forged MIC refused" );
+    memcpy( frame, last, last_length );
+    CCM_INIT( &fresh, &radio[1], bench_key, appkey, 0x11, 0 );
+    CCM_BENCH_CHECK( CCM_OPEN( &fresh, frame, last_length, frame + CCM_HEADER_SIZE, &length ) == CCM_OK &&
+                     memcmp( frame + CCM_HEADER_SIZE, data, length ) == 0, "opened in place" );
+
+    // The same frame in the clear, for the bus time it takes
+    header[0] = appkey[0];
+    header[1] = appkey[1];
+    header[2] = 0x11;
+    header[3] = 0x10;
+    seg[0].data = header;
+    seg[0].length = 4;
+    seg[1].data = frame;
+    seg[1].length = last_length - 4;
+    for( sent = 0; sent < CCM_BENCH_FRAMES; sent ++ )
+    {
+        start = Si4463_CYCLES( );
+        SI446X_DEV_SEND_SEG( &radio[0], seg, 2, CCM_BENCH_CHANNEL, 0 );
+        plain += Si4463_CYCLES( ) - start;
+        SI446X_SIM_RUN( 100000 );
+    }
+
+    stats = CCM_STATS_GET( &tx );
+    printf( "%-22s %7u %10.1f %10s\n", "SEND_SEG, clear", CCM_BENCH_FRAMES * CCM_DATA_MAX,
+            ( double )plain / ( CCM_BENCH_FRAMES * CCM_DATA_MAX ), "-" );
+    printf( "%-22s %7u %10.1f %10.1f\n", "CCM_SEND, seal", stats->seal.bytes,
+            ( double )stats->seal.cycles / stats->seal.bytes, CCM_BENCH_HOST( BOOL_TRUE ) );
+    stats = CCM_STATS_GET( &rx );
+    printf( "%-22s %7u %10.1f %10.1f\n", "CCM_OPEN, open", stats->open.bytes,
+            ( double )stats->open.cycles / stats->open.bytes, CCM_BENCH_HOST( BOOL_FALSE ) );
+}
+
+int main( void )
+{
+    CCM_BENCH_VECTORS( );
+    printf( "%-22s %7s %10s %10s\n", "path", "bytes", "sim cyc/B", "host ns/B" );
+    CCM_BENCH_AIR( );
+    return failures ? 1 : 0;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
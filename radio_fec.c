@@ -0,0 +1,518 @@
+/*
+================================================================================
+Function : Reed-Solomon erasure coding across SI446x frames
+================================================================================
+*/
+
+/*
+The packet handler checks the CRC of every frame and drops the bad ones, so
+on a weak link frames are lost whole and a code inside the frame has nothing
+to correct. Frames are coded across instead: every k data frames to one
+destination are followed by m parity frames, and any k of the k + m frames
+give back the k payloads, m losses per group at most.
+
+    appkey ^ FEC_APPKEY_CODED (2), dst, src, group, index, k << 4 | m, shard
+
+Data frames carry their payload unchanged, a length byte before it, and go
+out as soon as they are given; index 0..k-1. Parity frame j is index
+FEC_K_MAX + j and as long as the longest data shard of its group, shorter
+shards counting as zero padded. A group ended early by FEC_FLUSH declares
+its real k in its parity frames.
+
+The code is a systematic Cauchy Reed-Solomon code over GF(2^8), polynomial
+0x11D: parity j = sum over i of d_i / ( x_j + y_i ), x_j = FEC_K_MAX + j,
+y_i = i. Every square submatrix of a Cauchy matrix can be inverted, so any
+e <= m lost data shards are solved from e parity shards. Products go through
+log, exp and coefficient log tables, 800 bytes of flash and no multiplier,
+one table look up pair per byte and parity frame on the Cortex-M4.
+
+Coded frames carry an appkey reserved for them, the one of the network with
+FEC_APPKEY_CODED flipped, so nothing another layer sends can look coded. A
+node sending with m = 0 sends plain frames under the appkey itself, and
+FEC_INPUT hands back FEC_PASS for every frame it did not code, so coded and
+uncoded nodes share the channel.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef SI446X_SIM
+#include "../global.h"
+#endif
+#include "radio_fec.h"
+
+#define FEC_BIT( i )        ( ( INT16U )1 << ( i ) )
+
+/*
+=================================================================================
+-----------------------------------Internal--------------------------------------
+=================================================================================
+*/
+
+/*Powers of 2 in GF(2^8), twice over so a sum of two logs needs no modulo*/
+static const INT8U FEC_EXP[512] =
+{
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+    0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+    0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+    0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+    0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+    0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+    0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+    0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+    0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+    0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+    0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+    0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+    0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+    0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+    0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+    0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01,
+    0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26, 0x4C,
+    0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x9D,
+    0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23, 0x46,
+    0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1, 0x5F,
+    0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0, 0xFD,
+    0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2, 0xD9,
+    0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE, 0x81,
+    0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC, 0x85,
+    0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54, 0xA8,
+    0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73, 0xE6,
+    0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF, 0xE3,
+    0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41, 0x82,
+    0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6, 0x51,
+    0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09, 0x12,
+    0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16, 0x2C,
+    0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01, 0x02
+};
+
+/*Logarithms base 2, FEC_LOG[0] unused*/
+static const INT8U FEC_LOG[256] =
+{
+    0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6, 0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+    0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81, 0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+    0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21, 0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+    0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9, 0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+    0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD, 0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+    0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD, 0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+    0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E, 0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+    0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B, 0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+    0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D, 0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+    0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C, 0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+    0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD, 0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+    0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E, 0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+    0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76, 0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+    0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA, 0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+    0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51, 0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+    0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8, 0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF
+};
+
+/*Logarithms of the Cauchy coefficients 1 / ( x_j + y_i ), parity j, data i*/
+static const INT8U FEC_COEF_LOG[FEC_M_MAX][FEC_K_MAX] =
+{
+    { 0xFC, 0x20, 0xCC, 0x11, 0xE4, 0x97, 0x38, 0xB4 },
+    { 0x20, 0xFC, 0x11, 0xCC, 0x97, 0xE4, 0xB4, 0x38 },
+    { 0xCC, 0x11, 0xFC, 0x20, 0x38, 0xB4, 0xE4, 0x97 },
+    { 0x11, 0xCC, 0x20, 0xFC, 0xB4, 0x38, 0x97, 0xE4 }
+};
+
+/*Product of two field elements*/
+static INT8U FEC_MUL( INT8U a, INT8U b )
+{
+    return ( a == 0 || b == 0 ) ? 0 : FEC_EXP[FEC_LOG[a] + FEC_LOG[b]];
+}
+/*Count the data shards the group being left could not get back*/
+static void FEC_RX_END( FEC_RX *fec )
+{
+    INT8U i;
+
+    for( i = 0; i < fec->k; i ++ )
+    {
+        if( !( fec->have & FEC_BIT( i ) ) ) { fec->stats.unrecovered ++; }
+    }
+}
+
+/*
+=================================================================================
+------------------------------------Exports--------------------------------------
+=================================================================================
+*/
+
+/*!
+ * Add a data shard to the parity shards of its group, which start zeroed
+ *
+ * @param index     0..FEC_K_MAX - 1, place of the shard in its group
+ * @param shard     length byte and payload
+ * @param size      bytes of shard, zero padding after them needs no work
+ * @param m         parity shards, 1..FEC_M_MAX
+ * @param parity    the parity shards
+ */
+void FEC_ENCODE( INT8U index, const INT8U *shard, INT8U size, INT8U m,
+                 INT8U parity[][FEC_SHARD_SIZE] )
+{
+    INT16U l;
+    INT8U b, j;
+
+    for( b = 0; b < size; b ++ )
+    {
+        if( shard[b] == 0 ) { continue; }
+        l = FEC_LOG[shard[b]];
+        for( j = 0; j < m; j ++ )
+        {
+            parity[j][b] ^= FEC_EXP[l + FEC_COEF_LOG[j][index]];
+        }
+    }
+}
+/*!
+ * Rebuild the missing data shards of a group. Needs as many parity shards as
+ * data shards are missing; the parity shards taken are overwritten.
+ *
+ * @param shard     FEC_K_MAX data shards then FEC_M_MAX parity shards
+ * @param have      bit i set for shard i present, parity j at FEC_K_MAX + j;
+ *                  the rebuilt data shards are added
+ * @param k         data shards of the group
+ * @param m         parity shards looked at
+ * @param size      bytes of the parity shards
+ * @return data shards rebuilt, 0 if none was missing or too few parity shards
+ */
+INT8U FEC_DECODE( INT8U shard[][FEC_SHARD_SIZE], INT16U *have, INT8U k, INT8U m, INT8U size )
+{
+    INT8U lost[FEC_M_MAX], row[FEC_M_MAX];
+    INT8U a[FEC_M_MAX][FEC_M_MAX], inv[FEC_M_MAX][FEC_M_MAX];
+    INT8U e = 0, n = 0, i, j, c, r, b, f, t;
+    INT8U *s, *out;
+    INT16U l;
+
+    for( i = 0; i < k; i ++ )
+    {
+        if( *have & FEC_BIT( i ) )  { continue; }
+        if( e == FEC_M_MAX )        { return 0; }
+        lost[e ++] = i;
+    }
+    for( j = 0; j < m && n < e; j ++ )
+    {
+        if( *have & FEC_BIT( FEC_K_MAX + j ) )  { row[n ++] = j; }
+    }
+    if( e == 0 || n < e )   { return 0; }
+
+    // Take the data received out of the parity, what is left is the lost data only
+    for( i = 0; i < k; i ++ )
+    {
+        if( !( *have & FEC_BIT( i ) ) ) { continue; }
+        for( b = 0; b < size; b ++ )
+        {
+            if( shard[i][b] == 0 )  { continue; }
+            l = FEC_LOG[shard[i][b]];
+            for( r = 0; r < e; r ++ )
+            {
+                shard[FEC_K_MAX + row[r]][b] ^= FEC_EXP[l + FEC_COEF_LOG[row[r]][i]];
+            }
+        }
+    }
+
+    // Invert the e x e Cauchy submatrix, Gauss-Jordan
+    for( r = 0; r < e; r ++ )
+    {
+        for( c = 0; c < e; c ++ )
+        {
+            a[r][c] = FEC_EXP[FEC_COEF_LOG[row[r]][lost[c]]];
+            inv[r][c] = r == c;
+        }
+    }
+    for( c = 0; c < e; c ++ )
+    {
+        for( r = c; a[r][c] == 0; r ++ );
+        for( i = 0; r != c && i < e; i ++ )
+        {
+            t = a[r][i]; a[r][i] = a[c][i]; a[c][i] = t;
+            t = inv[r][i]; inv[r][i] = inv[c][i]; inv[c][i] = t;
+        }
+        f = FEC_EXP[255 - FEC_LOG[a[c][c]]];
+        for( i = 0; i < e; i ++ )
+        {
+            a[c][i] = FEC_MUL( a[c][i], f );
+            inv[c][i] = FEC_MUL( inv[c][i], f );
+        }
+        for( r = 0; r < e; r ++ )
+        {
+            if( r == c || ( f = a[r][c] ) == 0 )    { continue; }
+            for( i = 0; i < e; i ++ )
+            {
+                a[r][i] ^= FEC_MUL( a[c][i], f );
+                inv[r][i] ^= FEC_MUL( inv[c][i], f );
+            }
+        }
+    }
+
+    for( c = 0; c < e; c ++ )
+    {
+        out = shard[lost[c]];
+        memset( out, 0, FEC_SHARD_SIZE );
+        for( r = 0; r < e; r ++ )
+        {
+            if( inv[c][r] == 0 )    { continue; }
+            l = FEC_LOG[inv[c][r]];
+            s = shard[FEC_K_MAX + row[r]];
+            for( b = 0; b < size; b ++ )
+            {
+                if( s[b] != 0 ) { out[b] ^= FEC_EXP[l + FEC_LOG[s[b]]]; }
+            }
+        }
+        *have |= FEC_BIT( lost[c] );
+    }
+    return e;
+}
+/*!
+ * Set up the sending end for one destination
+ *
+ * @param fec           the sending end
+ * @param radio         its radio, NULL for the one on SPI0
+ * @param appkey        2 bytes, of the network; coded frames flip FEC_APPKEY_CODED
+ * @param dst           destination of the frames
+ * @param src           address of this node
+ * @param channel       tx channel
+ * @param condition     tx condition, STATE_RX << 4 while the RX engine runs
+ * @param k             data frames of a group, 1..FEC_K_MAX
+ * @param m             parity frames of a group, 0..FEC_M_MAX, 0 for plain frames
+ * @return FEC_OK, FEC_ERR_PARAM
+ */
+INT8U FEC_TX_INIT( FEC_TX *fec, SI446X_DEV *radio, const INT8U *appkey, INT8U dst, INT8U src,
+                   INT8U channel, INT8U condition, INT8U k, INT8U m )
+{
+    if( k == 0 || k > FEC_K_MAX || m > FEC_M_MAX )  { return FEC_ERR_PARAM; }
+    memset( fec, 0, sizeof( *fec ) );
+    fec->radio = radio ? radio : &g_sSi446xDev0;
+    fec->header[0] = m ? appkey[0] ^ FEC_APPKEY_CODED : appkey[0];
+    fec->header[1] = appkey[1];
+    fec->header[2] = dst;
+    fec->header[3] = src;
+    fec->channel = channel;
+    fec->condition = condition;
+    fec->k = k;
+    fec->m = m;
+    return FEC_OK;
+}
+/*!
+ * Send the parity frames of the group now, they cover the data frames sent
+ * so far. One frame goes out per call while the radio is free.
+ *
+ * @param fec       the sending end
+ * @return FEC_OK once the group is sent, FEC_ERR_BUSY while parity is left,
+ *         FEC_ERR_RADIO if the driver did not take the next one
+ */
+INT8U FEC_FLUSH( FEC_TX *fec )
+{
+    SI446X_SEG seg[2];
+
+    if( fec->m == 0 || fec->count == 0 )    { return FEC_OK; }
+    fec->header[6] = ( INT8U )( fec->count << 4 | fec->m );
+    while( fec->parity_sent < fec->m )
+    {
+        if( SI446X_DEV_TX_BUSY( fec->radio ) )  { return FEC_ERR_BUSY; }
+        fec->header[5] = FEC_K_MAX + fec->parity_sent;
+        seg[0].data = fec->header;
+        seg[0].length = sizeof( fec->header );
+        seg[1].data = fec->parity[fec->parity_sent];
+        seg[1].length = fec->size;
+        if( SI446X_DEV_SEND_SEG( fec->radio, seg, 2, fec->channel, fec->condition ) != SI446X_OK )
+        {
+            return FEC_ERR_RADIO;
+        }
+        fec->parity_sent ++;
+        fec->stats.parity ++;
+    }
+
+    memset( fec->parity, 0, sizeof( fec->parity ) );
+    fec->header[4] ++;
+    fec->count = 0;
+    fec->size = 0;
+    fec->parity_sent = 0;
+    fec->stats.groups ++;
+    return FEC_OK;
+}
+/*!
+ * Send a payload as the next data frame of the group. The parity frames of
+ * a full group go out first, one per call.
+ *
+ * @param fec       the sending end
+ * @param data      the payload
+ * @param length    1..FEC_DATA_MAX bytes
+ * @return FEC_OK, FEC_ERR_PARAM, or FEC_ERR_BUSY or FEC_ERR_RADIO if it was
+ *         not sent
+ */
+INT8U FEC_SEND( FEC_TX *fec, const INT8U *data, INT8U length )
+{
+    INT8U shard[FEC_SHARD_SIZE];
+    SI446X_SEG seg[2];
+    INT32U start;
+    INT8U status;
+
+    if( length == 0 || length > FEC_DATA_MAX )  { return FEC_ERR_PARAM; }
+    if( fec->m == 0 )
+    {
+        if( SI446X_DEV_TX_BUSY( fec->radio ) )  { return FEC_ERR_BUSY; }
+        seg[0].data = fec->header;
+        seg[0].length = 4;
+        seg[1].data = data;
+        seg[1].length = length;
+        if( SI446X_DEV_SEND_SEG( fec->radio, seg, 2, fec->channel, fec->condition ) != SI446X_OK )
+        {
+            return FEC_ERR_RADIO;
+        }
+        fec->stats.data ++;
+        return FEC_OK;
+    }
+    if( fec->count == fec->k || fec->parity_sent != 0 )
+    {
+        if( ( status = FEC_FLUSH( fec ) ) != FEC_OK )   { return status; }
+    }
+    if( SI446X_DEV_TX_BUSY( fec->radio ) )  { return FEC_ERR_BUSY; }
+
+    shard[0] = length;
+    memcpy( shard + 1, data, length );
+    fec->header[5] = fec->count;
+    fec->header[6] = ( INT8U )( fec->k << 4 | fec->m );
+    seg[0].data = fec->header;
+    seg[0].length = sizeof( fec->header );
+    seg[1].data = shard;
+    seg[1].length = length + 1;
+    if( SI446X_DEV_SEND_SEG( fec->radio, seg, 2, fec->channel, fec->condition ) != SI446X_OK )
+    {
+        return FEC_ERR_RADIO;
+    }
+
+    start = Si4463_CYCLES( );
+    FEC_ENCODE( fec->count, shard, length + 1, fec->m, fec->parity );
+    fec->stats.cycles += Si4463_CYCLES( ) - start;
+    if( length + 1 > fec->size )    { fec->size = length + 1; }
+    fec->count ++;
+    fec->stats.data ++;
+    return FEC_OK;
+}
+/*!
+ * Read the statistics of the sending end
+ *
+ * @param fec       the sending end
+ */
+const FEC_STATS *FEC_TX_STATS_GET( FEC_TX *fec )
+{
+    return &fec->stats;
+}
+/*!
+ * Set up the receiving end for one source
+ *
+ * @param fec       the receiving end
+ * @param appkey    2 bytes, of the network, as given to FEC_TX_INIT
+ */
+void FEC_RX_INIT( FEC_RX *fec, const INT8U *appkey )
+{
+    memset( fec, 0, sizeof( *fec ) );
+    fec->appkey[0] = appkey[0] ^ FEC_APPKEY_CODED;
+    fec->appkey[1] = appkey[1];
+}
+/*!
+ * Take a received frame, e.g. the data of an SI446X_RX_SLOT. The lost data
+ * frames of its group are rebuilt as soon as enough parity is in.
+ *
+ * @param fec       the receiving end
+ * @param frame     appkey, dst, src, then the FEC header and a shard
+ * @param length    frame length
+ * @return FEC_OK, FEC_PASS if the frame is not coded, for the layer above,
+ *         FEC_ERR_FRAME if its header is bad or its group left behind
+ */
+INT8U FEC_INPUT( FEC_RX *fec, const INT8U *frame, INT8U length )
+{
+    INT8U group, index, k, m, size;
+    INT32U start;
+
+    if( length < 2 || frame[0] != fec->appkey[0] || frame[1] != fec->appkey[1] )   { return FEC_PASS; }
+    if( length < 4 + FEC_HEADER_SIZE + 1 )  { return FEC_ERR_FRAME; }
+    group = frame[4];
+    index = frame[5];
+    k = frame[6] >> 4;
+    m = frame[6] & 0x0F;
+    size = length - 4 - FEC_HEADER_SIZE;
+    if( k == 0 || k > FEC_K_MAX || m == 0 || m > FEC_M_MAX || size > FEC_SHARD_SIZE )
+    {
+        return FEC_ERR_FRAME;
+    }
+    if( index < FEC_K_MAX ? ( index >= k || frame[7] == 0 || frame[7] != size - 1 )
+                          : ( index - FEC_K_MAX >= m ) )
+    {
+        return FEC_ERR_FRAME;
+    }
+
+    if( !fec->active || frame[3] != fec->src || group != fec->group )
+    {
+        if( fec->active && frame[3] == fec->src && ( INT8S )( group - fec->group ) < 0 )
+        {
+            fec->stats.late ++;
+            return FEC_ERR_FRAME;
+        }
+        if( fec->active )   { FEC_RX_END( fec ); }
+        fec->active = BOOL_TRUE;
+        fec->src = frame[3];
+        fec->group = group;
+        fec->k = k;
+        fec->size = 0;
+        fec->have = 0;
+        fec->delivered = 0;
+        fec->stats.groups ++;
+    }
+    if( fec->have & FEC_BIT( index ) )  { return FEC_OK; }
+
+    memcpy( fec->shard[index], frame + 4 + FEC_HEADER_SIZE, size );
+    memset( fec->shard[index] + size, 0, FEC_SHARD_SIZE - size );
+    fec->have |= FEC_BIT( index );
+    if( index < FEC_K_MAX )
+    {
+        fec->stats.data ++;
+        return FEC_OK;
+    }
+    fec->stats.parity ++;
+    fec->k = k;
+    fec->size = size;
+
+    start = Si4463_CYCLES( );
+    fec->stats.recovered += FEC_DECODE( fec->shard, &fec->have, fec->k, FEC_M_MAX, fec->size );
+    fec->stats.cycles += Si4463_CYCLES( ) - start;
+    return FEC_OK;
+}
+/*!
+ * Next payload of the group, received or rebuilt. Data frames are handed
+ * over as they come; a rebuilt one may follow later ones of its group.
+ *
+ * @param fec       the receiving end
+ * @param buffer    FEC_DATA_MAX bytes
+ * @return payload length, 0 if there is none
+ */
+INT8U FEC_RECV( FEC_RX *fec, INT8U *buffer )
+{
+    INT8U i, length;
+
+    for( i = 0; i < fec->k; i ++ )
+    {
+        if( !( fec->have & FEC_BIT( i ) ) || ( fec->delivered & FEC_BIT( i ) ) )    { continue; }
+        fec->delivered |= FEC_BIT( i );
+        length = fec->shard[i][0];
+        if( length == 0 || length > FEC_DATA_MAX )  { continue; }
+        memcpy( buffer, fec->shard[i] + 1, length );
+        return length;
+    }
+    return 0;
+}
+/*!
+ * Read the statistics of the receiving end
+ *
+ * @param fec       the receiving end
+ */
+const FEC_STATS *FEC_RX_STATS_GET( FEC_RX *fec )
+{
+    return &fec->stats;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
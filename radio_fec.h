@@ -0,0 +1,114 @@
+/*
+================================================================================
+Function : Reed-Solomon erasure coding across SI446x frames
+================================================================================
+*/
+
+#ifndef _RADIO_FEC_H_
+#define _RADIO_FEC_H_
+
+#include "si446x.h"
+
+/*
+=================================================================================
+------------------------------INTERNAL EXPORT APIs-------------------------------
+=================================================================================
+*/
+
+#define  FEC_K_MAX              8       //data frames of a group
+#define  FEC_M_MAX              4       //parity frames of a group
+/*Coded frames go out under the appkey of the network with FEC_APPKEY_CODED
+flipped in its first byte, an appkey reserved for them: frames of every other
+layer carry the appkey itself, whatever follows src, and FEC_INPUT passes them*/
+#define  FEC_APPKEY_CODED       0x80
+#define  FEC_HEADER_SIZE        3       //group, index, k << 4 | m, after appkey, dst and src
+#define  FEC_DATA_MAX           ( VMX_MAX_BUFFER - FEC_HEADER_SIZE - 1 )   //payload of one frame
+#define  FEC_SHARD_SIZE         ( FEC_DATA_MAX + 1 )    //length byte and payload, what is coded
+
+/*Status codes*/
+#define  FEC_OK                 0
+#define  FEC_ERR_PARAM          1       //an argument is out of range
+#define  FEC_ERR_BUSY           2       //the radio is still sending, call again
+#define  FEC_PASS               3       //not a coded frame, for the layer above as it is
+#define  FEC_ERR_FRAME          4       //a coded frame with a bad header, or late
+#define  FEC_ERR_RADIO          5       //the driver did not take the frame, call again
+
+/*Statistics of either end*/
+typedef struct
+{
+    INT32U data;            //data frames sent or received
+    INT32U parity;          //parity frames sent or received
+    INT32U groups;          //groups sent or started
+    INT32U recovered;       //data frames rebuilt from parity
+    INT32U unrecovered;     //data frames missing from a group left behind
+    INT32U late;            //frames of a group left behind
+    INT32U cycles;          //Si4463_CYCLES( ) spent coding
+}FEC_STATS;
+
+/*Sending end for one destination. Set up with FEC_TX_INIT*/
+typedef struct
+{
+    SI446X_DEV *radio;
+    INT8U  header[4 + FEC_HEADER_SIZE];     //appkey, dst, src, group, index, k m
+    INT8U  channel;
+    INT8U  condition;           //START_TX condition
+    INT8U  k, m;                //of every group, m 0 sends uncoded frames
+    INT8U  count;               //data frames of the group so far
+    INT8U  size;                //longest shard of the group, bytes of its parity frames
+    INT8U  parity_sent;         //parity frames of the full group sent so far
+    INT8U  parity[FEC_M_MAX][FEC_SHARD_SIZE];
+    FEC_STATS stats;
+}FEC_TX;
+
+/*Receiving end for one source. Set up with FEC_RX_INIT*/
+typedef struct
+{
+    INT8U  appkey[2];           //of the coded frames, FEC_APPKEY_CODED flipped
+    BOOLEAN active;             //a group is being collected
+    INT8U  src, group;
+    INT8U  k;                   //data frames of the group, as its parity frames say
+    INT8U  size;                //bytes of its parity frames
+    INT16U have;                //bit i: shard i received or rebuilt, parity j at FEC_K_MAX + j
+    INT16U delivered;           //bit i: data shard i handed to FEC_RECV
+    INT8U  shard[FEC_K_MAX + FEC_M_MAX][FEC_SHARD_SIZE];
+    FEC_STATS stats;
+}FEC_RX;
+
+/*Set up the sending end on radio, NULL for the one on SPI0, groups of k data
+frames and m parity frames*/
+INT8U FEC_TX_INIT( FEC_TX *fec, SI446X_DEV *radio, const INT8U *appkey, INT8U dst, INT8U src,
+                   INT8U channel, INT8U condition, INT8U k, INT8U m );
+
+/*Send a payload of FEC_DATA_MAX bytes at most, and the parity once the group is full*/
+INT8U FEC_SEND( FEC_TX *fec, const INT8U *data, INT8U length );
+
+/*End the group now, its parity covers the data frames sent so far; FEC_OK once all is sent*/
+INT8U FEC_FLUSH( FEC_TX *fec );
+
+/*Set up the receiving end, appkey of the network as given to FEC_TX_INIT*/
+void FEC_RX_INIT( FEC_RX *fec, const INT8U *appkey );
+
+/*Take a received frame, FEC_PASS if it is not coded*/
+INT8U FEC_INPUT( FEC_RX *fec, const INT8U *frame, INT8U length );
+
+/*Next payload received or rebuilt, returns its length, 0 if there is none*/
+INT8U FEC_RECV( FEC_RX *fec, INT8U *buffer );
+
+/*Add data shard index of a group to its m parity shards, size bytes of each*/
+void FEC_ENCODE( INT8U index, const INT8U *shard, INT8U size, INT8U m,
+                 INT8U parity[][FEC_SHARD_SIZE] );
+
+/*Rebuild the missing data shards of a group from its parity, returns how many*/
+INT8U FEC_DECODE( INT8U shard[][FEC_SHARD_SIZE], INT16U *have, INT8U k, INT8U m, INT8U size );
+
+/*Read the statistics of either end*/
+const FEC_STATS *FEC_TX_STATS_GET( FEC_TX *fec );
+const FEC_STATS *FEC_RX_STATS_GET( FEC_RX *fec );
+
+#endif //_RADIO_FEC_H_
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
@@ -0,0 +1,275 @@
+/*
+================================================================================
+Function : Coding time and goodput of the frame erasure code, on the host simulation
+================================================================================
+*/
+
+/*
+    gcc -std=c99 -O2 -DSI446X_SIM -I. -o radio_fec_bench \
+        radio_fec_bench.c radio_fec.c si446x_sim.c si446x.c
+    ./radio_fec_bench
+
+First FEC_DECODE is checked on every pattern of up to m lost shards of an
+8 + 2 and an 8 + 4 group, and the time FEC_ENCODE and FEC_DECODE take is
+measured on the host, in ns per payload byte. The simulation does not count
+it, Si4463_CYCLES( ) only advance with the radio.
+
+Then radio 0 sends FEC_BENCH_FRAMES full payloads to radio 1 over a link
+losing FEC_BENCH_LOSSES % of the frames, plain and coded. Goodput is payload
+bytes delivered per second of simulated time, the last payload handed over
+ending it. The exit code is 1 if a rebuilt shard is wrong, a payload arrives
+corrupted or twice, or a group that lost no more than m frames is not given
+back whole.
+*/
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "radio_fec.h"
+
+#define FEC_BENCH_FRAMES    96
+#define FEC_BENCH_CHANNEL   5
+#define FEC_BENCH_RSSI      0x80        //-66 dBm
+#define FEC_BENCH_TIMING    2000        //groups coded for the time
+#define FEC_BENCH_LIMIT_US  60000000ULL
+
+static const INT8U FEC_BENCH_LOSSES[] = { 0, 5, 10, 20, 30 };
+static const INT8U FEC_BENCH_M[] = { 0, 2, 4 };
+static const INT8U appkey[2] = { 0xA5, 0x5A };
+
+static int failures;
+
+/*Payload n, its number first*/
+static void FEC_BENCH_FILL( INT8U *data, INT16U n )
+{
+    INT8U b;
+
+    data[0] = ( INT8U )n;
+    for( b = 1; b < FEC_DATA_MAX; b ++ )    { data[b] = ( INT8U )( n * 31 + b * 7 ); }
+}
+
+/*Bits set*/
+static INT8U FEC_BENCH_COUNT( INT16U bits )
+{
+    INT8U n = 0;
+
+    for( ; bits; bits &= bits - 1 ) { n ++; }
+    return n;
+}
+
+/*Shards kept when the shards of lost are missing, lost bit k + j for parity j*/
+static INT16U FEC_BENCH_HAVE( INT16U lost, INT8U k, INT8U m )
+{
+    INT16U have = 0;
+    INT8U i;
+
+    for( i = 0; i < k + m; i ++ )
+    {
+        if( !( lost & 1 << i ) )    { have |= 1 << ( i < k ? i : FEC_K_MAX + i - k ); }
+    }
+    return have;
+}
+
+/*A group of k data shards and its m parity shards*/
+static void FEC_BENCH_GROUP( INT8U shard[][FEC_SHARD_SIZE], INT8U data[][FEC_SHARD_SIZE],
+                             INT8U k, INT8U m )
+{
+    INT8U i;
+
+    memset( shard[FEC_K_MAX], 0, FEC_M_MAX * FEC_SHARD_SIZE );
+    for( i = 0; i < k; i ++ )
+    {
+        FEC_ENCODE( i, data[i], FEC_SHARD_SIZE, m, &shard[FEC_K_MAX] );
+        memcpy( shard[i], data[i], FEC_SHARD_SIZE );
+    }
+}
+
+/*Every pattern of up to m lost shards of a k + m group, and the time*/
+static void FEC_BENCH_CODE( INT8U k, INT8U m )
+{
+    static INT8U data[FEC_K_MAX][FEC_SHARD_SIZE];
+    static INT8U shard[FEC_K_MAX + FEC_M_MAX][FEC_SHARD_SIZE];
+    INT16U lost, have;
+    INT32U patterns = 0, g;
+    clock_t start;
+    double encode, decode = 0;
+    INT8U i, j;
+
+    srand( k * 16 + m );
+    for( i = 0; i < k; i ++ )
+    {
+        data[i][0] = FEC_DATA_MAX;
+        for( j = 1; j < FEC_SHARD_SIZE; j ++ )  { data[i][j] = ( INT8U )rand( ); }
+    }
+
+    for( lost = 0; lost < 1 << ( k + m ); lost ++ )
+    {
+        if( FEC_BENCH_COUNT( lost ) > m )   { continue; }
+        FEC_BENCH_GROUP( shard, data, k, m );
+        have = FEC_BENCH_HAVE( lost, k, m );
+        for( i = 0; i < FEC_K_MAX + FEC_M_MAX; i ++ )
+        {
+            if( !( have & 1 << i ) )    { memset( shard[i], 0xEE, FEC_SHARD_SIZE ); }
+        }
+        FEC_DECODE( shard, &have, k, m, FEC_SHARD_SIZE );
+        for( i = 0; i < k; i ++ )
+        {
+            if( !( have & 1 << i ) || memcmp( shard[i], data[i], FEC_SHARD_SIZE ) != 0 )
+            {
+                printf( "FAIL: %u + %u, lost %03X, shard %u\n", k, m, lost, i );
+                failures ++;
+                break;
+            }
+        }
+        patterns ++;
+    }
+
+    start = clock( );
+    for( g = 0; g < FEC_BENCH_TIMING; g ++ )    { FEC_BENCH_GROUP( shard, data, k, m ); }
+    encode = ( double )( clock( ) - start ) / CLOCKS_PER_SEC;
+    for( g = 0; g < FEC_BENCH_TIMING; g ++ )
+    {
+        // The first m data shards lost, the most work
+        FEC_BENCH_GROUP( shard, data, k, m );
+        have = FEC_BENCH_HAVE( ( 1 << m ) - 1, k, m );
+        start = clock( );
+        FEC_DECODE( shard, &have, k, m, FEC_SHARD_SIZE );
+        decode += ( double )( clock( ) - start ) / CLOCKS_PER_SEC;
+    }
+    printf( "%5u + %u %9u %13.2f %13.2f\n", k, m, patterns,
+            encode * 1e9 / FEC_BENCH_TIMING / ( k * FEC_DATA_MAX ),
+            decode * 1e9 / FEC_BENCH_TIMING / ( k * FEC_DATA_MAX ) );
+}
+
+/*Check a payload handed over, once*/
+static void FEC_BENCH_TAKE( const INT8U *data, INT8U length, INT8U *got, INT16U *delivered )
+{
+    INT8U expect[FEC_DATA_MAX];
+
+    FEC_BENCH_FILL( expect, data[0] );
+    if( length != FEC_DATA_MAX || data[0] >= FEC_BENCH_FRAMES || got[data[0]] ||
+        memcmp( data, expect, FEC_DATA_MAX ) != 0 )
+    {
+        printf( "FAIL: payload %u corrupted or twice\n", data[0] );
+        failures ++;
+        return;
+    }
+    got[data[0]] = 1;
+    ( *delivered ) ++;
+}
+
+/*FEC_BENCH_FRAMES payloads from radio 0 to radio 1, m 0 for plain frames*/
+static void FEC_BENCH_LINK( INT8U loss, INT8U m )
+{
+    static SI446X_DEV radio[2];
+    static FEC_TX tx;
+    static FEC_RX rx;
+    const SI446X_RX_SLOT *slot;
+    INT8U data[FEC_DATA_MAX], got[FEC_BENCH_FRAMES], arrived[FEC_BENCH_FRAMES / FEC_K_MAX];
+    INT8U i, length, status;
+    INT16U sent = 0, delivered = 0;
+    uint64_t start, last, done = 0;
+
+    SI446X_SIM_INIT( 2, 1 + loss );
+    SI446X_SIM_LINK( 0, 1, FEC_BENCH_RSSI, loss );
+    for( i = 0; i < 2; i ++ )   { SI446X_SIM_RADIO_UP( &radio[i], i ); }
+    SI446X_DEV_RX_ENGINE_START( &radio[1], FEC_BENCH_CHANNEL );
+    FEC_TX_INIT( &tx, &radio[0], appkey, 0x11, 0x10, FEC_BENCH_CHANNEL, 0, FEC_K_MAX, m );
+    FEC_RX_INIT( &rx, appkey );
+    memset( got, 0, sizeof( got ) );
+    memset( arrived, 0, sizeof( arrived ) );
+    SI446X_SIM_RUN( 1000 );
+    start = last = SI446X_SIM_NOW( );
+
+    // Send as fast as the radio goes, then listen for a while
+    while( done == 0 || SI446X_SIM_NOW( ) - done < 100000000ULL )
+    {
+        if( sent < FEC_BENCH_FRAMES )
+        {
+            FEC_BENCH_FILL( data, sent );
+            if( FEC_SEND( &tx, data, FEC_DATA_MAX ) == FEC_OK ) { sent ++; }
+        }
+        else if( done == 0 && FEC_FLUSH( &tx ) == FEC_OK )  { done = SI446X_SIM_NOW( ); }
+        if( SI446X_SIM_NOW( ) - start > FEC_BENCH_LIMIT_US * 1000 ) { break; }
+
+        while( ( slot = SI446X_DEV_RX_PEEK( &radio[1] ) ) != NULL )
+        {
+            status = FEC_INPUT( &rx, slot->data, slot->length );
+            if( status == FEC_OK && slot->data[4] < sizeof( arrived ) )
+            {
+                arrived[slot->data[4]] ++;
+            }
+            else if( status == FEC_PASS )
+            {
+                FEC_BENCH_TAKE( slot->data + 4, slot->length - 4, got, &delivered );
+                last = SI446X_SIM_NOW( );
+            }
+            SI446X_DEV_RX_RELEASE( &radio[1] );
+            while( ( length = FEC_RECV( &rx, data ) ) != 0 )
+            {
+                FEC_BENCH_TAKE( data, length, got, &delivered );
+                last = SI446X_SIM_NOW( );
+            }
+        }
+        SI446X_SIM_RUN( 500 );
+    }
+
+    // A group of which k frames came in is whole
+    for( i = 0; m != 0 && i < sizeof( arrived ); i ++ )
+    {
+        if( arrived[i] >= FEC_K_MAX && memchr( got + i * FEC_K_MAX, 0, FEC_K_MAX ) != NULL )
+        {
+            printf( "FAIL: %u %% loss, %u + %u, group %u not rebuilt from %u frames\n",
+                    loss, FEC_K_MAX, m, i, arrived[i] );
+            failures ++;
+        }
+    }
+    SI446X_SIM_SELECT( 0 );
+    printf( "%6u %5u + %u %7u %6u/%-3u %10u %9.0f\n", loss, FEC_K_MAX, m,
+            SI446X_SIM_STATS_GET( )->frames_sent, delivered, FEC_BENCH_FRAMES, rx.stats.recovered,
+            delivered * FEC_DATA_MAX * 1e9 / ( last - start ) );
+}
+
+/*Frames of other layers pass, whatever byte follows src*/
+static void FEC_BENCH_PASS( void )
+{
+    static FEC_RX rx;
+    INT8U frame[12] = { 0xA5, 0x5A, 0x11, 0x10, 0xFC, 0x00, 0x00, 0x81, 0x04 };
+    INT16U b;
+
+    FEC_RX_INIT( &rx, appkey );
+    for( b = 0; b < 256; b ++ )
+    {
+        frame[4] = ( INT8U )b;
+        if( FEC_INPUT( &rx, frame, sizeof( frame ) ) != FEC_PASS )
+        {
+            printf( "FAIL: a plain frame with %02X after src taken for a coded one\n", b );
+            failures ++;
+        }
+    }
+}
+
+int main( void )
+{
+    INT8U l, m;
+
+    FEC_BENCH_PASS( );
+
+    printf( "%9s %9s %13s %13s\n", "code", "patterns", "encode ns/B", "decode ns/B" );
+    FEC_BENCH_CODE( FEC_K_MAX, 2 );
+    FEC_BENCH_CODE( FEC_K_MAX, FEC_M_MAX );
+
+    printf( "\n%6s %9s %7s %10s %10s %9s\n", "loss %", "code", "frames", "delivered",
+            "recovered", "bytes/s" );
+    for( l = 0; l < sizeof( FEC_BENCH_LOSSES ); l ++ )
+    {
+        for( m = 0; m < sizeof( FEC_BENCH_M ); m ++ )   { FEC_BENCH_LINK( FEC_BENCH_LOSSES[l], FEC_BENCH_M[m] ); }
+    }
+    return failures ? 1 : 0;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
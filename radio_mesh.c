@@ -0,0 +1,584 @@
+/*
+================================================================================
+Function : Multi-hop relay toward gateways over the SI446x driver
+================================================================================
+*/
+
+/*
+Frames are normal SI446x frames, appkey, dst and src first, where dst and src
+are the two ends of one hop, followed by
+
+    type    MESH_TYPE_DATA, MESH_TYPE_BEACON or MESH_TYPE_ACK
+    origin  node the frame started from
+    final   gateway a data frame is for
+    seq     sequence number of the origin
+    hops    hops the frame has made
+    data    MESH_DATA_MAX bytes at most, data frames only
+
+A gateway broadcasts a beacon every MESH_BEACON_US; every node relays the
+first copy of each with hops counted up. A node takes the neighbour it heard
+a beacon from as next hop when it is closer to the gateway than the current
+one, or as close and heard louder; neighbours heard below MESH_RSSI_MIN_DBM
+are not used, as their frames would mostly be lost.
+
+Data frames go from hop to hop toward the gateway. The driver's auto-ACK of
+the next hop answers each one from its nIRQ handler; a frame without an ACK
+is sent again, MESH_RETRIES times at most. The driver's duplicate
+suppression tells data frames apart by origin and seq, so copies which come
+again, over the same hop or another one, are dropped before they are read
+out of the radio. Relayed frames wait a random time up to MESH_JITTER_US
+first, so neighbours relaying the same beacon do not all start at once, and
+every frame waits for a clear channel, MESH_CCA_US of listening, as a node
+hears its neighbours relay. The ACK of a neighbour's next hop may be out of
+reach of both, so a node which overhears a data frame for another node also
+keeps quiet for MESH_HOLD_US after it, the air time of that ACK.
+
+A node whose queue or inbox has less than MESH_HEADROOM free slots turns the
+auto-ACK off, so the frames of its neighbours wait on their side and come
+again, instead of being acked and then dropped here.
+
+A node owns the RX engine, the auto-ACK, the duplicate suppression and the
+PACKET_SENT report of its radio.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef SI446X_SIM
+#include "../global.h"
+#endif
+#include "radio_mesh.h"
+
+#define MESH_MASK           ( MESH_QUEUE_SIZE - 1 )
+#define MESH_DUE( now, at ) ( ( INT32S )( ( now ) - ( at ) ) >= 0 )
+
+/*
+=================================================================================
+------------------------------------Internal-------------------------------------
+=================================================================================
+*/
+
+/*!
+ * Random delay for a relayed or repeated frame, xorshift
+ *
+ * @param node      the node
+ * @param tries     sends of the frame so far; the range doubles with each,
+ *                  up to MESH_BACKOFF_MAX times
+ * @return CPU cycles, below MESH_JITTER_US << tries
+ */
+static INT32U MESH_JITTER( MESH_NODE *node, INT8U tries )
+{
+    node->random ^= node->random << 13;
+    node->random ^= node->random >> 17;
+    node->random ^= node->random << 5;
+    return node->random % ( SI446X_US_CYCLES( MESH_JITTER_US ) << GetMin( tries, MESH_BACKOFF_MAX ) );
+}
+/*!
+ * Route entry of a gateway
+ *
+ * @param node      the node
+ * @param final     the gateway
+ * @param create    take a free entry if there is none
+ * @return the entry, NULL if there is none
+ */
+static MESH_ROUTE *MESH_ROUTE_FIND( MESH_NODE *node, INT8U final, BOOLEAN create )
+{
+    MESH_ROUTE *free = NULL;
+    INT8U i;
+
+    for( i = 0; i < MESH_ROUTES; i ++ )
+    {
+        if( node->route[i].valid && node->route[i].final == final ) { return &node->route[i]; }
+        if( !node->route[i].valid && free == NULL )                 { free = &node->route[i]; }
+    }
+    if( !create || free == NULL )   { return NULL; }
+    free->final = final;
+    return free;
+}
+/*!
+ * Take what a beacon says about the way to its gateway
+ *
+ * @param node      the node
+ * @param final     the gateway
+ * @param next      neighbour the beacon came from
+ * @param hops      hops to the gateway through it
+ * @param rssi      the beacon's RSSI, dBm, MESH_RSSI_MIN_DBM at least
+ */
+static void MESH_LEARN( MESH_NODE *node, INT8U final, INT8U next, INT8U hops, INT8S rssi )
+{
+    MESH_ROUTE *route;
+
+    if( final == node->address )    { return; }
+    route = MESH_ROUTE_FIND( node, final, BOOL_TRUE );
+    if( route == NULL ) { return; }
+    if( !route->valid ) { route->relayed = BOOL_FALSE; }
+    if( route->valid && route->next != next &&
+        ( hops > route->hops || ( hops == route->hops && rssi <= route->rssi ) ) )
+    {
+        return;
+    }
+    route->valid = BOOL_TRUE;
+    route->next = next;
+    route->hops = hops;
+    route->rssi = rssi;
+    route->heard_at = Si4463_CYCLES( );
+}
+/*!
+ * Whether a beacon is the first copy of a newer one from its gateway; it is
+ * taken as relayed if so. Every copy is learned from, only this one is
+ * relayed, so the driver does not drop beacons. A seq far behind the newest
+ * one is taken as a restarted gateway.
+ *
+ * @param node      the node
+ * @param final     the gateway
+ * @param seq       the beacon's sequence number
+ */
+static BOOLEAN MESH_BEACON_NEW( MESH_NODE *node, INT8U final, INT8U seq )
+{
+    MESH_ROUTE *route = MESH_ROUTE_FIND( node, final, BOOL_FALSE );
+    INT8S ahead;
+
+    if( route == NULL ) { return BOOL_FALSE; }
+    ahead = ( INT8S )( seq - route->beacon_seq );
+    if( route->relayed && ahead <= 0 && -ahead < SI446X_DEDUP_WINDOW )  { return BOOL_FALSE; }
+    route->relayed = BOOL_TRUE;
+    route->beacon_seq = seq;
+    return BOOL_TRUE;
+}
+/*!
+ * Queue a frame
+ *
+ * @param node      the node
+ * @param frame     appkey, dst, src, mesh header and data; dst and src are
+ *                  filled in when it is sent
+ * @param length    its length
+ * @param delay     CPU cycles it waits for
+ * @return MESH_OK, MESH_ERR_FULL
+ */
+static INT8U MESH_QUEUE( MESH_NODE *node, const INT8U *frame, INT8U length, INT32U delay )
+{
+    INT8U index;
+
+    if( node->tx.count == MESH_QUEUE_SIZE ) { return MESH_ERR_FULL; }
+    index = ( node->tx.head + node->tx.count ) & MESH_MASK;
+    memcpy( node->tx.slot[index].frame, frame, length );
+    node->tx.slot[index].length = length;
+    node->tx.slot[index].tries = 0;
+    node->tx.slot[index].due = Si4463_CYCLES( ) + delay;
+    node->tx.count ++;
+    return MESH_OK;
+}
+/*!
+ * The frame at the head of the queue is done with, sent or given up
+ *
+ * @param node      the node
+ */
+static void MESH_DEQUEUE( MESH_NODE *node )
+{
+    node->tx.head = ( node->tx.head + 1 ) & MESH_MASK;
+    node->tx.count --;
+    node->tx.waiting = BOOL_FALSE;
+}
+/*!
+ * Broadcast a beacon of this gateway
+ *
+ * @param node      the node
+ */
+static void MESH_BEACON( MESH_NODE *node )
+{
+    INT8U frame[4 + MESH_HEADER_SIZE];
+
+    frame[0] = node->appkey[0];
+    frame[1] = node->appkey[1];
+    frame[4] = MESH_TYPE_BEACON;
+    frame[5] = node->address;
+    frame[6] = node->address;
+    frame[7] = node->seq ++;
+    frame[8] = 0;
+    if( MESH_QUEUE( node, frame, sizeof( frame ), 0 ) == MESH_OK )  { node->stats.beacons ++; }
+}
+/*!
+ * Turn the auto-ACK of the radio on while there is room for the frames it
+ * answers, off otherwise
+ *
+ * @param node      the node
+ */
+static void MESH_FLOW( MESH_NODE *node )
+{
+    SI446X_ACK_TEMPLATE ack;
+    BOOLEAN room = node->tx.count <= MESH_QUEUE_SIZE - MESH_HEADROOM &&
+                   node->inbox.count <= MESH_INBOX_SIZE - MESH_HEADROOM;
+
+    if( room == node->acking )  { return; }
+    node->acking = room;
+    if( !room )
+    {
+        SI446X_DEV_AUTO_ACK_OFF( node->radio );
+        return;
+    }
+    memset( &ack, 0, sizeof( ack ) );
+    ack.frame[0] = node->appkey[0];
+    ack.frame[1] = node->appkey[1];
+    ack.frame[3] = node->address;
+    ack.frame[4] = MESH_TYPE_ACK;
+    ack.length = 4 + MESH_HEADER_SIZE;
+    ack.seq_from = 7;
+    ack.seq_to = 7;
+    ack.match_offset = 4;
+    ack.match_mask = 0xFF;
+    ack.match_value = MESH_TYPE_DATA;
+    SI446X_DEV_AUTO_ACK_ON( node->radio, &ack );
+}
+/*!
+ * Send the frame at the head of the queue when it is due: data to the next
+ * hop of its gateway, beacons to everybody
+ *
+ * @param node      the node
+ * @param now       Si4463_CYCLES( )
+ */
+static void MESH_TX( MESH_NODE *node, INT32U now )
+{
+    INT8U *frame = node->tx.slot[node->tx.head].frame;
+    const MESH_ROUTE *route;
+    SI446X_SEG seg;
+
+    if( !MESH_DUE( now, node->tx.slot[node->tx.head].due ) )    { return; }
+    if( !MESH_DUE( now, node->quiet_until ) )
+    {
+        node->tx.slot[node->tx.head].due = node->quiet_until + MESH_JITTER( node, 0 );
+        node->stats.busy ++;
+        return;
+    }
+    if( SI446X_DEV_TX_BUSY( node->radio ) )  { return; }    //an ACK is on air
+    if( !SI446X_DEV_CCA( node->radio, node->channel, SI446X_CCA_THRESHOLD_DBM, MESH_CCA_US ) )
+    {
+        node->tx.slot[node->tx.head].due = now + MESH_JITTER( node, 0 );
+        node->stats.busy ++;
+        return;
+    }
+
+    if( frame[4] == MESH_TYPE_DATA )
+    {
+        // Without a route the frame waits for the next beacon, the queue fills meanwhile
+        route = MESH_ROUTE_GET( node, frame[6] );
+        if( route == NULL )
+        {
+            node->tx.slot[node->tx.head].due = now + SI446X_US_CYCLES( MESH_JITTER_US );
+            return;
+        }
+        frame[2] = route->next;
+    }
+    else
+    {
+        frame[2] = MESH_BROADCAST;
+    }
+    frame[3] = node->address;
+    seg.data = frame;
+    seg.length = node->tx.slot[node->tx.head].length;
+    SI446X_DEV_SEND_SEG( node->radio, &seg, 1, node->channel, STATE_RX << 4 );
+    node->tx.slot[node->tx.head].tries ++;
+    node->tx.busy = BOOL_TRUE;
+    node->tx.at = now;
+}
+
+/*
+=================================================================================
+-------------------------------------Exports-------------------------------------
+=================================================================================
+*/
+
+/*!
+ * Set up a node. The RX engine of the radio must run on channel, without an
+ * address filter or with one passing MESH_BROADCAST; the node turns on the
+ * radio's auto-ACK for the data frames sent to it.
+ *
+ * @param node      the node
+ * @param radio     its radio, NULL for the one on SPI0
+ * @param appkey    2 bytes
+ * @param address   address of the node, neither 0 nor MESH_BROADCAST
+ * @param channel   channel of every node
+ * @param gateway   BOOL_TRUE for a gateway, which beacons
+ */
+void MESH_INIT( MESH_NODE *node, SI446X_DEV *radio, const INT8U *appkey, INT8U address,
+                INT8U channel, BOOLEAN gateway )
+{
+    SI446X_DEDUP_RULE dedup;
+
+    memset( node, 0, sizeof( *node ) );
+    node->radio = radio ? radio : &g_sSi446xDev0;
+    node->appkey[0] = appkey[0];
+    node->appkey[1] = appkey[1];
+    node->address = address;
+    node->channel = channel;
+    node->gateway = gateway;
+    node->random = 0x9E3779B9UL ^ address;
+    node->beacon_at = Si4463_CYCLES( ) - SI446X_US_CYCLES( MESH_BEACON_US );
+    node->quiet_until = Si4463_CYCLES( );
+
+    // Data frames to this node by origin and seq; overheard ones would hide the copy for it
+    dedup.seq_offset = 7;
+    dedup.match_offset = 4;
+    dedup.match_mask = 0xFF;
+    dedup.match_value = MESH_TYPE_DATA;
+    dedup.key_offset = 5;
+    dedup.address = address;
+    SI446X_DEV_DEDUP_ON( node->radio, &dedup );
+    MESH_FLOW( node );
+}
+/*!
+ * Queue a payload for a gateway. It goes out when MESH_POLL finds the radio
+ * free, to the next hop known then.
+ *
+ * @param node      the node
+ * @param final     the gateway
+ * @param data      the payload
+ * @param length    1..MESH_DATA_MAX bytes
+ * @return MESH_OK, MESH_ERR_FULL, MESH_ERR_PARAM, MESH_ERR_ROUTE
+ */
+INT8U MESH_SEND( MESH_NODE *node, INT8U final, const INT8U *data, INT8U length )
+{
+    INT8U frame[4 + MESH_HEADER_SIZE + MESH_DATA_MAX];
+    INT8U status;
+
+    if( length == 0 || length > MESH_DATA_MAX )     { return MESH_ERR_PARAM; }
+    if( MESH_ROUTE_GET( node, final ) == NULL )     { return MESH_ERR_ROUTE; }
+    if( node->tx.count == MESH_QUEUE_SIZE )         { return MESH_ERR_FULL; }
+
+    frame[0] = node->appkey[0];
+    frame[1] = node->appkey[1];
+    frame[4] = MESH_TYPE_DATA;
+    frame[5] = node->address;
+    frame[6] = final;
+    frame[7] = node->seq ++;
+    frame[8] = 0;
+    memcpy( frame + 4 + MESH_HEADER_SIZE, data, length );
+    status = MESH_QUEUE( node, frame, 4 + MESH_HEADER_SIZE + length, 0 );
+    if( status == MESH_OK ) { node->stats.originated ++; }
+    return status;
+}
+/*!
+ * Take a frame received by the RX engine. The radio of the node must be in
+ * use, as in MESH_POLL.
+ *
+ * @param node      the node
+ * @param slot      the frame, as returned by SI446X_RX_PEEK
+ * @return BOOL_FALSE if it is not a mesh frame for this node
+ */
+BOOLEAN MESH_INPUT( MESH_NODE *node, const SI446X_RX_SLOT *slot )
+{
+    const INT8U *frame = slot->data;
+    MESH_ROUTE *route;
+    INT8U index, hops, length;
+    INT8U copy[4 + MESH_HEADER_SIZE + MESH_DATA_MAX];
+
+    if( slot->length < 4 + MESH_HEADER_SIZE || frame[0] != node->appkey[0] ||
+        frame[1] != node->appkey[1] )
+    {
+        return BOOL_FALSE;
+    }
+    if( frame[2] != node->address && frame[2] != MESH_BROADCAST )
+    {
+        // Its ACK comes from a node this one may not hear
+        if( frame[4] == MESH_TYPE_DATA )    { node->quiet_until = slot->timestamp + SI446X_US_CYCLES( MESH_HOLD_US ); }
+        return BOOL_FALSE;
+    }
+    length = GetMin( slot->length, sizeof( copy ) );
+    hops = frame[8] + 1;
+
+    switch( frame[4] )
+    {
+    case MESH_TYPE_ACK:
+        // With the main loop slow, the ACK may come before PACKET_SENT is seen
+        index = node->tx.head;
+        if( ( node->tx.busy || node->tx.waiting ) && frame[3] == node->tx.slot[index].frame[2] &&
+            frame[7] == node->tx.slot[index].frame[7] && node->tx.slot[index].frame[4] == MESH_TYPE_DATA )
+        {
+            if( node->tx.busy ) { SI446X_DEV_RX_ENGINE_TX_DONE( node->radio ); }
+            node->tx.busy = BOOL_FALSE;
+            // The next hop is still there, beacons lost under load do not take the route away
+            route = MESH_ROUTE_FIND( node, node->tx.slot[index].frame[6], BOOL_FALSE );
+            if( route != NULL && route->next == frame[3] )  { route->heard_at = Si4463_CYCLES( ); }
+            MESH_DEQUEUE( node );
+        }
+        return BOOL_TRUE;
+
+    case MESH_TYPE_BEACON:
+        // A copy over a link too weak to use would advertise a hop count no route has
+        if( slot->rssi < MESH_RSSI_MIN_DBM )    { return BOOL_TRUE; }
+        MESH_LEARN( node, frame[6], frame[3], hops, slot->rssi );
+        if( node->gateway || hops >= MESH_HOPS_MAX || !MESH_BEACON_NEW( node, frame[6], frame[7] ) )
+        {
+            return BOOL_TRUE;
+        }
+        memcpy( copy, frame, length );
+        copy[8] = hops;
+        if( MESH_QUEUE( node, copy, length, MESH_JITTER( node, 0 ) ) == MESH_OK )
+        {
+            node->stats.beacons ++;
+        }
+        return BOOL_TRUE;
+
+    case MESH_TYPE_DATA:
+        // Broadcast, or one of this node's frames come back around a loop
+        if( frame[2] != node->address || frame[5] == node->address )    { return BOOL_TRUE; }
+        // The auto-ACK is off by now and the frame comes again, let the driver take it then
+        if( frame[6] == node->address ? node->inbox.count == MESH_INBOX_SIZE :
+                                        node->tx.count == MESH_QUEUE_SIZE )
+        {
+            SI446X_DEV_DEDUP_UNMARK( node->radio, frame );
+            node->stats.dropped ++;
+            return BOOL_TRUE;
+        }
+        if( frame[6] == node->address )
+        {
+            index = ( node->inbox.head + node->inbox.count ) & ( MESH_INBOX_SIZE - 1 );
+            node->inbox.slot[index].origin = frame[5];
+            node->inbox.slot[index].hops = hops;
+            node->inbox.slot[index].length = length - 4 - MESH_HEADER_SIZE;
+            memcpy( node->inbox.slot[index].data, frame + 4 + MESH_HEADER_SIZE,
+                    length - 4 - MESH_HEADER_SIZE );
+            node->inbox.count ++;
+            node->stats.delivered ++;
+            return BOOL_TRUE;
+        }
+        memcpy( copy, frame, length );
+        copy[8] = hops;
+        if( node->gateway || hops >= MESH_HOPS_MAX ||
+            MESH_QUEUE( node, copy, length, MESH_JITTER( node, 0 ) ) != MESH_OK )
+        {
+            node->stats.dropped ++;
+            return BOOL_TRUE;
+        }
+        node->stats.forwarded ++;
+        return BOOL_TRUE;
+
+    default:
+        return BOOL_FALSE;
+    }
+}
+/*!
+ * Run the node: take the frames the RX engine holds, ack only while there is
+ * room for more, age the routes, beacon if it is a gateway, then move the
+ * frame at the head of the queue along: sent, acked or timed out, and sent
+ * again.
+ *
+ * @param node      the node
+ */
+void MESH_POLL( MESH_NODE *node )
+{
+    const SI446X_RX_SLOT *slot;
+    INT32U now;
+    INT8U i;
+
+    while( ( slot = SI446X_DEV_RX_PEEK( node->radio ) ) != NULL )
+    {
+        MESH_INPUT( node, slot );
+        SI446X_DEV_RX_RELEASE( node->radio );
+    }
+    MESH_FLOW( node );
+    now = Si4463_CYCLES( );
+    for( i = 0; i < MESH_ROUTES; i ++ )
+    {
+        if( node->route[i].valid &&
+            now - node->route[i].heard_at >= SI446X_US_CYCLES( MESH_ROUTE_TIMEOUT_US ) )
+        {
+            node->route[i].valid = BOOL_FALSE;
+        }
+    }
+    if( node->gateway && now - node->beacon_at >= SI446X_US_CYCLES( MESH_BEACON_US ) )
+    {
+        node->beacon_at = now;
+        MESH_BEACON( node );
+    }
+
+    if( node->tx.busy )
+    {
+        if( !SI446X_DEV_RX_ENGINE_TX_DONE( node->radio ) &&
+            now - node->tx.at < SI446X_US_CYCLES( MESH_TX_TIMEOUT_US ) )
+        {
+            return;
+        }
+        node->tx.busy = BOOL_FALSE;
+        if( node->tx.slot[node->tx.head].frame[4] == MESH_TYPE_DATA )
+        {
+            node->tx.waiting = BOOL_TRUE;
+            node->tx.at = now;
+        }
+        else
+        {
+            MESH_DEQUEUE( node );
+        }
+    }
+    if( node->tx.waiting )
+    {
+        if( now - node->tx.at < SI446X_US_CYCLES( MESH_ACK_TIMEOUT_US ) )    { return; }
+        node->tx.waiting = BOOL_FALSE;
+        if( node->tx.slot[node->tx.head].tries > MESH_RETRIES )
+        {
+            // The next hop is gone, the next beacon finds another one
+            for( i = 0; i < MESH_ROUTES; i ++ )
+            {
+                if( node->route[i].next == node->tx.slot[node->tx.head].frame[2] )
+                {
+                    node->route[i].valid = BOOL_FALSE;
+                }
+            }
+            node->stats.dropped ++;
+            MESH_DEQUEUE( node );
+        }
+        else
+        {
+            node->stats.retries ++;
+            node->tx.slot[node->tx.head].due = now + MESH_JITTER( node, node->tx.slot[node->tx.head].tries );
+        }
+    }
+    if( node->tx.count )    { MESH_TX( node, now ); }
+}
+/*!
+ * Take the oldest payload for this node
+ *
+ * @param node      the node
+ * @param buffer    MESH_DATA_MAX bytes
+ * @param origin    set to the node it came from, may be NULL
+ * @param hops      set to the hops it made, may be NULL
+ * @return its length, 0 if there is none
+ */
+INT8U MESH_RECV( MESH_NODE *node, INT8U *buffer, INT8U *origin, INT8U *hops )
+{
+    INT8U index = node->inbox.head, length;
+
+    if( node->inbox.count == 0 )    { return 0; }
+    length = node->inbox.slot[index].length;
+    memcpy( buffer, node->inbox.slot[index].data, length );
+    if( origin )    { *origin = node->inbox.slot[index].origin; }
+    if( hops )      { *hops = node->inbox.slot[index].hops; }
+    node->inbox.head = ( index + 1 ) & ( MESH_INBOX_SIZE - 1 );
+    node->inbox.count --;
+    return length;
+}
+/*!
+ * Route to a gateway
+ *
+ * @param node      the node
+ * @param final     the gateway
+ * @return the route, NULL if none is known
+ */
+const MESH_ROUTE *MESH_ROUTE_GET( MESH_NODE *node, INT8U final )
+{
+    return MESH_ROUTE_FIND( node, final, BOOL_FALSE );
+}
+/*!
+ * Read the node statistics
+ *
+ * @param node      the node
+ */
+const MESH_STATS *MESH_STATS_GET( MESH_NODE *node )
+{
+    return &node->stats;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
@@ -0,0 +1,151 @@
+/*
+================================================================================
+Function : Multi-hop relay toward gateways over the SI446x driver
+================================================================================
+*/
+
+#ifndef _RADIO_MESH_H_
+#define _RADIO_MESH_H_
+
+#include "si446x.h"
+
+/*
+=================================================================================
+------------------------------INTERNAL EXPORT APIs-------------------------------
+=================================================================================
+*/
+
+#define  MESH_HEADER_SIZE       5       //type, origin, final, seq, hops, after appkey, dst and src
+#define  MESH_DATA_MAX          ( VMX_MAX_BUFFER - MESH_HEADER_SIZE )  //payload of one frame
+
+#define  MESH_ROUTES            4       //gateways a node keeps a route to
+#define  MESH_QUEUE_SIZE        8       //frames waiting to be sent, power of 2
+#define  MESH_INBOX_SIZE        8       //payloads waiting for MESH_RECV, power of 2
+#define  MESH_HEADROOM          2       //free queue or inbox slots below which nothing is acked
+#define  MESH_HOPS_MAX          8       //frames which made this many hops are not relayed
+#define  MESH_BROADCAST         0xFF    //dst of beacons
+
+#define  MESH_BEACON_US         3000000     //beacon period of a gateway
+#define  MESH_ROUTE_TIMEOUT_US  10000000    //a route no beacon refreshed for this long is dropped
+#define  MESH_RSSI_MIN_DBM      -95         //weaker neighbours are not taken as next hop
+#define  MESH_JITTER_US         30000       //relayed frames wait a random time up to this
+#define  MESH_CCA_US            300         //listen time before every frame
+#define  MESH_HOLD_US           25000       //quiet after a data frame to another node, its ACK
+#define  MESH_ACK_TIMEOUT_US    60000       //from PACKET_SENT to the ACK of the next hop
+#define  MESH_RETRIES           6           //sends of a frame again for a missing ACK
+#define  MESH_BACKOFF_MAX       4           //doublings of the jitter before a retry
+#define  MESH_TX_TIMEOUT_US     200000      //longest wait for PACKET_SENT
+
+/*Frame types, the type byte*/
+#define  MESH_TYPE_DATA         0x01
+#define  MESH_TYPE_BEACON       0x02
+#define  MESH_TYPE_ACK          0x03    //sent by the driver's auto-ACK
+
+/*Status codes*/
+#define  MESH_OK                0
+#define  MESH_ERR_FULL          1       //the queue is full, poll and try again
+#define  MESH_ERR_PARAM         2       //an argument is out of range
+#define  MESH_ERR_ROUTE         3       //no route to the gateway yet
+
+/*Route to one gateway, learned from its beacons*/
+typedef struct
+{
+    BOOLEAN valid;
+    INT8U  final;           //the gateway
+    INT8U  next;            //neighbour the frames go to
+    INT8U  hops;            //from this node to the gateway
+    INT8S  rssi;            //of the last beacon from next, dBm
+    INT32U heard_at;        //Si4463_CYCLES( ) of that beacon
+    BOOLEAN relayed;        //a beacon of the gateway was relayed...
+    INT8U  beacon_seq;      //...the newest one, later copies are not
+}MESH_ROUTE;
+
+/*Node statistics*/
+typedef struct
+{
+    INT32U originated;      //payloads of this node queued
+    INT32U delivered;       //payloads for this node put in the inbox
+    INT32U forwarded;       //frames of other nodes queued for the next hop
+    INT32U beacons;         //beacons sent and relayed
+    INT32U retries;         //frames sent again for a missing ACK
+    INT32U busy;            //frames held back by a busy channel or an ACK due to a neighbour
+    INT32U dropped;         //frames given up: retries, hops, full queue or inbox
+}MESH_STATS;
+
+/*One node. Set up with MESH_INIT, then only touched by radio_mesh.c*/
+typedef struct
+{
+    SI446X_DEV *radio;              //radio of the node
+    INT8U  appkey[2];
+    INT8U  address;
+    INT8U  channel;
+    BOOLEAN gateway;                //sends beacons, relays nothing
+    INT8U  seq;                     //of the frames this node originates
+    INT32U random;                  //jitter generator
+    INT32U beacon_at;
+    INT32U quiet_until;             //Si4463_CYCLES( ) the ACK of an overheard frame is over
+    BOOLEAN acking;                 //the radio's auto-ACK is on
+
+    MESH_ROUTE route[MESH_ROUTES];
+
+    /*Frames to send, the oldest at head; it leaves the queue when acked*/
+    struct
+    {
+        INT8U  head, count;
+        BOOLEAN busy;               //PACKET_SENT not seen yet
+        BOOLEAN waiting;            //sent, the ACK of the next hop is due
+        INT32U at;                  //when busy or waiting started
+        struct
+        {
+            INT8U  frame[4 + MESH_HEADER_SIZE + MESH_DATA_MAX];
+            INT8U  length;
+            INT8U  tries;
+            INT32U due;             //Si4463_CYCLES( ) it may go at
+        }slot[MESH_QUEUE_SIZE];
+    }tx;
+
+    /*Payloads for this node*/
+    struct
+    {
+        INT8U head, count;
+        struct
+        {
+            INT8U origin;
+            INT8U hops;
+            INT8U length;
+            INT8U data[MESH_DATA_MAX];
+        }slot[MESH_INBOX_SIZE];
+    }inbox;
+
+    MESH_STATS stats;
+}MESH_NODE;
+
+/*Set up a node on radio, NULL for the one on SPI0; its RX engine must run*/
+void MESH_INIT( MESH_NODE *node, SI446X_DEV *radio, const INT8U *appkey, INT8U address,
+                INT8U channel, BOOLEAN gateway );
+
+/*Queue a payload of MESH_DATA_MAX bytes at most for a gateway*/
+INT8U MESH_SEND( MESH_NODE *node, INT8U final, const INT8U *data, INT8U length );
+
+/*Take a received frame, BOOL_FALSE if it is not a mesh frame for this node*/
+BOOLEAN MESH_INPUT( MESH_NODE *node, const SI446X_RX_SLOT *slot );
+
+/*Drain the RX ring into the node, then beacon and send what is due; call from the main loop*/
+void MESH_POLL( MESH_NODE *node );
+
+/*Next payload for this node, returns its length, 0 if there is none*/
+INT8U MESH_RECV( MESH_NODE *node, INT8U *buffer, INT8U *origin, INT8U *hops );
+
+/*Route to a gateway, NULL if there is none*/
+const MESH_ROUTE *MESH_ROUTE_GET( MESH_NODE *node, INT8U final );
+
+/*Read the node statistics*/
+const MESH_STATS *MESH_STATS_GET( MESH_NODE *node );
+
+#endif //_RADIO_MESH_H_
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
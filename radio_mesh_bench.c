@@ -0,0 +1,150 @@
+/*
+================================================================================
+Function : Throughput and latency of the mesh relay, on the host simulation
+================================================================================
+*/
+
+/*
+    gcc -std=c99 -O2 -DSI446X_SIM -I. -o radio_mesh_bench \
+        radio_mesh_bench.c radio_mesh.c si446x_sim.c si446x.c
+    ./radio_mesh_bench [hops]
+
+Radios 0..hops stand in a line, radio 0 is the gateway. Each one hears its
+neighbours well, with MESH_BENCH_LOSS % of the frames lost, and the radios
+two places away weakly, below MESH_RSSI_MIN_DBM and with most frames lost;
+nothing further. Once the far end has a route, it sends MESH_BENCH_FRAMES
+full payloads to the gateway as fast as its queue takes them. Throughput is
+payload bytes delivered per second of simulated time, latency is from
+MESH_SEND to MESH_RECV. Without arguments chains of 2 to 5 hops are run; the
+exit code is 1 if a payload was lost or the route is not the line.
+*/
+
+#include <stdlib.h>
+
+#include "radio_mesh.h"
+
+#define MESH_BENCH_FRAMES   40
+#define MESH_BENCH_CHANNEL  3
+#define MESH_BENCH_LOSS     5
+#define MESH_BENCH_NEAR     0x80        //-66 dBm
+#define MESH_BENCH_FAR      0x32        //-105 dBm
+#define MESH_BENCH_FAR_LOSS 70
+#define MESH_BENCH_STEP_US  200
+#define MESH_BENCH_LIMIT_US 120000000ULL    //simulated time a run may take
+
+static const INT8U appkey[2] = { 0xA5, 0x5A };
+
+static int failures;
+
+/*Address of radio i, the gateway first*/
+#define MESH_BENCH_ADDRESS( i )     ( ( i ) == 0 ? 0x01 : 0x10 + ( i ) )
+
+/*One chain*/
+static void MESH_BENCH_RUN( INT8U hops )
+{
+    static SI446X_DEV radio[SI446X_SIM_RADIOS];
+    static MESH_NODE node[SI446X_SIM_RADIOS];
+    INT8U data[MESH_DATA_MAX], origin, length, n = hops + 1;
+    const MESH_ROUTE *route;
+    INT32U sent_at, latency, max = 0, forwarded = 0, retries = 0, duplicates = 0, dropped = 0;
+    INT16U queued = 0, received = 0;
+    uint64_t start, sum = 0;
+    INT8U i, j;
+
+    SI446X_SIM_INIT( n, hops );
+    for( i = 0; i < n; i ++ )
+    {
+        for( j = 0; j < n; j ++ )
+        {
+            if( i == j + 1 || j == i + 1 )      { SI446X_SIM_LINK( i, j, MESH_BENCH_NEAR, MESH_BENCH_LOSS ); }
+            else if( i == j + 2 || j == i + 2 ) { SI446X_SIM_LINK( i, j, MESH_BENCH_FAR, MESH_BENCH_FAR_LOSS ); }
+            else if( i != j )                   { SI446X_SIM_LINK( i, j, 0, 0 ); }
+        }
+        SI446X_SIM_RADIO_UP( &radio[i], i );
+        SI446X_DEV_RX_ENGINE_START( &radio[i], MESH_BENCH_CHANNEL );
+        MESH_INIT( &node[i], &radio[i], appkey, MESH_BENCH_ADDRESS( i ), MESH_BENCH_CHANNEL, i == 0 );
+    }
+
+    // Beacons spread the routes
+    start = SI446X_SIM_NOW( );
+    while( MESH_ROUTE_GET( &node[hops], 0x01 ) == NULL &&
+           SI446X_SIM_NOW( ) - start < MESH_BENCH_LIMIT_US * 1000 )
+    {
+        for( i = 0; i < n; i ++ )   { MESH_POLL( &node[i] ); }
+        SI446X_SIM_RUN( MESH_BENCH_STEP_US );
+    }
+    route = MESH_ROUTE_GET( &node[hops], 0x01 );
+    if( route == NULL || route->hops != hops || route->next != MESH_BENCH_ADDRESS( hops - 1 ) )
+    {
+        printf( "FAIL: %u hops, route %s\n", hops, route ? "not along the line" : "not found" );
+        failures ++;
+        return;
+    }
+
+    start = SI446X_SIM_NOW( );
+    while( received < MESH_BENCH_FRAMES && SI446X_SIM_NOW( ) - start < MESH_BENCH_LIMIT_US * 1000 )
+    {
+        while( queued < MESH_BENCH_FRAMES )
+        {
+            memset( data, ( INT8U )queued, sizeof( data ) );
+            sent_at = Si4463_CYCLES( );
+            memcpy( data, &sent_at, 4 );
+            if( MESH_SEND( &node[hops], 0x01, data, sizeof( data ) ) != MESH_OK )   { break; }
+            queued ++;
+        }
+        for( i = 0; i < n; i ++ )   { MESH_POLL( &node[i] ); }
+        while( ( length = MESH_RECV( &node[0], data, &origin, NULL ) ) != 0 )
+        {
+            memcpy( &sent_at, data, 4 );
+            if( length != MESH_DATA_MAX || origin != MESH_BENCH_ADDRESS( hops ) || data[4] != ( INT8U )received )
+            {
+                printf( "FAIL: payload %u corrupted or out of order\n", received );
+                failures ++;
+            }
+            latency = ( Si4463_CYCLES( ) - sent_at ) / ( SI446X_SIM_SYSCLK_HZ / 1000000 );
+            sum += latency;
+            if( latency > max ) { max = latency; }
+            received ++;
+        }
+        SI446X_SIM_RUN( MESH_BENCH_STEP_US );
+    }
+    if( received < MESH_BENCH_FRAMES )
+    {
+        printf( "FAIL: %u hops, %u of %u payloads\n", hops, received, MESH_BENCH_FRAMES );
+        failures ++;
+    }
+    for( i = 0; i < n; i ++ )
+    {
+        forwarded += MESH_STATS_GET( &node[i] )->forwarded;
+        retries += MESH_STATS_GET( &node[i] )->retries;
+        duplicates += SI446X_DEV_RX_STATS_GET( &radio[i] )->duplicates;
+        dropped += MESH_STATS_GET( &node[i] )->dropped;
+    }
+    printf( "%4u %8u %9.0f %9.1f %9.1f %9u %7u %5u %7u\n", hops, received,
+            received * MESH_DATA_MAX * 1e9 / ( SI446X_SIM_NOW( ) - start ),
+            received ? sum / 1000.0 / received : 0.0, max / 1000.0,
+            forwarded, retries, duplicates, dropped );
+}
+
+int main( int argc, char **argv )
+{
+    INT8U hops;
+
+    printf( "%4s %8s %9s %9s %9s %9s %7s %5s %7s\n", "hops", "payloads", "bytes/s",
+            "mean ms", "max ms", "forwarded", "retries", "dups", "dropped" );
+    if( argc > 1 )
+    {
+        hops = ( INT8U )atoi( argv[1] );
+        if( hops < 1 || hops >= SI446X_SIM_RADIOS ) { return 1; }
+        MESH_BENCH_RUN( hops );
+        return failures ? 1 : 0;
+    }
+    for( hops = 2; hops <= 5; hops ++ ) { MESH_BENCH_RUN( hops ); }
+    return failures ? 1 : 0;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
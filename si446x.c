@@ -7,44 +7,325 @@ Function : Operation for SI446x
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
+#ifndef SI446X_SIM
 #include "../global.h"
+#endif
 #include "si446x.h"
 #include "radio_config.h"
 
-static INT8U config_table[] = RADIO_CONFIGURATION_DATA_ARRAY;
+/*
+The WDS commands of RADIO_CONFIGURATION_DATA_ARRAY, in the same order. The
+length byte in front of each command is taken from the RF_* macro itself, so
+it cannot disagree with the command, and every command is checked when this
+file compiles: it must fit the 16 byte command buffer, and a SET_PROPERTY
+must carry exactly the number of values its header announces.
+*/
+#define SI446X_CONFIG_COMMANDS( X )                     \
+    X( RF_POWER_UP )                                    \
+    X( RF_GPIO_PIN_CFG )                                \
+    X( RF_GLOBAL_XO_TUNE_2 )                            \
+    X( RF_GLOBAL_CONFIG_1 )                             \
+    X( RF_INT_CTL_ENABLE_2 )                            \
+    X( RF_FRR_CTL_A_MODE_4 )                            \
+    X( RF_PREAMBLE_TX_LENGTH_9 )                        \
+    X( RF_SYNC_CONFIG_5 )                               \
+    X( RF_PKT_CRC_CONFIG_7 )                            \
+    X( RF_PKT_LEN_12 )                                  \
+    X( RF_PKT_FIELD_2_CRC_CONFIG_12 )                   \
+    X( RF_PKT_FIELD_5_CRC_CONFIG_12 )                   \
+    X( RF_PKT_RX_FIELD_3_CRC_CONFIG_9 )                 \
+    X( RF_MODEM_MOD_TYPE_12 )                           \
+    X( RF_MODEM_FREQ_DEV_0_1 )                          \
+    X( RF_MODEM_TX_RAMP_DELAY_8 )                       \
+    X( RF_MODEM_BCR_OSR_1_9 )                           \
+    X( RF_MODEM_AFC_GEAR_7 )                            \
+    X( RF_MODEM_AGC_CONTROL_1 )                         \
+    X( RF_MODEM_AGC_WINDOW_SIZE_9 )                     \
+    X( RF_MODEM_OOK_CNT1_9 )                            \
+    X( RF_MODEM_RSSI_CONTROL_1 )                        \
+    X( RF_MODEM_RSSI_COMP_1 )                           \
+    X( RF_MODEM_CLKGEN_BAND_1 )                         \
+    X( RF_MODEM_CHFLT_RX1_CHFLT_COE13_7_0_12 )          \
+    X( RF_MODEM_CHFLT_RX1_CHFLT_COE1_7_0_12 )           \
+    X( RF_MODEM_CHFLT_RX2_CHFLT_COE7_7_0_12 )           \
+    X( RF_PA_MODE_4 )                                   \
+    X( RF_SYNTH_PFDCP_CPFF_7 )                          \
+    X( RF_MATCH_VALUE_1_12 )                            \
+    X( RF_FREQ_CONTROL_INTE_8 )
+
+#define SI446X_ARG0( a, ... )           ( a )
+#define SI446X_ARG2( a, b, c, ... )     ( c )
+#define SI446X_CFG_OP( ... )            SI446X_ARG0( __VA_ARGS__ )
+#define SI446X_CFG_NUM_PROPS( ... )     SI446X_ARG2( __VA_ARGS__ )
+
+/*A negative array size stops the build when a command is malformed*/
+#define SI446X_CFG_CHECK( cmd )                                             \
+    typedef char SI446X_CHECK_##cmd[ ( SI446X_CFG_LEN( cmd ) <= 16 &&       \
+        ( SI446X_CFG_OP( cmd ) != SET_PROPERTY ||                           \
+          SI446X_CFG_NUM_PROPS( cmd ) == SI446X_CFG_LEN( cmd ) - 4 ) ) ? 1 : -1 ];
+SI446X_CONFIG_COMMANDS( SI446X_CFG_CHECK )
+
+/*The command stream walked by SI446X_CONFIG_INIT, kept in flash*/
+static const INT8U config_table[] =
+{
+    SI446X_CONFIG_COMMANDS( SI446X_CFG_ENTRY )
+    0x00
+};
+
+/*A command added to or dropped from radio_config.h must be listed above*/
+typedef char SI446X_CHECK_CONFIG_SIZE[ sizeof( config_table ) ==
+    sizeof( ( const INT8U[] )RADIO_CONFIGURATION_DATA_ARRAY ) ? 1 : -1 ];
+
+/*
+The modem commands of SI446X_CONFIG_COMMANDS: what a profile for another data
+rate, generated by WDS with the same frequency and packet settings, changes.
+*/
+#define SI446X_MODEM_COMMANDS( X )                      \
+    X( RF_MODEM_MOD_TYPE_12 )                           \
+    X( RF_MODEM_FREQ_DEV_0_1 )                          \
+    X( RF_MODEM_TX_RAMP_DELAY_8 )                       \
+    X( RF_MODEM_BCR_OSR_1_9 )                           \
+    X( RF_MODEM_AFC_GEAR_7 )                            \
+    X( RF_MODEM_AGC_CONTROL_1 )                         \
+    X( RF_MODEM_AGC_WINDOW_SIZE_9 )                     \
+    X( RF_MODEM_OOK_CNT1_9 )                            \
+    X( RF_MODEM_RSSI_CONTROL_1 )                        \
+    X( RF_MODEM_RSSI_COMP_1 )                           \
+    X( RF_MODEM_CLKGEN_BAND_1 )                         \
+    X( RF_MODEM_CHFLT_RX1_CHFLT_COE13_7_0_12 )          \
+    X( RF_MODEM_CHFLT_RX1_CHFLT_COE1_7_0_12 )           \
+    X( RF_MODEM_CHFLT_RX2_CHFLT_COE7_7_0_12 )           \
+    X( RF_SYNTH_PFDCP_CPFF_7 )
+
+static const INT8U profile_base_stream[] =
+{
+    SI446X_MODEM_COMMANDS( SI446X_CFG_ENTRY )
+    0
+};
+static const SI446X_PROFILE profile_base = { profile_base_stream, 10000, -128 };
+
+/*The RX ring is indexed by masking free running INT8U head and tail counters*/
+typedef char SI446X_CHECK_RX_RING_SIZE[ ( SI446X_RX_RING_SIZE & ( SI446X_RX_RING_SIZE - 1 ) ) == 0 &&
+    SI446X_RX_RING_SIZE >= 2 && SI446X_RX_RING_SIZE <= 128 ? 1 : -1 ];
+
+/*The radio on SPI0, the one of the single radio API*/
+SI446X_DEV g_sSi446xDev0 = { .bus = &g_sSi4463Bus0, .config = config_table };
+
+/*Property groups kept in the shadow, in the order they are stored: group, count*/
+#define SI446X_SHADOW_GROUPS( X )                                           \
+    X( 0x00, 0x0A ) X( 0x01, 0x04 ) X( 0x02, 0x04 ) X( 0x10, 0x0E )        \
+    X( 0x11, 0x06 ) X( 0x12, 0x36 ) X( 0x20, 0x60 ) X( 0x21, 0x24 )        \
+    X( 0x22, 0x07 ) X( 0x23, 0x08 ) X( 0x30, 0x0C ) X( 0x40, 0x08 )        \
+    X( 0x50, 0x42 )
+
+#define SI446X_SHADOW_ENTRY( group, count )     { group, count },
+#define SI446X_SHADOW_COUNT( group, count )     + count
+
+static const struct
+{
+    INT8U group;
+    INT8U count;
+}shadow_groups[] =
+{
+    SI446X_SHADOW_GROUPS( SI446X_SHADOW_ENTRY )
+};
+
+/*A group added to or resized in the list above must be counted in SI446X_SHADOW_SIZE*/
+typedef char SI446X_CHECK_SHADOW_SIZE[
+    ( 0 SI446X_SHADOW_GROUPS( SI446X_SHADOW_COUNT ) ) == SI446X_SHADOW_SIZE ? 1 : -1 ];
+
+#if SI446X_TRACE
+static void SI446X_TRACE_OPEN( SI446X_DEV *dev );
+static void SI446X_TRACE_CLOSE( SI446X_DEV *dev );
+static INT8U SI446X_TRACE_BYTE( SI446X_DEV *dev, INT8U input );
+
+/*Own the bus against the nIRQ handler for one chip select window*/
+#define SI446X_SELECT( )    do { SI446X_LOCK( dev ); SI446X_TRACE_OPEN( dev ); SI_CSN_LOW( ); } while( 0 )
+#define SI446X_DESELECT( )  do { SI_CSN_HIGH( ); SI446X_TRACE_CLOSE( dev ); SI446X_UNLOCK( dev ); } while( 0 )
+
+/*SPI transfers on the bus of dev, counted for the trace*/
+#define SI446X_SPI_BYTE( input )                SI446X_TRACE_BYTE( dev, input )
+#define SI446X_SPI_BLOCK( tx, rx, size, cb )    \
+    ( dev->trace.bytes += ( size ), Si4463_BUS_BLOCK( dev->bus, tx, rx, size, cb ) )
+#else
+/*Own the bus against the nIRQ handler for one chip select window*/
+#define SI446X_SELECT( )    do { SI446X_LOCK( dev ); SI_CSN_LOW( ); } while( 0 )
+#define SI446X_DESELECT( )  do { SI_CSN_HIGH( ); SI446X_UNLOCK( dev ); } while( 0 )
+
+/*SPI transfers on the bus of dev*/
+#define SI446X_SPI_BYTE( input )                Si4463_BUS_BYTE( dev->bus, input )
+#define SI446X_SPI_BLOCK( tx, rx, size, cb )    Si4463_BUS_BLOCK( dev->bus, tx, rx, size, cb )
+#endif
   
 /*read a array of command response*/
-void SI446X_READ_RESPONSE( INT8U *buffer, INT8U size );
-
-/*wait the device ready to response a command*/
-void SI446X_WAIT_CTS( void );
+INT8U SI446X_READ_RESPONSE( SI446X_DEV *dev, INT8U *buffer, INT8U size );
 
 /*write data to TX fifo*/
-void SI446X_W_TX_FIFO( INT8U *txbuffer, INT8U size );
+void SI446X_DEV_W_TX_FIFO( SI446X_DEV *dev, INT8U *txbuffer, INT8U size );
+
+/*read data from RX fifo*/
+static void SI446X_R_RX_FIFO( SI446X_DEV *dev, INT8U *rxbuffer, INT16U size );
+
+/*reset the TX (0x01) and/or RX (0x02) fifo*/
+static void SI446X_FIFO_RESET( SI446X_DEV *dev, INT8U mask );
+
+/*read a packet out of the RX FIFO, duplicates only up to their header*/
+static BOOLEAN SI446X_RX_READ( SI446X_DEV *dev, INT8U *buffer, INT8U keep, INT8U length );
+
+/*move the complete packets in the RX FIFO into the RX ring*/
+static BOOLEAN SI446X_RX_DRAIN( SI446X_DEV *dev, INT32U timestamp, INT8U pend );
+
+/*clear packet handler pending interrupts*/
+static void SI446X_PH_CLEAR( SI446X_DEV *dev, INT8U mask );
+
+/*add the destination filter to a property batch*/
+static void SI446X_FILTER_ADD( SI446X_DEV *dev, SI446X_PROP_BATCH *batch );
+
+
+/*!
+ * Set up a radio. Its bus must be initialized, Si4463_BUS_INIT( ) for buses
+ * other than the one on SPI0; then SI446X_DEV_RESET( radio ) and
+ * SI446X_DEV_CONFIG_INIT( radio ) as for the single radio.
+ *
+ * @param radio     the radio
+ * @param bus       its SPI bus and pins
+ * @param config    its configuration stream of SI446X_CFG_ENTRY commands, 0
+ *                  terminated; NULL for the one of radio_config.h
+ */
+void SI446X_DEV_INIT( SI446X_DEV *radio, SI4463_BUS *bus, const INT8U *config )
+{
+    memset( radio, 0, sizeof( *radio ) );
+    radio->bus = bus;
+    radio->config = config ? config : config_table;
+}
+/*!
+ * Keep the nIRQ handler of this radio off its bus. Sequences that must not be
+ * split, like a command and its response, run inside a LOCK/UNLOCK pair.
+ * Pairs nest; the handler itself also takes it, which is harmless since it
+ * cannot preempt itself. Radios on other buses keep their interrupts.
+ */
+static void SI446X_LOCK( SI446X_DEV *dev )
+{
+    if( dev->lock_depth++ == 0 )   { Si4463_BUS_IRQ_MASK( dev->bus, BOOL_TRUE ); }
+}
+static void SI446X_UNLOCK( SI446X_DEV *dev )
+{
+    if( --dev->lock_depth == 0 )   { Si4463_BUS_IRQ_MASK( dev->bus, BOOL_FALSE ); }
+}
+/*!
+ * Place of a property in the shadow
+ *
+ * @param prop  the group and number index
+ * @return index in shadow.value, -1 if the property is not shadowed
+ */
+static INT16S SI446X_SHADOW_INDEX( INT16U prop )
+{
+    INT16U offset = 0;
+    INT8U i;
+
+    for( i = 0; i < sizeof( shadow_groups ) / sizeof( shadow_groups[0] ); i ++ )
+    {
+        if( shadow_groups[i].group == ( prop >> 8 ) )
+        {
+            return ( prop & 0xFF ) < shadow_groups[i].count ? offset + ( prop & 0xFF ) : -1;
+        }
+        offset += shadow_groups[i].count;
+    }
+    return -1;
+}
+/*!
+ * Read a property from the shadow
+ *
+ * @param dev   the radio
+ * @param prop  the group and number index
+ * @param value where to put the value
+ * @return BOOL_TRUE if the shadow holds the value the radio has
+ */
+static BOOLEAN SI446X_SHADOW_GET( SI446X_DEV *dev, INT16U prop, INT8U *value )
+{
+    INT16S index = SI446X_SHADOW_INDEX( prop );
+
+    if( index < 0 || !GetBit( dev->shadow.valid[index >> 3], index & 7 ) )
+    {
+        return BOOL_FALSE;
+    }
+    *value = dev->shadow.value[index];
+    return BOOL_TRUE;
+}
+/*!
+ * Record a property value the radio has
+ *
+ * @param dev   the radio
+ * @param prop  the group and number index
+ * @param value the value
+ */
+static void SI446X_SHADOW_SET( SI446X_DEV *dev, INT16U prop, INT8U value )
+{
+    INT16S index = SI446X_SHADOW_INDEX( prop );
 
+    if( index < 0 ) { return; }
+    dev->shadow.value[index] = value;
+    SetBits( dev->shadow.valid[index >> 3], BitMap( index & 7 ) );
+}
+/*!
+ * Follow the commands sent to the radio: SET_PROPERTY updates the shadow,
+ * POWER_UP brings every property back to an unknown default.
+ *
+ * @param dev       the radio
+ * @param pData     the command
+ * @param byteCount its length
+ */
+static void SI446X_SHADOW_TRACK( SI446X_DEV *dev, const INT8U *pData, INT8U byteCount )
+{
+    INT16U prop;
+    INT8U i;
 
+    if( pData[0] == POWER_UP )
+    {
+        memset( dev->shadow.valid, 0, sizeof( dev->shadow.valid ) );
+    }
+    else if( pData[0] == SET_PROPERTY && byteCount > 4 )
+    {
+        prop = ( ( INT16U )pData[1] << 8 ) | pData[3];
+        for( i = 0; i < pData[2] && 4 + i < byteCount; i ++ )
+        {
+            SI446X_SHADOW_SET( dev, prop + i, pData[4 + i] );
+        }
+    }
+}
 /*!
  * Sends a command to the radio chip
  *
+ * @param dev           the radio
  * @param byteCount     Number of bytes in the command to send to the radio device
  * @param pData         Pointer to the command to send.
  */
-void SI446X_CMD( INT8U *pData, INT8U byteCount )
+INT8U SI446X_DEV_CMD( SI446X_DEV *dev, const INT8U *pData, INT8U byteCount )
 {
-    SI446X_WAIT_CTS( );
-    SI_CSN_LOW( );
+    SI446X_LOCK( dev );
+    if( SI446X_DEV_WAIT_CTS( dev ) != SI446X_OK )
+    {
+        SI446X_UNLOCK( dev );
+        UARTprintf("SI4463: CTS TIMEOUT %02x\n", *pData);
+        return SI446X_ERR_CTS_TIMEOUT;
+    }
+    SI446X_SHADOW_TRACK( dev, pData, byteCount );
+    SI446X_SELECT( );
     while( byteCount -- )
     {
-        SPI_ExchangeByte( *pData++ );
+        SI446X_SPI_BYTE( *pData++ );
     }
-    SI_CSN_HIGH( );
+    SI446X_DESELECT( );
+    SI446X_UNLOCK( dev );
+    return SI446X_OK;
 }
 /*!
  * This function is used to initialize after power-up the radio chip.
  * Before this function @si446x_reset should be called.
  */
-void SI446X_POWER_UP( INT32U XO_FREQ )
+void SI446X_DEV_POWER_UP( SI446X_DEV *dev, INT32U XO_FREQ )
 {
     INT8U cmd[7];
     cmd[0] = POWER_UP;
@@ -54,92 +335,338 @@ void SI446X_POWER_UP( INT32U XO_FREQ )
     cmd[4] = XO_FREQ>>16;
     cmd[5] = XO_FREQ>>8;
     cmd[6] = XO_FREQ;
-    SI446X_CMD( cmd, 7 );
+    SI446X_DEV_CMD( dev, cmd, 7 );
 }
 /*!
  * Gets a command response from the radio chip
  *
+ * @param dev           the radio
  * @param byteCount     Number of bytes to get from the radio chip
  * @param pData         Pointer to where to put the data
  *
  * 
  */
-void SI446X_READ_RESPONSE( INT8U *pData, INT8U byteCount )
+INT8U SI446X_READ_RESPONSE( SI446X_DEV *dev, INT8U *pData, INT8U byteCount )
 {
-    SI446X_WAIT_CTS( );
-    SI_CSN_LOW( );
-   	SPI_ExchangeByte( READ_CMD_BUFF );
-	if(SPI_ExchangeByte(0) == 0xff)	{
+    INT8U status = SI446X_OK;
+
+    SI446X_LOCK( dev );
+    if( SI446X_DEV_WAIT_CTS( dev ) != SI446X_OK )
+    {
+        SI446X_UNLOCK( dev );
+        UARTprintf("SI4463: CTS TIMEOUT\n");
+        return SI446X_ERR_CTS_TIMEOUT;
+    }
+    SI446X_SELECT( );
+   	SI446X_SPI_BYTE( READ_CMD_BUFF );
+	if(SI446X_SPI_BYTE(0) == 0xff)	{
 		while( byteCount -- )
 		{
-			*pData++ = SPI_ExchangeByte( 0xFF );
+			*pData++ = SI446X_SPI_BYTE( 0xFF );
 		}
 	}
 	else {
 		UARTprintf("SI4463: READ FAULT\n");
+		status = SI446X_ERR_READ;
 	}
-    SI_CSN_HIGH( );
+    SI446X_DESELECT( );
+    SI446X_UNLOCK( dev );
+    return status;
 }
 
 /*!
-
- wait the device ready to response a command
+ * Wait the device ready to response a command. The CTS rising edge interrupt
+ * wakes the core, so it sleeps (or serves other interrupts) in between.
+ *
+ * @return SI446X_OK, or SI446X_ERR_CTS_TIMEOUT after SI446X_CTS_TIMEOUT_US
  */
-void SI446X_WAIT_CTS( void )
+INT8U SI446X_DEV_WAIT_CTS( SI446X_DEV *dev )
 {
+    INT32U start, elapsed = 0;
+
 #if 1
-	while(GPIOPinRead(SI4463_CTS_PORT, SI4463_CTS_PIN) == 0);
+    if( !Si4463_BUS_CTS( dev->bus ) )
+    {
+        INT32U limit = SI446X_US_CYCLES( SI446X_CTS_TIMEOUT_US );
+
+        start = Si4463_CYCLES( );
+        while( !Si4463_BUS_CTS( dev->bus ) )
+        {
+            elapsed = Si4463_CYCLES( ) - start;
+            if( elapsed >= limit )
+            {
+                dev->cts_stats.timeouts ++;
+                return SI446X_ERR_CTS_TIMEOUT;
+            }
+            Si4463_BUS_CTS_IDLE( dev->bus );
+        }
+        elapsed = Si4463_CYCLES( ) - start;
+    }
 #else
     INT8U cts;
+    start = Si4463_CYCLES( );
     do
     {
-        SI_CSN_LOW( );
-        SPI_ExchangeByte( READ_CMD_BUFF );
-        cts = SPI_ExchangeByte( 0xFF );
-        SI_CSN_HIGH( );
+        SI446X_SELECT( );
+        SI446X_SPI_BYTE( READ_CMD_BUFF );
+        cts = SI446X_SPI_BYTE( 0xFF );
+        SI446X_DESELECT( );
+        elapsed = Si4463_CYCLES( ) - start;
+        if( cts != 0xFF &&
+            elapsed >= SI446X_US_CYCLES( SI446X_CTS_TIMEOUT_US ) )
+        {
+            dev->cts_stats.timeouts ++;
+            return SI446X_ERR_CTS_TIMEOUT;
+        }
     } while( cts != 0xFF );
 #endif
+
+#if SI446X_TRACE
+    dev->trace.cts = elapsed;
+#endif
+    dev->cts_stats.waits ++;
+    dev->cts_stats.last = elapsed;
+    dev->cts_stats.total += elapsed;
+    if( elapsed > dev->cts_stats.max )   { dev->cts_stats.max = elapsed; }
+    return SI446X_OK;
+}
+#if SI446X_TRACE
+/*
+=================================================================================
+------------------------------Transaction tracer---------------------------------
+=================================================================================
+*/
+
+/*Shared by all radios; with several, a transaction can be lost when nIRQ
+handlers of different radios trace at the same time*/
+static struct
+{
+    SI446X_TRACE_ENTRY ring[SI446X_TRACE_SIZE];
+    INT16U head, tail;
+    INT8U  opcodes;
+    SI446X_TRACE_HIST hist[SI446X_TRACE_OPCODES];
+}trace;
+
+/*!
+ * A chip select window starts
+ */
+static void SI446X_TRACE_OPEN( SI446X_DEV *dev )
+{
+    dev->trace.start = Si4463_CYCLES( );
+    dev->trace.bytes = 0;
+}
+/*!
+ * Count a byte of the window, the first one is the opcode
+ *
+ * @param dev       the radio
+ * @param input     byte to send
+ * @return byte received
+ */
+static INT8U SI446X_TRACE_BYTE( SI446X_DEV *dev, INT8U input )
+{
+    if( dev->trace.bytes ++ == 0 )  { dev->trace.opcode = input; }
+    return Si4463_BUS_BYTE( dev->bus, input );
+}
+/*!
+ * A chip select window ends: put it in the ring and its histogram. A full
+ * ring loses its oldest entry.
+ */
+static void SI446X_TRACE_CLOSE( SI446X_DEV *dev )
+{
+    SI446X_TRACE_ENTRY *entry;
+    SI446X_TRACE_HIST *hist = NULL;
+    INT32U latency, us;
+    INT8U i, bin;
+
+    if( dev->trace.bytes == 0 ) { return; }
+    entry = &trace.ring[trace.head & ( SI446X_TRACE_SIZE - 1 )];
+    entry->timestamp = dev->trace.start;
+    entry->cts = dev->trace.cts;
+    entry->duration = Si4463_CYCLES( ) - dev->trace.start;
+    entry->bytes = dev->trace.bytes;
+    entry->opcode = dev->trace.opcode;
+    trace.head ++;
+    if( ( INT16U )( trace.head - trace.tail ) > SI446X_TRACE_SIZE )  { trace.tail ++; }
+    dev->trace.cts = 0;
+    dev->trace.bytes = 0;
+
+    for( i = 0; i < trace.opcodes; i ++ )
+    {
+        if( trace.hist[i].opcode == entry->opcode ) { hist = &trace.hist[i]; break; }
+    }
+    if( hist == NULL )
+    {
+        if( trace.opcodes == SI446X_TRACE_OPCODES ) { return; }
+        hist = &trace.hist[trace.opcodes ++];
+        hist->opcode = entry->opcode;
+    }
+    latency = entry->cts + entry->duration;
+    us = SI446X_CYCLES_US( latency );
+    for( bin = 0; bin < SI446X_TRACE_BINS - 1 && us >= ( 1UL << bin ); bin ++ );
+    hist->bin[bin] ++;
+    hist->count ++;
+    hist->total += latency;
+    if( latency > hist->max )   { hist->max = latency; }
+}
+/*!
+ * Take the oldest traced transactions out of the ring
+ *
+ * @param dev       the radio
+ * @param entry     where to put them
+ * @param max       room in entry
+ * @return number of entries taken
+ */
+INT16U SI446X_DEV_TRACE_READ( SI446X_DEV *dev, SI446X_TRACE_ENTRY *entry, INT16U max )
+{
+    INT16U n = 0;
+
+    SI446X_LOCK( dev );
+    while( n < max && trace.tail != trace.head )
+    {
+        entry[n ++] = trace.ring[trace.tail ++ & ( SI446X_TRACE_SIZE - 1 )];
+    }
+    SI446X_UNLOCK( dev );
+    return n;
+}
+/*!
+ * Per opcode histograms, in the order the opcodes were first seen
+ *
+ * @param count     set to the number of histograms
+ */
+const SI446X_TRACE_HIST *SI446X_TRACE_HIST_GET( INT8U *count )
+{
+    *count = trace.opcodes;
+    return trace.hist;
+}
+/*!
+ * Empty the ring and the histograms
+ */
+void SI446X_DEV_TRACE_CLEAR( SI446X_DEV *dev )
+{
+    SI446X_LOCK( dev );
+    memset( &trace, 0, sizeof( trace ) );
+    SI446X_UNLOCK( dev );
+}
+/*!
+ * Print the ring for a host, one transaction per line, times in CPU cycles:
+ * TRACE,timestamp,opcode,bytes,cts,duration. The ring is empty afterwards.
+ */
+void SI446X_DEV_TRACE_DUMP( SI446X_DEV *dev )
+{
+    SI446X_TRACE_ENTRY entry;
+
+    UARTprintf( "TRACE_CLOCK,%u\n", g_ui32SysClock );
+    while( SI446X_DEV_TRACE_READ( dev, &entry, 1 ) )
+    {
+        UARTprintf( "TRACE,%u,%02x,%u,%u,%u\n", entry.timestamp, entry.opcode, entry.bytes,
+                    entry.cts, entry.duration );
+    }
+}
+/*!
+ * Print the histograms, the opcode with the most time spent first. Columns
+ * are the count, mean and max latency in us, the share of all traced time,
+ * and the count per bin: <1, <2, <4 ... us.
+ */
+void SI446X_TRACE_REPORT( void )
+{
+    INT8U order[SI446X_TRACE_OPCODES];
+    INT64U all = 0;
+    const SI446X_TRACE_HIST *h;
+    INT32U mhz = SI446X_US_CYCLES( 1 );
+    INT8U i, j, k;
+
+    for( i = 0; i < trace.opcodes; i ++ )
+    {
+        all += trace.hist[i].total;
+        for( j = i; j > 0 && trace.hist[order[j - 1]].total < trace.hist[i].total; j -- )
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+    UARTprintf( "op  count    mean     max   %%   bins <1 <2 <4 .. us\n" );
+    for( i = 0; i < trace.opcodes; i ++ )
+    {
+        h = &trace.hist[order[i]];
+        UARTprintf( "%02x %6u %7u %7u %3u  ", h->opcode, h->count,
+                    ( INT32U )( h->total / h->count / mhz ), h->max / mhz,
+                    ( INT32U )( all ? h->total * 100 / all : 0 ) );
+        for( k = 0; k < SI446X_TRACE_BINS; k ++ )   { UARTprintf( " %u", h->bin[k] ); }
+        UARTprintf( "\n" );
+    }
+}
+/*!
+ * Console command: rtrace prints the histograms, rtrace dump the ring,
+ * rtrace clear empties both
+ */
+int Cmd_rtrace( int argc, char *argv[] )
+{
+    if( argc > 1 && strcmp( argv[1], "dump" ) == 0 )        { SI446X_TRACE_DUMP( ); }
+    else if( argc > 1 && strcmp( argv[1], "clear" ) == 0 )  { SI446X_TRACE_CLEAR( ); }
+    else                                                    { SI446X_TRACE_REPORT( ); }
+    return 0;
+}
+#endif //SI446X_TRACE
+/*!
+ * Read the CTS wait statistics
+ */
+const SI446X_CTS_STATS *SI446X_DEV_CTS_STATS_GET( SI446X_DEV *dev )
+{
+    return &dev->cts_stats;
+}
+/*!
+ * Clear the CTS wait statistics
+ */
+void SI446X_DEV_CTS_STATS_CLEAR( SI446X_DEV *dev )
+{
+    memset( &dev->cts_stats, 0, sizeof( dev->cts_stats ) );
 }
 /* Extended driver support functions */
 /*!
  * Sends NOP command to the radio. Can be used to maintain SPI communication.
  */
-INT8U SI446X_NOP( void )
+INT8U SI446X_NOP( SI446X_DEV *dev )
 {
     INT8U cts;
-    SI_CSN_LOW( );
-    cts = SPI_ExchangeByte( NOP );
-    SI_CSN_HIGH( );
+    SI446X_SELECT( );
+    cts = SI446X_SPI_BYTE( NOP );
+    SI446X_DESELECT( );
 	return cts;
 }
 
 /*! This function sends the PART_INFO command to the radio and receives the answer
  *  @param pData         Pointer to where to put the data
  */
-void SI446X_PART_INFO( INT8U *pData )
+void SI446X_DEV_PART_INFO( SI446X_DEV *dev, INT8U *pData )
 {
     INT8U cmd = PART_INFO;
 
-    SI446X_CMD( &cmd, 1 );
-    SI446X_READ_RESPONSE( pData, 8 );
+    SI446X_LOCK( dev );
+    SI446X_DEV_CMD( dev, &cmd, 1 );
+    SI446X_READ_RESPONSE( dev, pData, 8 );
+    SI446X_UNLOCK( dev );
 }
 
 /*!
  * Sends the FUNC_INFO command to the radio, then reads the resonse into @Si446xCmd union.
+ * @param dev           the radio
  * @param pData         Pointer to where to put the data
  */
-void SI446X_FUNC_INFO( INT8U *pData )
+void SI446X_DEV_FUNC_INFO( SI446X_DEV *dev, INT8U *pData )
 {
     INT8U cmd = FUNC_INFO;
 
-    SI446X_CMD( &cmd, 1 );
-    SI446X_READ_RESPONSE( pData, 7 );
+    SI446X_LOCK( dev );
+    SI446X_DEV_CMD( dev, &cmd, 1 );
+    SI446X_READ_RESPONSE( dev, pData, 7 );
+    SI446X_UNLOCK( dev );
 }
 /*!
  * Read the INT status of the device, 9 bytes needed
+ * @param dev           the radio
  * @param pData         Pointer to where to put the data
 */
-void SI446X_INT_STATUS( INT8U *pData )
+void SI446X_DEV_INT_STATUS( SI446X_DEV *dev, INT8U *pData )
 {
     INT8U cmd[4];
     cmd[0] = GET_INT_STATUS;
@@ -147,41 +674,100 @@ void SI446X_INT_STATUS( INT8U *pData )
     cmd[2] = 0;
     cmd[3] = 0;
 
-    SI446X_CMD( cmd, 4 );
-    SI446X_READ_RESPONSE( pData, 9 );
+    SI446X_LOCK( dev );
+    SI446X_DEV_CMD( dev, cmd, 4 );
+    SI446X_READ_RESPONSE( dev, pData, 9 );
+    SI446X_UNLOCK( dev );
 
 }
 /*!
- * Get property values from the radio. Reads them into Si446xCmd union.
+ * Read property values from the radio itself, bypassing the shadow.
  *
- * @param GROUP_NUM       Property group number.
- * @param NUM_PROPS   Number of properties to be read.
- * @param pData         Pointer to where to put the data
+ * @param dev       the radio
+ * @param prop      first property
+ * @param NUM_PROPS number of properties, up to 16
+ * @param pData     where to put the values
+ * @return SI446X_OK or the error of the transaction
  */
-void SI446X_GET_PROPERTY_X( SI446X_PROPERTY GROUP_NUM, INT8U NUM_PROPS, INT8U *pData  )
+static INT8U SI446X_READ_PROPERTIES( SI446X_DEV *dev, INT16U prop, INT8U NUM_PROPS,
+                                     INT8U *pData )
 {
-    INT8U cmd[4];
+    INT8U cmd[4], status;
 
     cmd[0] = GET_PROPERTY;
-    cmd[1] = GROUP_NUM>>8;
+    cmd[1] = prop>>8;
     cmd[2] = NUM_PROPS;
-    cmd[3] = GROUP_NUM;
+    cmd[3] = prop;
+
+    SI446X_LOCK( dev );
+    status = SI446X_DEV_CMD( dev, cmd, 4 );
+    if( status == SI446X_OK )   { status = SI446X_READ_RESPONSE( dev, pData, NUM_PROPS ); }
+    SI446X_UNLOCK( dev );
+    return status;
+}
+/*!
+ * Get property values. Values the driver has written are served from the
+ * shadow with no SPI traffic; anything else is read from the radio once and
+ * remembered.
+ *
+ * @param dev             the radio
+ * @param GROUP_NUM       Property group number.
+ * @param NUM_PROPS   Number of properties to be read, up to 16.
+ * @param pData         Pointer to where to put the data
+ */
+void SI446X_DEV_GET_PROPERTY_X( SI446X_DEV *dev, SI446X_PROPERTY GROUP_NUM, INT8U NUM_PROPS,
+                                INT8U *pData  )
+{
+    INT8U i;
+
+    for( i = 0; i < NUM_PROPS; i ++ )
+    {
+        if( !SI446X_SHADOW_GET( dev, GROUP_NUM + i, pData + i ) )    { break; }
+    }
+    if( i == NUM_PROPS )
+    {
+        dev->shadow_stats.reads_served ++;
+        return;
+    }
 
-    SI446X_CMD( cmd, 4 );
-    SI446X_READ_RESPONSE( pData, NUM_PROPS + 1 );
+    if( SI446X_READ_PROPERTIES( dev, GROUP_NUM, NUM_PROPS, pData ) == SI446X_OK )
+    {
+        for( i = 0; i < NUM_PROPS; i ++ )   { SI446X_SHADOW_SET( dev, GROUP_NUM + i, pData[i] ); }
+    }
 }
 /*!
  * Send SET_PROPERTY command to the radio.
  *
+ * @param dev         the radio
  * @param GROUP       Property group.
  * @param NUM_PROPS   Number of property to be set. The properties must be in ascending order
  *                    in their sub-property aspect. Max. 12 properties can be set in one command.
  * @param pData         Pointer to where to put the data
  */
-void SI446X_SET_PROPERTY_X( SI446X_PROPERTY GROUP_NUM, INT8U NUM_PROPS, INT8U *pData )
+void SI446X_DEV_SET_PROPERTY_X( SI446X_DEV *dev, SI446X_PROPERTY GROUP_NUM, INT8U NUM_PROPS,
+                                INT8U *pData )
 {
-    INT8U cmd[20], i = 0;
+    INT8U cmd[20], i = 0, value;
     if( NUM_PROPS >= 16 )   { return; }
+
+    // Leading and trailing values the radio already has are not sent
+    while( NUM_PROPS && SI446X_SHADOW_GET( dev, GROUP_NUM, &value ) && value == *pData )
+    {
+        GROUP_NUM ++;
+        pData ++;
+        NUM_PROPS --;
+    }
+    while( NUM_PROPS && SI446X_SHADOW_GET( dev, GROUP_NUM + NUM_PROPS - 1, &value ) &&
+           value == pData[NUM_PROPS - 1] )
+    {
+        NUM_PROPS --;
+    }
+    if( NUM_PROPS == 0 )
+    {
+        dev->shadow_stats.writes_elided ++;
+        return;
+    }
+
     cmd[i++] = SET_PROPERTY;
     cmd[i++] = GROUP_NUM>>8;
     cmd[i++] = NUM_PROPS;
@@ -190,7 +776,113 @@ void SI446X_SET_PROPERTY_X( SI446X_PROPERTY GROUP_NUM, INT8U NUM_PROPS, INT8U *p
     {
         cmd[i++] = *pData++;
     }
-    SI446X_CMD( cmd, i );
+    SI446X_DEV_CMD( dev, cmd, i );
+}
+/*!
+ * Start an empty property batch.
+ *
+ * @param batch     the batch
+ */
+void SI446X_PROP_BATCH_INIT( SI446X_PROP_BATCH *batch )
+{
+    batch->count = 0;
+}
+/*!
+ * Add a property write to a batch. Nothing is sent until the batch is
+ * flushed; a full batch is flushed first.
+ *
+ * @param dev       the radio
+ * @param batch     the batch
+ * @param GROUP_NUM the group and number index
+ * @param value     the value to be set
+ */
+void SI446X_DEV_PROP_BATCH_ADD( SI446X_DEV *dev, SI446X_PROP_BATCH *batch,
+                                SI446X_PROPERTY GROUP_NUM, INT8U value )
+{
+    if( batch->count >= SI446X_PROP_BATCH_SIZE )    { SI446X_DEV_PROP_BATCH_FLUSH( dev, batch ); }
+
+    batch->prop[batch->count] = GROUP_NUM;
+    batch->value[batch->count] = value;
+    batch->count ++;
+}
+/*!
+ * Write a batch with the fewest SET_PROPERTY commands. Writes are sorted by
+ * property, a later write to the same property wins, and every run of
+ * consecutive properties in one group goes out as one command of up to
+ * SI446X_PROP_MAX_PER_CMD values. Writes the shadow says are already in
+ * the radio are dropped. The batch is empty afterwards.
+ *
+ * @param dev       the radio
+ * @param batch     the batch
+ * @return number of SET_PROPERTY commands sent
+ */
+INT8U SI446X_DEV_PROP_BATCH_FLUSH( SI446X_DEV *dev, SI446X_PROP_BATCH *batch )
+{
+    INT8U values[SI446X_PROP_MAX_PER_CMD];
+    INT8U i, j, n, cmds = 0;
+    INT16U prop, start = 0;
+    INT8U value;
+
+    // Insertion sort, stable so the last write to a property stays last
+    for( i = 1; i < batch->count; i ++ )
+    {
+        prop = batch->prop[i];
+        value = batch->value[i];
+        for( j = i; j > 0 && batch->prop[j - 1] > prop; j -- )
+        {
+            batch->prop[j] = batch->prop[j - 1];
+            batch->value[j] = batch->value[j - 1];
+        }
+        batch->prop[j] = prop;
+        batch->value[j] = value;
+    }
+
+    // Keep the last write to each property, and only if the radio does
+    // not already have that value
+    for( i = 0, j = 0; i < batch->count; i ++ )
+    {
+        if( j && batch->prop[j - 1] == batch->prop[i] ) { j --; }
+        batch->prop[j] = batch->prop[i];
+        batch->value[j] = batch->value[i];
+        j ++;
+        if( SI446X_SHADOW_GET( dev, batch->prop[j - 1], &value ) &&
+            value == batch->value[j - 1] )
+        {
+            j --;
+        }
+    }
+    batch->count = j;
+
+    n = 0;
+    for( i = 0; i < batch->count; i ++ )
+    {
+        prop = batch->prop[i];
+        // A short gap of known values is cheaper to resend than to start
+        // another command with its own CTS wait
+        while( n && prop > start + n && ( prop >> 8 ) == ( start >> 8 ) &&
+               prop - start < SI446X_PROP_MAX_PER_CMD &&
+               SI446X_SHADOW_GET( dev, start + n, &values[n] ) )
+        {
+            n ++;
+        }
+        if( n && ( prop != start + n || ( prop >> 8 ) != ( start >> 8 ) ||
+                   n == SI446X_PROP_MAX_PER_CMD ) )
+        {
+            SI446X_DEV_SET_PROPERTY_X( dev, ( SI446X_PROPERTY )start, n, values );
+            cmds ++;
+            n = 0;
+        }
+        if( n == 0 )    { start = prop; }
+        values[n++] = batch->value[i];
+    }
+    if( n )
+    {
+        SI446X_DEV_SET_PROPERTY_X( dev, ( SI446X_PROPERTY )start, n, values );
+        cmds ++;
+    }
+
+    batch->count = 0;
+    return cmds;
 }
 /*
 =================================================================================
@@ -200,16 +892,22 @@ Set the PROPERTY of the device, only 1 byte
 * @param START_PROP  Start sub-property address.
 =================================================================================
 */
-void SI446X_SET_PROPERTY_1( SI446X_PROPERTY GROUP_NUM, INT8U START_PROP )
+void SI446X_DEV_SET_PROPERTY_1( SI446X_DEV *dev, SI446X_PROPERTY GROUP_NUM, INT8U START_PROP )
 {
-    INT8U cmd[5];
+    INT8U cmd[5], value;
+
+    if( SI446X_SHADOW_GET( dev, GROUP_NUM, &value ) && value == START_PROP )
+    {
+        dev->shadow_stats.writes_elided ++;
+        return;
+    }
 
     cmd[0] = SET_PROPERTY;
     cmd[1] = GROUP_NUM>>8;
     cmd[2] = 1;
     cmd[3] = GROUP_NUM;
     cmd[4] = START_PROP;
-    SI446X_CMD( cmd, 5 );
+    SI446X_DEV_CMD( dev, cmd, 5 );
 }
 /*
 
@@ -218,17 +916,66 @@ void SI446X_SET_PROPERTY_1( SI446X_PROPERTY GROUP_NUM, INT8U START_PROP )
 * @param   the PROPERTY value read from device
 
 */
-INT8U SI446X_GET_PROPERTY_1( SI446X_PROPERTY GROUP_NUM )
+INT8U SI446X_DEV_GET_PROPERTY_1( SI446X_DEV *dev, SI446X_PROPERTY GROUP_NUM )
 {
-    INT8U cmd[4];
+    INT8U value = 0;
 
-    cmd[0] = GET_PROPERTY;
-    cmd[1] = GROUP_NUM>>8;
-    cmd[2] = 1;
-    cmd[3] = GROUP_NUM;
-    SI446X_CMD( cmd, 4 );
-    SI446X_READ_RESPONSE( cmd, 2 );
-    return cmd[1];
+    SI446X_DEV_GET_PROPERTY_X( dev, GROUP_NUM, 1, &value );
+    return value;
+}
+/*!
+ * Compare the shadow with the radio. Every shadowed property is read back
+ * and each difference is reported on the console.
+ *
+ * @return number of properties where the radio differs from the shadow
+ */
+INT16U SI446X_DEV_SHADOW_VERIFY( SI446X_DEV *dev )
+{
+    INT8U chip[16], value, g, first, last, i;
+    INT16U prop, diverged = 0;
+    INT16U base;
+
+    for( g = 0; g < sizeof( shadow_groups ) / sizeof( shadow_groups[0] ); g ++ )
+    {
+        for( base = 0; base < shadow_groups[g].count; base += 16 )
+        {
+            // Read only the span between the first and last shadowed value
+            prop = ( ( INT16U )shadow_groups[g].group << 8 ) + base;
+            first = 0xFF;
+            last = 0;
+            for( i = 0; i < 16 && base + i < shadow_groups[g].count; i ++ )
+            {
+                if( SI446X_SHADOW_GET( dev, prop + i, &value ) )
+                {
+                    if( first == 0xFF ) { first = i; }
+                    last = i;
+                }
+            }
+            if( first == 0xFF ) { continue; }
+
+            if( SI446X_READ_PROPERTIES( dev, prop + first, last - first + 1, chip ) != SI446X_OK )
+            {
+                return diverged + 1;
+            }
+            for( i = first; i <= last; i ++ )
+            {
+                if( SI446X_SHADOW_GET( dev, prop + i, &value ) && value != chip[i - first] )
+                {
+                    UARTprintf("SI4463: PROP %04x shadow %02x chip %02x\n",
+                               prop + i, value, chip[i - first]);
+                    diverged ++;
+                }
+            }
+        }
+    }
+    return diverged;
+}
+/*!
+ * Read the property shadow statistics
+ */
+const SI446X_SHADOW_STATS *SI446X_DEV_SHADOW_STATS_GET( SI446X_DEV *dev )
+{
+    return &dev->shadow_stats;
 }
 /*!
  * This functions is used to reset the si446x radio by applying shutdown and
@@ -236,106 +983,428 @@ INT8U SI446X_GET_PROPERTY_1( SI446X_PROPERTY GROUP_NUM )
  * can check if POR has completed by waiting 4 ms or by polling GPIO 0, 2, or 3.
  * When these GPIOs are high, it is safe to call @ref SI446X_CONFIG_INIT.
  */
-void SI446X_RESET( void )
+void SI446X_DEV_RESET( SI446X_DEV *dev )
 {
     INT16U x = 255;
     SI_SDN_HIGH( );
     while( x-- );
     SI_SDN_LOW( );
     SI_CSN_HIGH( );
+    memset( dev->shadow.valid, 0, sizeof( dev->shadow.valid ) );
+    dev->rx_armed.valid = BOOL_FALSE;
+}
+/*!
+ * Program the fast response registers, so the hot paths can read the pending
+ * interrupts, latched RSSI and state with SI446X_FRR_SNAPSHOT( ).
+ *
+ * @param dev       the radio
+ * @param batch     the batch to add the writes to
+ */
+static void SI446X_FRR_CONFIG( SI446X_DEV *dev, SI446X_PROP_BATCH *batch )
+{
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, FRR_CTL_A_MODE, FRR_MODE_INT_PH_PEND );
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, FRR_CTL_B_MODE, FRR_MODE_INT_MODEM_PEND );
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, FRR_CTL_C_MODE, FRR_MODE_LATCHED_RSSI );
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, FRR_CTL_D_MODE, FRR_MODE_CURRENT_STATE );
 }
 /*!
  * This function is used to load all properties and commands with a list of NULL terminated commands.
  * Before this function @SI446X_RESET should be called.
  */
-void SI446X_CONFIG_INIT( void )
+void SI446X_DEV_CONFIG_INIT( SI446X_DEV *dev )
 {
+    SI446X_PROP_BATCH batch;
     INT8U i;
     INT16U j = 0;
 
-    while( ( i = config_table[j] ) != 0 )
+    while( ( i = dev->config[j] ) != 0 )
     {
         j += 1;
-        SI446X_CMD( config_table + j, i );
+        SI446X_DEV_CMD( dev, dev->config + j, i );
         j += i;
     }
+    SI446X_PROP_BATCH_INIT( &batch );
 #if PACKET_LENGTH > 0           //fixed packet length
-    SI446X_SET_PROPERTY_1( PKT_FIELD_1_LENGTH_7_0, PACKET_LENGTH );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_1_LENGTH_7_0, PACKET_LENGTH );
 #else                           //variable packet length
-    SI446X_SET_PROPERTY_1( PKT_CONFIG1, 0x00 );
-    SI446X_SET_PROPERTY_1( PKT_CRC_CONFIG, 0x00 );
-    SI446X_SET_PROPERTY_1( PKT_LEN_FIELD_SOURCE, 0x01 );
-    SI446X_SET_PROPERTY_1( PKT_LEN, 0x2A );
-    SI446X_SET_PROPERTY_1( PKT_LEN_ADJUST, 0x00 );
-    SI446X_SET_PROPERTY_1( PKT_FIELD_1_LENGTH_12_8, 0x00 );
-    SI446X_SET_PROPERTY_1( PKT_FIELD_1_LENGTH_7_0, 0x01 );
-    SI446X_SET_PROPERTY_1( PKT_FIELD_1_CONFIG, 0x00 );
-    SI446X_SET_PROPERTY_1( PKT_FIELD_1_CRC_CONFIG, 0x00 );
-    SI446X_SET_PROPERTY_1( PKT_FIELD_2_LENGTH_12_8, 0x00 );
-    SI446X_SET_PROPERTY_1( PKT_FIELD_2_LENGTH_7_0, 0x20 );
-    SI446X_SET_PROPERTY_1( PKT_FIELD_2_CONFIG, 0x00 );
-    SI446X_SET_PROPERTY_1( PKT_FIELD_2_CRC_CONFIG, 0x00 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_CONFIG1, 0x00 );
+#if SI446X_CRC_ENABLE
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_CRC_CONFIG, SI446X_CRC_POLY );
+#else
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_CRC_CONFIG, 0x00 );
+#endif
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_LEN_FIELD_SOURCE, 0x01 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_LEN, 0x2A );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_LEN_ADJUST, 0x00 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_1_LENGTH_12_8, 0x00 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_1_LENGTH_7_0, 0x01 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_1_CONFIG, 0x00 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_2_LENGTH_12_8, 0x00 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_2_LENGTH_7_0, 0x20 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_2_CONFIG, 0x00 );
+#if SI446X_CRC_ENABLE
+    //CRC starts on the length byte, is sent and checked after the payload
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_1_CRC_CONFIG, 0x82 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_2_CRC_CONFIG, 0x2A );
+    //a bad frame raises no nIRQ, its CRC_ERROR stays latched for the next PACKET_RX
+#else
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_1_CRC_CONFIG, 0x00 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_2_CRC_CONFIG, 0x00 );
+#endif
 #endif //PACKET_LENGTH
+    //an RX FIFO overflow raises nIRQ, the FIFO is out of frame after it
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, INT_CTL_ENABLE, 0x05 );
+    SI446X_DEV_PROP_BATCH_ADD( dev, &batch, INT_CTL_CHIP_ENABLE,
+                               CHIP_FIFO_UNDERFLOW_OVERFLOW_ERROR );
+
+    dev->profile = NULL;
+    dev->filter.offset = SI446X_DST_OFFSET;
+    SI446X_FILTER_ADD( dev, &batch );
+    SI446X_FRR_CONFIG( dev, &batch );
+    SI446X_DEV_PROP_BATCH_FLUSH( dev, &batch );
 
     //SI446X_GPIO_CONFIG( 0, 0, 33|0x40, 32|0x40, 0, 0, 0 );
     //SI446X_GPIO_CONFIG( 0, 0, 0x53, 0x54, 0, 0, 0 );
 }
 /*!
- * The function can be used to load data into TX FIFO.
+ * The modem profile of radio_config.h, which SI446X_CONFIG_INIT loads
+ */
+const SI446X_PROFILE *SI446X_PROFILE_BASE( void )
+{
+    return &profile_base;
+}
+/*!
+ * Switch the modem profile. Every property of the profile goes through a
+ * batch, so the ones the shadow says the radio already has are not sent and
+ * the rest go out in as few SET_PROPERTY commands as they allow. The modem
+ * is not changed under a packet: RX is left for READY during the switch and
+ * re-armed with the last START_RX after it, unless nothing differs at all.
+ * The peer must switch as well.
+ *
+ * @param dev       the radio
+ * @param profile   the profile
+ * @return SI446X_OK, SI446X_ERR_BUSY while the radio sends, SI446X_ERR_STATE
+ *         in RX entered without START_RX since the reset, nothing written
+ */
+INT8U SI446X_DEV_PROFILE_LOAD( SI446X_DEV *dev, const SI446X_PROFILE *profile )
+{
+    SI446X_PROP_BATCH batch;
+    const INT8U *entry;
+    INT32U start = Si4463_CYCLES( );
+    INT16U prop, props = 0, written = 0;
+    INT8U state, i, value, cmds = 0;
+    BOOLEAN rx;
+
+    // What differs is known from the shadow alone
+    for( entry = profile->stream; entry[0] != 0; entry += 1 + entry[0] )
+    {
+        if( entry[1] != SET_PROPERTY )  { continue; }
+        for( i = 0; i < entry[3]; i ++, props ++ )
+        {
+            prop = ( INT16U )entry[2] << 8 | ( INT8U )( entry[4] + i );
+            if( !SI446X_SHADOW_GET( dev, prop, &value ) || value != entry[5 + i] )  { written ++; }
+        }
+    }
+
+    SI446X_LOCK( dev );
+    state = SI446X_DEV_GET_DEVICE_STATE( dev );
+    if( state == STATE_TX || state == STATE_TX_TUNE )
+    {
+        SI446X_UNLOCK( dev );
+        return SI446X_ERR_BUSY;
+    }
+    rx = ( written && ( state == STATE_RX || state == STATE_RX_TUNE ) ) ? BOOL_TRUE : BOOL_FALSE;
+    // RX could not be re-armed after the switch
+    if( rx && !dev->rx_armed.valid )
+    {
+        SI446X_UNLOCK( dev );
+        return SI446X_ERR_STATE;
+    }
+    if( rx )    { SI446X_DEV_CHANGE_STATE( dev, STATE_READY ); }
+
+    SI446X_PROP_BATCH_INIT( &batch );
+    for( entry = profile->stream; written && entry[0] != 0; entry += 1 + entry[0] )
+    {
+        if( entry[1] != SET_PROPERTY )  { continue; }
+        for( i = 0; i < entry[3]; i ++ )
+        {
+            if( batch.count == SI446X_PROP_BATCH_SIZE ) { cmds += SI446X_DEV_PROP_BATCH_FLUSH( dev, &batch ); }
+            SI446X_DEV_PROP_BATCH_ADD( dev, &batch, ( SI446X_PROPERTY )( ( INT16U )entry[2] << 8 |
+                                   ( INT8U )( entry[4] + i ) ), entry[5 + i] );
+        }
+    }
+    cmds += SI446X_DEV_PROP_BATCH_FLUSH( dev, &batch );
+
+    if( rx )
+    {
+        dev->rx_length = 0;
+        SI446X_DEV_START_RX( dev, dev->rx_armed.arg[0], dev->rx_armed.arg[1],
+                         ( INT16U )dev->rx_armed.arg[2] << 8 | dev->rx_armed.arg[3],
+                         dev->rx_armed.arg[4], dev->rx_armed.arg[5], dev->rx_armed.arg[6] );
+    }
+    SI446X_UNLOCK( dev );
+
+    dev->profile = profile;
+    dev->profile_stats.switches ++;
+    dev->profile_stats.props = props;
+    dev->profile_stats.written = written;
+    dev->profile_stats.commands = cmds;
+    dev->profile_stats.last = Si4463_CYCLES( ) - start;
+    if( dev->profile_stats.last > dev->profile_stats.max )
+    {
+        dev->profile_stats.max = dev->profile_stats.last;
+    }
+    return SI446X_OK;
+}
+/*!
+ * Pick a profile for a link. Faster profiles need a stronger signal for the
+ * same error rate, so the table lists them slowest first, each with the
+ * weakest RSSI it is good for.
  *
+ * @param table     the profiles, slowest first
+ * @param count     number of profiles
+ * @param rssi_dbm  RSSI of the link, e.g. SI446X_RX_SLOT rssi
+ * @return index of the fastest profile the link can use, 0 if none
+ */
+INT8U SI446X_PROFILE_FOR_RSSI( const SI446X_PROFILE *table, INT8U count, INT8S rssi_dbm )
+{
+    INT8U i, pick = 0;
+
+    for( i = 0; i < count; i ++ )
+    {
+        if( rssi_dbm >= table[i].min_rssi_dbm ) { pick = i; }
+    }
+    return pick;
+}
+/*!
+ * Read the profile switch statistics
+ */
+const SI446X_PROFILE_STATS *SI446X_DEV_PROFILE_STATS_GET( SI446X_DEV *dev )
+{
+    return &dev->profile_stats;
+}
+/*!
+ * The function can be used to load data into TX FIFO.
+ *
+ * @param dev       the radio
  * @param numBytes  Data length to be load.
  * @param pTxData   Pointer to the data (U8*).
  */
-void SI446X_W_TX_FIFO( INT8U *pTxData, INT8U numBytes )
+void SI446X_DEV_W_TX_FIFO( SI446X_DEV *dev, INT8U *pTxData, INT8U numBytes )
 {
-    SI_CSN_LOW( );
-    SPI_ExchangeByte( WRITE_TX_FIFO );
-    while( numBytes -- )    { SPI_ExchangeByte( *pTxData++ ); }
-    SI_CSN_HIGH( );
+    SI446X_SELECT( );
+    SI446X_SPI_BYTE( WRITE_TX_FIFO );
+    SI446X_SPI_BLOCK( pTxData, NULL, numBytes, NULL );
+    SI446X_DESELECT( );
+}
+/*!
+ * Write a frame given as segments into the TX FIFO, with its length byte in
+ * variable mode, in one chip select window.
+ *
+ * @param dev       the radio
+ * @param seg       the segments, in frame order
+ * @param count     number of segments
+ * @param numBytes  sum of the segment lengths, VMX_MAX_BUFFER+4 at most
+ * @return TX_LEN for START_TX
+ */
+static INT8U SI446X_TX_LOAD_SEG( SI446X_DEV *dev, const SI446X_SEG *seg, INT8U count,
+                                 INT8U numBytes )
+{
+    INT8U length = numBytes;
+
+    SI446X_SELECT( );
+    SI446X_SPI_BYTE( WRITE_TX_FIFO );
+#if PACKET_LENGTH == 0
+    length ++;
+    SI446X_SPI_BYTE( numBytes );
+#endif
+    for( ; count; count --, seg ++ )
+    {
+        if( seg->length )   { SI446X_SPI_BLOCK( seg->data, NULL, seg->length, NULL ); }
+    }
+    SI446X_DESELECT( );
+    return length;
+}
+/*!
+ * Write a frame into the TX FIFO, with its length byte in variable mode.
+ *
+ * @param dev       the radio
+ * @param pTxData   the frame
+ * @param numBytes  its length, clipped to VMX_MAX_BUFFER+4
+ * @return TX_LEN for START_TX
+ */
+static INT8U SI446X_TX_LOAD( SI446X_DEV *dev, const INT8U *pTxData, INT8U numBytes )
+{
+    SI446X_SEG seg;
+
+    if(numBytes > VMX_MAX_BUFFER+4) numBytes = VMX_MAX_BUFFER+4; // '+4' is for appkey, dst and src.
+    seg.data = pTxData;
+    seg.length = numBytes;
+    return SI446X_TX_LOAD_SEG( dev, &seg, 1, numBytes );
+}
+/*!
+ * Empty the FIFOs for a frame about to be sent; the caller holds the LOCK.
+ * With STATE_RX as TXCOMPLETE_STATE the RX FIFO is reset too, but the
+ * packets already complete in it are moved to the RX ring first: their
+ * PACKET_RX waits behind the LOCK and the handler would find them gone.
+ * Only a packet still being received is cut short.
+ *
+ * @param dev       the radio
+ * @param condition tx condition of the frame
+ */
+static void SI446X_TX_PREPARE( SI446X_DEV *dev, INT8U condition )
+{
+    SI446X_FRR frr;
+
+    if( ( condition >> 4 ) != STATE_RX )
+    {
+        SI446X_DEV_TX_FIFO_RESET( dev );
+        return;
+    }
+    // PACKET_RX stays pending for the handler, which finds the FIFO empty
+    SI446X_DEV_FRR_SNAPSHOT( dev, &frr );
+    if( frr.ph_pend & PH_CRC_ERROR )    { SI446X_PH_CLEAR( dev, PH_CRC_ERROR ); }
+    if( SI446X_RX_DRAIN( dev, Si4463_CYCLES( ), frr.ph_pend ) ) { dev->ack.stats.skipped ++; }
+    SI446X_FIFO_RESET( dev, 0x03 );
+    dev->rx_length = 0;
 }
 /*
 send a packet
 * @param pTxData, a buffer stores TX array
-* @param numBytes,  how many bytes should be written
+* @param numBytes,  how many bytes should be written, clipped to VMX_MAX_BUFFER+4
 * @param channel, tx channel
 * @param condition, tx condition
 */
-void SI446X_SEND_PACKET( INT8U *pTxData, INT8U numBytes, INT8U channel, INT8U condition )
+void SI446X_DEV_SEND_PACKET( SI446X_DEV *dev, const INT8U *pTxData, INT8U numBytes,
+                             INT8U channel, INT8U condition )
 {
-    INT8U cmd[5];
-    INT8U length, i; //tx_len = numBytes;
+    SI446X_SEG seg;
 
-    if(numBytes > VMX_MAX_BUFFER+4) numBytes = VMX_MAX_BUFFER+4; // '+4' is for appkey, dst and src.
-    length = numBytes;
+    seg.data = pTxData;
+    seg.length = GetMin( numBytes, VMX_MAX_BUFFER+4 );
+    SI446X_DEV_SEND_SEG( dev, &seg, 1, channel, condition );
+}
+/*!
+ * Send a frame gathered from several buffers, e.g. appkey, dst, src and the
+ * payload where they already are, without copying them together. The
+ * buffers are only read.
+ *
+ * With STATE_RX as TXCOMPLETE_STATE, as the RX engine sends, the RX FIFO is
+ * reset too: a frame being received when TX starts is cut short, and its
+ * bytes left in the FIFO would be taken for the next frame. Frames already
+ * complete go to the RX ring first.
+ *
+ * @param dev       the radio
+ * @param seg       the segments, in frame order
+ * @param count     number of segments
+ * @param channel   tx channel
+ * @param condition tx condition
+ * @return SI446X_OK, SI446X_ERR_PARAM if the frame is over VMX_MAX_BUFFER+4
+ */
+INT8U SI446X_DEV_SEND_SEG( SI446X_DEV *dev, const SI446X_SEG *seg, INT8U count,
+                           INT8U channel, INT8U condition )
+{
+    INT8U cmd[5], status;
+    INT16U numBytes = 0;
+    INT8U i;
 
-    SI446X_TX_FIFO_RESET( );
+    for( i = 0; i < count; i ++ )   { numBytes += seg[i].length; }
+    if( numBytes > VMX_MAX_BUFFER+4 )   { return SI446X_ERR_PARAM; }
 
-    SI_CSN_LOW( );
-    SPI_ExchangeByte( WRITE_TX_FIFO );
+    SI446X_LOCK( dev );
+    SI446X_TX_PREPARE( dev, condition );
+    cmd[0] = START_TX;
+    cmd[1] = channel;
+    cmd[2] = condition;
+    cmd[3] = 0;
+    cmd[4] = SI446X_TX_LOAD_SEG( dev, seg, count, ( INT8U )numBytes );
+    status = SI446X_DEV_CMD( dev, cmd, 5 );
+    SI446X_UNLOCK( dev );
+    return status;
+}
+/*!
+ * Callback of the chunks of SI446X_SEND_SOURCE. It does nothing: passing a
+ * callback is what makes Si4463_BUS_BLOCK return with the chunk still on the
+ * uDMA, and the next block, or Si4463_BUS_WAIT, waits for it
+ */
+static void SI446X_SOURCE_SENT( void )
+{
+}
+/*!
+ * Send a frame whose tail is made while it is written, e.g. encrypted: the
+ * header segments go first, then source is asked for length bytes, a chunk
+ * at a time, inside the same WRITE_TX_FIFO. Each chunk leaves on the uDMA
+ * while source makes the next one into the other of two chunk buffers, so
+ * the frame is never put together in memory. Not to be called from handlers
+ * at or above the SSI interrupt priority, which ends the transfers.
+ *
+ * @param dev       the radio
+ * @param seg       the header segments, in frame order, count 0 for none
+ * @param count     number of segments
+ * @param source    makes the tail; a chunk of 0 bytes drops the frame
+ * @param arg       passed to source
+ * @param length    bytes of the tail
+ * @param channel   tx channel
+ * @param condition tx condition, as SI446X_SEND_SEG
+ * @return SI446X_OK, SI446X_ERR_PARAM if the frame is over VMX_MAX_BUFFER+4
+ *         or source ran dry
+ */
+INT8U SI446X_DEV_SEND_SOURCE( SI446X_DEV *dev, const SI446X_SEG *seg, INT8U count,
+                              SI446X_TX_SOURCE source, void *arg, INT8U length,
+                              INT8U channel, INT8U condition )
+{
+    INT8U chunk[2][SI446X_SOURCE_CHUNK];
+    INT8U cmd[5], status, made, i;
+    INT16U numBytes = length;
+
+    for( i = 0; i < count; i ++ )   { numBytes += seg[i].length; }
+    if( numBytes > VMX_MAX_BUFFER+4 )   { return SI446X_ERR_PARAM; }
+
+    SI446X_LOCK( dev );
+    SI446X_TX_PREPARE( dev, condition );
+
+    SI446X_SELECT( );
+    SI446X_SPI_BYTE( WRITE_TX_FIFO );
 #if PACKET_LENGTH == 0
-    length ++;
-    SPI_ExchangeByte( numBytes );
+    SI446X_SPI_BYTE( numBytes );
 #endif
-    for(i=0; i<numBytes; i++) {
-    	SPI_ExchangeByte( pTxData[i] );
+    for( ; count; count --, seg ++ )
+    {
+        if( seg->length )   { SI446X_SPI_BLOCK( seg->data, NULL, seg->length, NULL ); }
+    }
+    for( i = 0; length; length -= made, i ^= 1 )
+    {
+        made = source( arg, chunk[i] );
+        if( made == 0 )     { break; }
+        if( made > length ) { made = length; }
+        SI446X_SPI_BLOCK( chunk[i], NULL, made, SI446X_SOURCE_SENT );
+    }
+    Si4463_BUS_WAIT( dev->bus );
+    SI446X_DESELECT( );
+    if( length )
+    {
+        SI446X_DEV_TX_FIFO_RESET( dev );
+        SI446X_UNLOCK( dev );
+        return SI446X_ERR_PARAM;
     }
-    SI_CSN_HIGH( );
-    pTxData[numBytes] = 0; //end
 
     cmd[0] = START_TX;
     cmd[1] = channel;
     cmd[2] = condition;
     cmd[3] = 0;
-    cmd[4] = length;
-    SI446X_CMD( cmd, 5 );
+    cmd[4] = numBytes + ( PACKET_LENGTH == 0 );
+    status = SI446X_DEV_CMD( dev, cmd, 5 );
+    SI446X_UNLOCK( dev );
+    return status;
 }
 /*! Sends START_TX command to the radio.
  *
+ * @param dev       the radio
  * @param CHANNEL   Channel number.
  * @param CONDITION Start TX condition.
  * @param TX_LEN    Payload length (exclude the PH generated CRC).
  */
-void SI446X_START_TX( INT8U CHANNEL, INT8U CONDITION, INT16U TX_LEN )
+void SI446X_DEV_START_TX( SI446X_DEV *dev, INT8U CHANNEL, INT8U CONDITION, INT16U TX_LEN )
 {
     INT8U cmd[5];
 
@@ -344,37 +1413,40 @@ void SI446X_START_TX( INT8U CHANNEL, INT8U CONDITION, INT16U TX_LEN )
     cmd[2] = CONDITION;
     cmd[3] = TX_LEN>>8;
     cmd[4] = TX_LEN;
-    SI446X_CMD( cmd, 5 );
+    SI446X_DEV_CMD( dev, cmd, 5 );
 }
 /*
 * read RX fifo
 * @param pRxData  a buffer to store data read
-* @param return received bytes
+* @param return received bytes, 0 for a duplicate when SI446X_DEDUP_ON is used
 */
-INT8U SI446X_READ_PACKET( INT8U *pRxData )
+INT8U SI446X_DEV_READ_PACKET( SI446X_DEV *dev, INT8U *pRxData )
 {
-    INT8U length, i;
-    SI446X_WAIT_CTS( );
+    INT8U length;
+    BOOLEAN duplicate;
+
+    SI446X_LOCK( dev );
+    if( SI446X_DEV_WAIT_CTS( dev ) != SI446X_OK )   { SI446X_UNLOCK( dev ); return 0; }
 
-    SI_CSN_LOW( );
-    SPI_ExchangeByte( READ_RX_FIFO );
+    SI446X_SELECT( );
+    SI446X_SPI_BYTE( READ_RX_FIFO );
 #if PACKET_LENGTH == 0
-    length = SPI_ExchangeByte( 0xFF );
+    length = SI446X_SPI_BYTE( 0xFF );
 #else
     length = PACKET_LENGTH;
 #endif
     if(length > 60) length = 60;
-    for(i=0; i<length; i++) {
-        pRxData[i] = SPI_ExchangeByte( 0xFF );
-    }
-    SI_CSN_HIGH( );
+    duplicate = SI446X_RX_READ( dev, pRxData, length, length );
+    SI446X_DESELECT( );
+    SI446X_UNLOCK( dev );
 
-    return length;
+    return duplicate ? 0 : length;
 }
 
 /*!
  * Sends START_RX command to the radio.
  *
+ * @param dev         the radio
  * @param CHANNEL     Channel number.
  * @param CONDITION   Start RX condition.
  * @param RX_LEN      Payload length (exclude the PH generated CRC).
@@ -382,12 +1454,12 @@ INT8U SI446X_READ_PACKET( INT8U *pRxData )
  * @param NEXT_STATE2 Next state when a valid packet received.
  * @param NEXT_STATE3 Next state when invalid packet received (e.g. CRC error).
  */
-void SI446X_START_RX( INT8U channel, INT8U condition, INT16U rx_len,
-                      INT8U n_state1, INT8U n_state2, INT8U n_state3 )
+void SI446X_DEV_START_RX( SI446X_DEV *dev, INT8U channel, INT8U condition, INT16U rx_len,
+                          INT8U n_state1, INT8U n_state2, INT8U n_state3 )
 {
     INT8U cmd[8];
-    SI446X_RX_FIFO_RESET( );
-    SI446X_TX_FIFO_RESET( );
+
+    SI446X_FIFO_RESET( dev, 0x03 );
     cmd[0] = START_RX;
     cmd[1] = channel;
     cmd[2] = condition;
@@ -396,29 +1468,37 @@ void SI446X_START_RX( INT8U channel, INT8U condition, INT16U rx_len,
     cmd[5] = n_state1;
     cmd[6] = n_state2;
     cmd[7] = n_state3;
-    SI446X_CMD( cmd, 8 );
+    if( SI446X_DEV_CMD( dev, cmd, 8 ) == SI446X_OK )
+    {
+        memcpy( dev->rx_armed.arg, cmd + 1, 7 );
+        dev->rx_armed.valid = BOOL_TRUE;
+    }
 }
 /*
-* reset the RX FIFO of the device
+* reset FIFOs of the device with a single FIFO_INFO
+* @param mask, 0x01 for TX, 0x02 for RX
 */
-void SI446X_RX_FIFO_RESET( void )
+static void SI446X_FIFO_RESET( SI446X_DEV *dev, INT8U mask )
 {
     INT8U cmd[2];
 
     cmd[0] = FIFO_INFO;
-    cmd[1] = 0x02;
-    SI446X_CMD( cmd, 2 );
+    cmd[1] = mask;
+    SI446X_DEV_CMD( dev, cmd, 2 );
+}
+/*
+* reset the RX FIFO of the device
+*/
+void SI446X_DEV_RX_FIFO_RESET( SI446X_DEV *dev )
+{
+    SI446X_FIFO_RESET( dev, 0x02 );
 }
 /*
 * reset the TX FIFO of the device
 */
-void SI446X_TX_FIFO_RESET( void )
+void SI446X_DEV_TX_FIFO_RESET( SI446X_DEV *dev )
 {
-    INT8U cmd[2];
-
-    cmd[0] = FIFO_INFO;
-    cmd[1] = 0x01;
-    SI446X_CMD( cmd, 2 );
+    SI446X_FIFO_RESET( dev, 0x01 );
 }
 /*
 =================================================================================
@@ -434,12 +1514,14 @@ OUTPUT   : NONE
 
 /*!
  * Receives information from the radio of the current packet. Optionally can be used to modify
+ * @param dev           the radio
  * @param pData         Pointer to where to put the data
  * @param FIELD_NUMBER_MASK Packet Field number mask value.
  * @param LEN               Length value.
  * @param DIFF_LEN          Difference length.
  */
-void SI446X_PKT_INFO( INT8U *pData, INT8U FIELD_NUMBER_MASK, INT16U LEN, INT16U DIFF_LEN )
+void SI446X_DEV_PKT_INFO( SI446X_DEV *dev, INT8U *pData, INT8U FIELD_NUMBER_MASK, INT16U LEN,
+                          INT16U DIFF_LEN )
 {
     INT8U cmd[6];
     cmd[0] = PACKET_INFO;
@@ -449,8 +1531,10 @@ void SI446X_PKT_INFO( INT8U *pData, INT8U FIELD_NUMBER_MASK, INT16U LEN, INT16U
     cmd[4] = DIFF_LEN >> 8;
     cmd[5] = DIFF_LEN;
 
-    SI446X_CMD( cmd, 6 );
-    SI446X_READ_RESPONSE( pData, 3 );
+    SI446X_LOCK( dev );
+    SI446X_DEV_CMD( dev, cmd, 6 );
+    SI446X_READ_RESPONSE( dev, pData, 3 );
+    SI446X_UNLOCK( dev );
 }
 /*
 =================================================================================
@@ -463,22 +1547,26 @@ OUTPUT   : NONE
 
 /*!
  * Send the FIFO_INFO command to the radio.  
+ * @param dev           the radio
  * @param pData         Pointer to where to put the data
  */
-void SI446X_FIFO_INFO( INT8U *pData )
+void SI446X_DEV_FIFO_INFO( SI446X_DEV *dev, INT8U *pData )
 {
     INT8U cmd[2];
     cmd[0] = FIFO_INFO;
     cmd[1] = 0x03;
 
-    SI446X_CMD( cmd, 2 );
-    SI446X_READ_RESPONSE( pData, 3);
+    SI446X_LOCK( dev );
+    SI446X_DEV_CMD( dev, cmd, 2 );
+    SI446X_READ_RESPONSE( dev, pData, 3);
+    SI446X_UNLOCK( dev );
 }
 
 /*!
  * Send GPIO pin config command to the radio and reads the answer into
  * @Si446xCmd union.
  *
+ * @param dev         the radio
  * @param GPIO0       GPIO0 configuration.
  * @param GPIO1       GPIO1 configuration.
  * @param GPIO2       GPIO2 configuration.
@@ -487,8 +1575,8 @@ void SI446X_FIFO_INFO( INT8U *pData )
  * @param SDO         SDO configuration.
  * @param GEN_CONFIG  General pin configuration.
  */
-void SI446X_GPIO_CONFIG( INT8U GPIO0, INT8U GPIO1, INT8U GPIO2, INT8U GPIO3,
-                         INT8U IRQ, INT8U SDO, INT8U GEN_CONFIG )
+void SI446X_DEV_GPIO_CONFIG( SI446X_DEV *dev, INT8U GPIO0, INT8U GPIO1, INT8U GPIO2,
+                             INT8U GPIO3, INT8U IRQ, INT8U SDO, INT8U GEN_CONFIG )
 {
     INT8U cmd[10];
     cmd[0] = GPIO_PIN_CFG;
@@ -499,62 +1587,1306 @@ void SI446X_GPIO_CONFIG( INT8U GPIO0, INT8U GPIO1, INT8U GPIO2, INT8U GPIO3,
     cmd[5] = IRQ;
     cmd[6] = SDO;
     cmd[7] = GEN_CONFIG;
-    SI446X_CMD( cmd, 8 );
-    SI446X_READ_RESPONSE( cmd, 8 );
+    SI446X_LOCK( dev );
+    SI446X_DEV_CMD( dev, cmd, 8 );
+    SI446X_READ_RESPONSE( dev, cmd, 8 );
+    SI446X_UNLOCK( dev );
 }
 
 /*!
  * Issue a change state command to the radio.
  *
+ * @param dev         the radio
  * @param NEXT_STATE1 Next state.
  */
-void SI446X_CHANGE_STATE( INT8U NEXT_STATE1 )
+void SI446X_DEV_CHANGE_STATE( SI446X_DEV *dev, INT8U NEXT_STATE1 )
 {
     INT8U cmd[2];
     cmd[0] = CHANGE_STATE;
     cmd[1] = NEXT_STATE1;
-    SI446X_CMD( cmd, 2 );
+    SI446X_DEV_CMD( dev, cmd, 2 );
 }
 
 /*!
- * Requests the current state of the device  
+ * Requests the current state of the device. FRR D holds the state once
+ * SI446X_CONFIG_INIT has run, so no command round trip is needed.
  */
-INT8U SI446X_GET_DEVICE_STATE( void )
+INT8U SI446X_DEV_GET_DEVICE_STATE( SI446X_DEV *dev )
 {
-   INT8U cmd[3];
-   
-   cmd[0] = REQUEST_DEVICE_STATE;
-   SI446X_CMD( cmd, 1 );
-   SI446X_READ_RESPONSE( cmd, 3 );
+   INT8U state;
 
-#if 0
-   UARTprintf("0 %02x\n", cmd[0]);
-   UARTprintf("1 %02x\n", cmd[1]);
-   UARTprintf("2 %02x\n", cmd[2]);
-   UARTFlushTx(0);
-#endif
+   SI446X_SELECT( );
+   SI446X_SPI_BYTE( FRR_D_READ );
+   state = SI446X_SPI_BYTE( 0xFF );
+   SI446X_DESELECT( );
 
-   return cmd[0] & 0x0F;
+   return state & 0x0F;
 }
+/*!
+ * Whether the radio is still on a frame, STATE_TX or STATE_TX_TUNE in FRR D.
+ * Layers sending frames back to back ask before each one and return to the
+ * main loop instead of waiting, so the RX engine is served in between.
+ *
+ * @param dev       the radio
+ * @return BOOL_TRUE while the radio sends
+ */
+BOOLEAN SI446X_DEV_TX_BUSY( SI446X_DEV *dev )
+{
+    INT8U state = SI446X_DEV_GET_DEVICE_STATE( dev );
 
-void SI446X_SET_POWER( INT8U Power_Level )
+    return ( state == STATE_TX || state == STATE_TX_TUNE ) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+void SI446X_DEV_SET_POWER( SI446X_DEV *dev, INT8U Power_Level )
 {
-    SI446X_SET_PROPERTY_1( PA_PWR_LVL, Power_Level );
+    SI446X_DEV_SET_PROPERTY_1( dev, PA_PWR_LVL, Power_Level );
 }
 
-INT8S SI446X_RSSI_INFO(void)
+INT8S SI446X_DEV_RSSI_INFO( SI446X_DEV *dev )
 {
     INT8U rssi;
 
-    SI446X_WAIT_CTS( );
-    SI_CSN_LOW( );
-    SPI_ExchangeByte( 0x50 );
-    rssi = SPI_ExchangeByte( 0xFF );
-    SI_CSN_HIGH( );
+    // FRR C holds the RSSI latched for the last packet, FRRs need no CTS
+    SI446X_SELECT( );
+    SI446X_SPI_BYTE( FRR_C_READ );
+    rssi = SI446X_SPI_BYTE( 0xFF );
+    SI446X_DESELECT( );
 
     //RSSI (in dBm) = (RSSI_value /2) – RSSIcal
     //UARTprintf("RSST %d, %ddBm\n", rssi, rssi/2 - 130); // see datasheet p31 "5.2.4. Received Signal Strength Indicator"
-	return rssi/2 - 130;
+	return SI446X_RSSI_DBM( rssi );
+}
+
+/*!
+ * Read the four fast response registers in one SPI transaction. FRRs are
+ * updated by the radio itself, so there is no CTS wait and no READ_CMD_BUFF.
+ * Reading INT_PH_PEND here does not clear it, GET_INT_STATUS still does.
+ *
+ * @param dev   the radio
+ * @param frr   where to put PH pending, modem pending, latched RSSI and state
+ */
+void SI446X_DEV_FRR_SNAPSHOT( SI446X_DEV *dev, SI446X_FRR *frr )
+{
+    SI446X_SELECT( );
+    SI446X_SPI_BYTE( FRR_A_READ );
+    frr->ph_pend    = SI446X_SPI_BYTE( 0xFF );
+    frr->modem_pend = SI446X_SPI_BYTE( 0xFF );
+    frr->rssi       = SI446X_SPI_BYTE( 0xFF );
+    frr->state      = SI446X_SPI_BYTE( 0xFF );
+    SI446X_DESELECT( );
+}
+
+/*!
+ * Whether auto-ACK answers a packet: sent to this node, not to broadcast, and
+ * of the kind the template asks for. If so the template is made its answer,
+ * with the sender as dst and the sequence byte copied.
+ *
+ * @param dev       the radio
+ * @param data      the packet, from the appkey
+ * @param length    bytes of it read
+ */
+static BOOLEAN SI446X_ACK_MATCH( SI446X_DEV *dev, const INT8U *data, INT8U length )
+{
+    SI446X_ACK_TEMPLATE *tpl = &dev->ack.tpl;
+
+    if( !dev->ack.on || length <= tpl->seq_from || length <= tpl->match_offset ||
+        data[2] != tpl->frame[3] || ( data[tpl->match_offset] & tpl->match_mask ) != tpl->match_value )
+    {
+        return BOOL_FALSE;
+    }
+    tpl->frame[2] = data[3];
+    tpl->frame[tpl->seq_to] = data[tpl->seq_from];
+    return BOOL_TRUE;
+}
+/*!
+ * Send the answer SI446X_ACK_MATCH made from the nIRQ handler, on the channel
+ * the packet came in on; the radio falls back into RX afterwards. Both FIFOs
+ * are reset as in SI446X_SEND_SEG, which loses the head of a frame arriving
+ * behind this one; TX would cut it anyway.
+ *
+ * @param dev       the radio
+ * @param timestamp Si4463_CYCLES( ) when the interrupt was taken
+ */
+static void SI446X_ACK_SEND( SI446X_DEV *dev, INT32U timestamp )
+{
+    SI446X_ACK_TEMPLATE *tpl = &dev->ack.tpl;
+    INT8U cmd[5];
+    INT32U latency;
+    INT8U bin;
+
+    SI446X_FIFO_RESET( dev, 0x03 );
+    dev->rx_length = 0;
+    cmd[0] = START_TX;
+    cmd[1] = dev->rx_armed.arg[0];
+    cmd[2] = STATE_RX << 4;
+    cmd[3] = 0;
+    cmd[4] = SI446X_TX_LOAD( dev, tpl->frame, tpl->length );
+    if( SI446X_DEV_CMD( dev, cmd, 5 ) != SI446X_OK ) { return; }
+
+    latency = Si4463_CYCLES( ) - timestamp;
+    dev->ack.on_air = BOOL_TRUE;
+    dev->ack.stats.acked ++;
+    dev->ack.stats.last = latency;
+    if( latency > dev->ack.stats.max )  { dev->ack.stats.max = latency; }
+    bin = GetMin( SI446X_CYCLES_US( latency ) / SI446X_ACK_BIN_US, SI446X_ACK_BINS - 1 );
+    dev->ack.stats.bin[bin] ++;
+}
+/*!
+ * Bytes read before SI446X_DEDUP_SEEN decides, enough for auto-ACK to answer
+ * a duplicate too
+ */
+static void SI446X_DEDUP_HEADER( SI446X_DEV *dev )
+{
+    const SI446X_DEDUP_RULE *rule = &dev->dedup.rule;
+    INT8U last = GetMax( rule->key_offset, GetMax( rule->seq_offset, rule->match_offset ) );
+
+    if( dev->ack.on )
+    {
+        last = GetMax( last, GetMax( dev->ack.tpl.seq_from, dev->ack.tpl.match_offset ) );
+    }
+    dev->dedup.header = last + 1;
+}
+/*!
+ * Whether a packet was received from its source before, by the sequence
+ * number window of the source; it is marked received if not. A number more
+ * than SI446X_DEDUP_WINDOW behind the newest one is taken as a restart of
+ * the source, not as a duplicate.
+ *
+ * @param dev       the radio
+ * @param data      the packet, from the appkey, SI446X_DEDUP_HEADER bytes
+ */
+static BOOLEAN SI446X_DEDUP_SEEN( SI446X_DEV *dev, const INT8U *data )
+{
+    const SI446X_DEDUP_RULE *rule = &dev->dedup.rule;
+    INT8U src = data[rule->key_offset], seq = data[rule->seq_offset];
+    INT32U *seen = &dev->dedup.seen[src];
+    INT8S ahead = ( INT8S )( seq - dev->dedup.top[src] );
+
+    if( ( data[rule->match_offset] & rule->match_mask ) != rule->match_value ||
+        ( rule->address != 0 && data[2] != rule->address ) )
+    {
+        return BOOL_FALSE;
+    }
+    if( *seen == 0 || ahead > 0 || -ahead >= SI446X_DEDUP_WINDOW )
+    {
+        if( *seen && ahead <= 0 )   { dev->rx_stats.seq_restarts ++; }
+        *seen = ( *seen && ahead > 0 && ahead < SI446X_DEDUP_WINDOW ) ? *seen << ahead | 1 : 1;
+        dev->dedup.top[src] = seq;
+        return BOOL_FALSE;
+    }
+    if( *seen & ( 1UL << -ahead ) )
+    {
+        dev->rx_stats.duplicates ++;
+        return BOOL_TRUE;
+    }
+    *seen |= 1UL << -ahead;
+    return BOOL_FALSE;
+}
+/*!
+ * Read a packet out of the RX FIFO, in a READ_RX_FIFO window. With duplicate
+ * suppression on, its header is read first; a duplicate is not copied
+ * further, the rest is clocked out and dropped.
+ *
+ * @param dev       the radio
+ * @param buffer    where the packet goes
+ * @param keep      bytes of it to keep
+ * @param length    bytes of it in the FIFO
+ * @return BOOL_TRUE for a duplicate, only SI446X_DEDUP_HEADER bytes are in buffer
+ */
+static BOOLEAN SI446X_RX_READ( SI446X_DEV *dev, INT8U *buffer, INT8U keep, INT8U length )
+{
+    BOOLEAN duplicate = BOOL_FALSE;
+    INT8U got = 0;
+
+    if( dev->dedup.on && keep >= dev->dedup.header )
+    {
+        got = dev->dedup.header;
+        SI446X_SPI_BLOCK( NULL, buffer, got, NULL );
+        duplicate = SI446X_DEDUP_SEEN( dev, buffer );
+        if( duplicate ) { keep = got; }
+    }
+    if( keep > got )    { SI446X_SPI_BLOCK( NULL, buffer + got, keep - got, NULL ); }
+    if( length > keep ) { SI446X_SPI_BLOCK( NULL, NULL, length - keep, NULL ); }
+    return duplicate;
+}
+/*!
+ * Number of bytes waiting in the RX FIFO
+ */
+static INT8U SI446X_RX_FIFO_COUNT( SI446X_DEV *dev )
+{
+    INT8U cmd[2];
+
+    cmd[0] = FIFO_INFO;
+    cmd[1] = 0x00;
+    SI446X_LOCK( dev );
+    SI446X_DEV_CMD( dev, cmd, 2 );
+    SI446X_READ_RESPONSE( dev, cmd, 2 );
+    SI446X_UNLOCK( dev );
+    return cmd[0];
+}
+/*!
+ * Move every complete packet waiting in the RX FIFO into the RX ring. With
+ * the radio re-armed after each packet, the FIFO may also hold the head of
+ * the next one; its length byte is consumed and remembered, the rest is
+ * taken on its own PACKET_RX. A packet which finds the ring full is read out
+ * and dropped, so the FIFO stays in frame. A duplicate does not take a slot,
+ * but auto-ACK answers it again: the first answer was lost.
+ *
+ * START_RX re-arms the receiver by itself after a CRC error, but the bytes of
+ * the bad frame stay in the RX FIFO, ahead of the next good one. With
+ * CRC_ERROR latched, every complete packet but the one PACKET_RX was raised
+ * for, the last, is dropped; all of them without PACKET_RX.
+ *
+ * @param dev       the radio
+ * @param timestamp Si4463_CYCLES( ) when the interrupt was taken
+ * @param pend      PH_PEND latched since the last drain
+ * @return BOOL_TRUE if auto-ACK has a packet to answer
+ */
+static BOOLEAN SI446X_RX_DRAIN( SI446X_DEV *dev, INT32U timestamp, INT8U pend )
+{
+    SI446X_RX_SLOT *slot;
+    BOOLEAN answer = BOOL_FALSE, duplicate = BOOL_FALSE;
+    BOOLEAN bad = ( pend & PH_CRC_ERROR ) ? BOOL_TRUE : BOOL_FALSE;
+    INT8U count, keep, head;
+    INT8S rssi = SI446X_DEV_RSSI_INFO( dev );
+
+    count = SI446X_RX_FIFO_COUNT( dev );
+    while( count )
+    {
+        if( dev->rx_length == 0 )
+        {
+#if PACKET_LENGTH == 0
+            SI446X_R_RX_FIFO( dev, &dev->rx_length, 1 );
+            count --;
+            if( dev->rx_length == 0 )    { continue; }
+#else
+            dev->rx_length = PACKET_LENGTH;
+#endif
+        }
+        if( count < dev->rx_length ) { break; }
+
+        head = dev->rx_ring.head;
+        slot = NULL;
+        if( ( INT8U )( head - dev->rx_ring.tail ) < SI446X_RX_RING_SIZE )
+        {
+            slot = &dev->rx_ring.slot[head & ( SI446X_RX_RING_SIZE - 1 )];
+        }
+
+        keep = slot ? GetMin( dev->rx_length, SI446X_RX_SLOT_SIZE ) : 0;
+        SI446X_SELECT( );
+        SI446X_SPI_BYTE( READ_RX_FIFO );
+        if( bad )
+        {
+            // Maybe a bad one: its header must not reach duplicate suppression yet
+            if( keep )  { SI446X_SPI_BLOCK( NULL, slot->data, keep, NULL ); }
+            if( dev->rx_length > keep )
+            {
+                SI446X_SPI_BLOCK( NULL, NULL, dev->rx_length - keep, NULL );
+            }
+        }
+        else if( slot ) { duplicate = SI446X_RX_READ( dev, slot->data, keep, dev->rx_length ); }
+        else            { SI446X_SPI_BLOCK( NULL, NULL, dev->rx_length, NULL ); }
+        SI446X_DESELECT( );
+        count -= dev->rx_length;
+        dev->rx_length = 0;
+
+        if( bad )
+        {
+            // The length of the next packet tells whether this one is the last
+#if PACKET_LENGTH == 0
+            if( count )
+            {
+                SI446X_R_RX_FIFO( dev, &dev->rx_length, 1 );
+                count --;
+            }
+#else
+            if( count ) { dev->rx_length = PACKET_LENGTH; }
+#endif
+            if( !( pend & PH_PACKET_RX ) || ( dev->rx_length && count >= dev->rx_length ) )
+            {
+                dev->rx_stats.crc_errors ++;
+                continue;
+            }
+            bad = BOOL_FALSE;
+            duplicate = slot && dev->dedup.on && keep >= dev->dedup.header &&
+                        SI446X_DEDUP_SEEN( dev, slot->data );
+        }
+        if( duplicate )
+        {
+            if( SI446X_ACK_MATCH( dev, slot->data, dev->dedup.header ) )
+            {
+                if( answer )    { dev->ack.stats.skipped ++; }
+                answer = BOOL_TRUE;
+            }
+        }
+        else if( slot )
+        {
+            slot->timestamp = timestamp;
+            slot->length = keep;
+            slot->rssi = rssi;
+            dev->rx_ring.head = head + 1;    //publish after the slot is complete
+            dev->rx_stats.packets ++;
+            if( SI446X_ACK_MATCH( dev, slot->data, keep ) )
+            {
+                if( answer )    { dev->ack.stats.skipped ++; }
+                answer = BOOL_TRUE;
+            }
+        }
+        else
+        {
+            dev->rx_stats.dropped ++;
+        }
+    }
+    return answer;
+}
+/*!
+ * A frame overflowed the RX FIFO, e.g. one which did not fit behind a bad
+ * frame waiting for the next PACKET_RX. Its bytes are cut, so the FIFO is out
+ * of frame: it is flushed once the complete packets ahead are drained, and a
+ * receiver still on the frame is re-armed to hunt for the next one.
+ *
+ * @param dev       the radio
+ */
+static void SI446X_RX_OVERFLOW( SI446X_DEV *dev )
+{
+    SI446X_FIFO_RESET( dev, 0x02 );
+    dev->rx_length = 0;
+    dev->rx_stats.dropped ++;
+    if( dev->rx_armed.valid && SI446X_DEV_GET_DEVICE_STATE( dev ) == STATE_RX )
+    {
+        SI446X_DEV_START_RX( dev, dev->rx_armed.arg[0], dev->rx_armed.arg[1],
+                         ( INT16U )dev->rx_armed.arg[2] << 8 | dev->rx_armed.arg[3],
+                         dev->rx_armed.arg[4], dev->rx_armed.arg[5], dev->rx_armed.arg[6] );
+    }
+}
+/*!
+ * nIRQ handler of the RX engine. Reading the interrupt status clears all
+ * pending interrupts, which releases nIRQ for the next edge. It works on its
+ * own radio. CRC_ERROR raises no nIRQ; it is read here along with the others
+ * and the bad frame dropped by SI446X_RX_DRAIN. An RX FIFO overflow does.
+ */
+static void SI446X_IRQ_HANDLER( void *arg )
+{
+    INT8U status[9];
+    INT32U timestamp = Si4463_CYCLES( );
+    SI446X_DEV *dev = ( SI446X_DEV * )arg;
+
+    dev->rx_stats.irqs ++;
+    SI446X_DEV_INT_STATUS( dev, status );
+
+    if( status[2] & ( PH_PACKET_RX | PH_CRC_ERROR ) )
+    {
+        if( SI446X_RX_DRAIN( dev, timestamp, status[2] ) ) { SI446X_ACK_SEND( dev, timestamp ); }
+    }
+    if( status[6] & CHIP_FIFO_UNDERFLOW_OVERFLOW_ERROR )    { SI446X_RX_OVERFLOW( dev ); }
+    if( status[2] & PH_PACKET_SENT )
+    {
+        if( dev->ack.on_air )   { dev->ack.on_air = BOOL_FALSE; }
+        else                    { dev->rx_tx_done = BOOL_TRUE; }
+    }
+}
+/*!
+ * Start receiving into the RX ring. The radio goes back to RX by itself after
+ * every packet, and the nIRQ handler moves each one into the ring, so packets
+ * arriving back to back are kept while the main loop is busy.
+ *
+ * @param dev       the radio
+ * @param channel   rx channel
+ */
+void SI446X_DEV_RX_ENGINE_START( SI446X_DEV *dev, INT8U channel )
+{
+    INT8U status[9];
+
+    Si4463_BUS_IRQ_INIT( dev->bus, SI446X_IRQ_HANDLER, dev );
+    SI446X_LOCK( dev );
+    dev->rx_length = 0;
+    dev->ack.on_air = BOOL_FALSE;
+    SI446X_DEV_INT_STATUS( dev, status );
+    SI446X_DEV_START_RX( dev, channel, 0, 0, STATE_RX, STATE_RX, STATE_RX );
+    SI446X_UNLOCK( dev );
+}
+/*!
+ * Stop the RX engine. Packets already in the ring can still be consumed.
+ */
+void SI446X_DEV_RX_ENGINE_STOP( SI446X_DEV *dev )
+{
+    Si4463_BUS_IRQ_INIT( dev->bus, NULL, NULL );
+    SI446X_DEV_CHANGE_STATE( dev, STATE_READY );
+}
+/*!
+ * Oldest packet in the RX ring. Only the main loop may call this.
+ *
+ * @return the packet, valid until SI446X_RX_RELEASE, or NULL if the ring is empty
+ */
+const SI446X_RX_SLOT *SI446X_DEV_RX_PEEK( SI446X_DEV *dev )
+{
+    INT8U tail = dev->rx_ring.tail;
+
+    if( tail == dev->rx_ring.head )  { return NULL; }
+    return &dev->rx_ring.slot[tail & ( SI446X_RX_RING_SIZE - 1 )];
+}
+/*!
+ * Release the packet returned by SI446X_RX_PEEK, its slot can be refilled.
+ */
+void SI446X_DEV_RX_RELEASE( SI446X_DEV *dev )
+{
+    if( dev->rx_ring.tail != dev->rx_ring.head )  { dev->rx_ring.tail ++; }
+}
+/*!
+ * Report PACKET_SENT seen by the nIRQ handler, which clears it on the radio.
+ *
+ * @return BOOL_TRUE once per packet sent
+ */
+BOOLEAN SI446X_DEV_RX_ENGINE_TX_DONE( SI446X_DEV *dev )
+{
+    BOOLEAN done;
+
+    SI446X_LOCK( dev );
+    done = dev->rx_tx_done;
+    dev->rx_tx_done = BOOL_FALSE;
+    SI446X_UNLOCK( dev );
+    return done;
+}
+/*!
+ * Read the RX engine statistics
+ */
+const SI446X_RX_STATS *SI446X_DEV_RX_STATS_GET( SI446X_DEV *dev )
+{
+    return &dev->rx_stats;
+}
+/*!
+ * Have the nIRQ handler answer every frame sent to the template's src address
+ * by itself, as soon as the frame is in the RX ring, without waiting for the
+ * main loop. Frames to broadcast, frames which find the ring full and frames
+ * failing the template's match are not answered. The radio is in TX for the
+ * ACK's air time after a frame is answered; a sender in the main loop checks
+ * the state first, as it does after its own frames.
+ *
+ * @param dev       the radio
+ * @param ack       the template, copied
+ * @return SI446X_OK, SI446X_ERR_PARAM if an offset is outside the frames
+ */
+INT8U SI446X_DEV_AUTO_ACK_ON( SI446X_DEV *dev, const SI446X_ACK_TEMPLATE *ack )
+{
+    if( ack->length < 4 || ack->length > SI446X_ACK_MAX || ack->seq_to >= ack->length ||
+        ack->seq_from >= SI446X_RX_SLOT_SIZE || ack->match_offset >= SI446X_RX_SLOT_SIZE )
+    {
+        return SI446X_ERR_PARAM;
+    }
+    SI446X_LOCK( dev );
+    dev->ack.tpl = *ack;
+    dev->ack.on = BOOL_TRUE;
+    SI446X_DEDUP_HEADER( dev );
+    SI446X_UNLOCK( dev );
+    return SI446X_OK;
+}
+/*!
+ * Stop answering frames. An ACK already on air still completes.
+ */
+void SI446X_DEV_AUTO_ACK_OFF( SI446X_DEV *dev )
+{
+    SI446X_LOCK( dev );
+    dev->ack.on = BOOL_FALSE;
+    SI446X_DEDUP_HEADER( dev );
+    SI446X_UNLOCK( dev );
+}
+/*!
+ * Drop packets received before, in the RX engine and SI446X_READ_PACKET,
+ * before they are copied out of the radio: only their header is read. Every
+ * source, by its byte at key_offset, has a window of the last
+ * SI446X_DEDUP_WINDOW sequence numbers; a late packet inside it is still
+ * delivered once. The windows start empty. Dropped packets count in
+ * SI446X_RX_STATS.duplicates.
+ *
+ * @param dev       the radio
+ * @param rule      the source and sequence bytes and the packets checked, copied
+ * @return SI446X_OK, SI446X_ERR_PARAM if an offset is outside a slot
+ */
+INT8U SI446X_DEV_DEDUP_ON( SI446X_DEV *dev, const SI446X_DEDUP_RULE *rule )
+{
+    if( rule->seq_offset >= SI446X_RX_SLOT_SIZE || rule->match_offset >= SI446X_RX_SLOT_SIZE ||
+        rule->key_offset >= SI446X_RX_SLOT_SIZE )
+    {
+        return SI446X_ERR_PARAM;
+    }
+    SI446X_LOCK( dev );
+    dev->dedup.rule = *rule;
+    memset( dev->dedup.seen, 0, sizeof( dev->dedup.seen ) );
+    dev->dedup.on = BOOL_TRUE;
+    SI446X_DEDUP_HEADER( dev );
+    SI446X_UNLOCK( dev );
+    return SI446X_OK;
+}
+/*!
+ * Deliver every packet again
+ */
+void SI446X_DEV_DEDUP_OFF( SI446X_DEV *dev )
+{
+    SI446X_LOCK( dev );
+    dev->dedup.on = BOOL_FALSE;
+    SI446X_UNLOCK( dev );
+}
+/*!
+ * Forget the sequence numbers of one source, e.g. after it rejoined
+ *
+ * @param dev       the radio
+ * @param src       its address
+ */
+void SI446X_DEV_DEDUP_FORGET( SI446X_DEV *dev, INT8U src )
+{
+    SI446X_LOCK( dev );
+    dev->dedup.seen[src] = 0;
+    SI446X_UNLOCK( dev );
+}
+/*!
+ * Take a packet of the RX ring back out of the window of its source, for a
+ * layer above which had no room for it: the copy its sender sends again is
+ * delivered, not dropped as a duplicate.
+ *
+ * @param dev       the radio
+ * @param data      the packet, SI446X_RX_SLOT.data
+ */
+void SI446X_DEV_DEDUP_UNMARK( SI446X_DEV *dev, const INT8U *data )
+{
+    const SI446X_DEDUP_RULE *rule = &dev->dedup.rule;
+    INT8U src = data[rule->key_offset];
+    INT8S ahead;
+
+    SI446X_LOCK( dev );
+    ahead = ( INT8S )( data[rule->seq_offset] - dev->dedup.top[src] );
+    if( dev->dedup.on && ( data[rule->match_offset] & rule->match_mask ) == rule->match_value &&
+        ( rule->address == 0 || data[2] == rule->address ) && ahead <= 0 && -ahead < SI446X_DEDUP_WINDOW )
+    {
+        dev->dedup.seen[src] &= ~( 1UL << -ahead );
+    }
+    SI446X_UNLOCK( dev );
+}
+/*!
+ * Read the auto-ACK statistics
+ */
+const SI446X_ACK_STATS *SI446X_DEV_AUTO_ACK_STATS_GET( SI446X_DEV *dev )
+{
+    return &dev->ack.stats;
+}
+/*!
+ * Clear packet handler pending interrupts. The response is not needed, so
+ * READ_CMD_BUFF is skipped; the next command overwrites it.
+ *
+ * @param dev   the radio
+ * @param mask  SI446X_PH_INT bits to clear
+ */
+static void SI446X_PH_CLEAR( SI446X_DEV *dev, INT8U mask )
+{
+    INT8U cmd[2];
+
+    cmd[0] = GET_PH_STATUS;
+    cmd[1] = ~mask;
+    SI446X_DEV_CMD( dev, cmd, 2 );
+}
+/*!
+ * Sleep until the stream handler has seen one of the events. The nIRQ
+ * handler is free meanwhile, so the wait costs no SPI traffic.
+ *
+ * @param dev         the radio
+ * @param mask        PH_PACKET_SENT and/or PH_PACKET_RX
+ * @param timeout_us  how long to wait for the first FIFO event; between
+ *                    events it is SI446X_STREAM_TIMEOUT_US
+ * @return the events of mask which were seen, 0 on timeout
+ */
+static INT8U SI446X_STREAM_WAIT( SI446X_DEV *dev, INT8U mask, INT32U timeout_us )
+{
+    INT32U start = Si4463_CYCLES( );
+    INT16U done = dev->stream.done;
+
+    while( !( dev->stream.events & mask ) )
+    {
+        if( dev->stream.done != done )
+        {
+            done = dev->stream.done;
+            start = Si4463_CYCLES( );
+            timeout_us = SI446X_STREAM_TIMEOUT_US;
+        }
+        else if( Si4463_CYCLES( ) - start >= SI446X_US_CYCLES( timeout_us ) )
+        {
+            return 0;
+        }
+        Si4463_BUS_IRQ_IDLE( dev->bus, &dev->stream.events );
+    }
+    return dev->stream.events & mask;
+}
+/*!
+ * nIRQ handler while a stream frame is on air. TX FIFO almost empty refills
+ * the FIFO and RX FIFO almost full drains it, SI446X_STREAM_THRESHOLD bytes
+ * at a time; after PACKET_RX the whole tail is read. PACKET_SENT and
+ * PACKET_RX are left to SI446X_STREAM_WAIT.
+ *
+ * @param arg       the radio
+ */
+static void SI446X_STREAM_HANDLER( void *arg )
+{
+    SI446X_DEV *dev = ( SI446X_DEV * )arg;
+    INT8U status[9], head[2];
+    INT16U total, chunk, keep, at;
+
+    SI446X_DEV_INT_STATUS( dev, status );
+    if( dev->stream.tx )
+    {
+        total = dev->stream.length + 2;
+        if( ( status[2] & PH_TX_FIFO_ALMOST_EMPTY ) && dev->stream.done < total )
+        {
+            // Reading the status cleared the event, the refill latches the next
+            chunk = GetMin( total - dev->stream.done, SI446X_STREAM_THRESHOLD );
+            SI446X_SELECT( );
+            SI446X_SPI_BYTE( WRITE_TX_FIFO );
+            SI446X_SPI_BLOCK( dev->stream.tx + dev->stream.done - 2, NULL, chunk, NULL );
+            SI446X_DESELECT( );
+            dev->stream.done += chunk;
+        }
+    }
+    else if( dev->stream.rx && ( status[2] & ( PH_RX_FIFO_ALMOST_FULL | PH_PACKET_RX ) ) )
+    {
+        // An almost full event guarantees a threshold worth in the FIFO,
+        // after PACKET_RX the whole tail is there
+        chunk = SI446X_STREAM_THRESHOLD;
+        if( dev->stream.done == 0 )
+        {
+            SI446X_R_RX_FIFO( dev, head, 2 );
+            dev->stream.length = ( ( INT16U )head[0] << 8 ) | head[1];
+            if( dev->stream.length > SI446X_STREAM_MAX_LEN )
+            {
+                dev->stream.length = SI446X_STREAM_MAX_LEN;
+            }
+            dev->stream.done = 2;
+            chunk -= 2;
+        }
+        total = dev->stream.length + 2;
+        if( status[2] & PH_PACKET_RX )  { chunk = total - dev->stream.done; }
+        else                            { chunk = GetMin( total - dev->stream.done, chunk ); }
+
+        at = dev->stream.done - 2;
+        keep = ( at < dev->stream.size ) ? GetMin( chunk, dev->stream.size - at ) : 0;
+        if( keep )          { SI446X_R_RX_FIFO( dev, dev->stream.rx + at, keep ); }
+        if( chunk > keep )  { SI446X_R_RX_FIFO( dev, NULL, chunk - keep ); }
+        dev->stream.done += chunk;
+    }
+    dev->stream.events |= status[2] & ( PH_PACKET_SENT | PH_PACKET_RX );
+}
+/*!
+ * Hand nIRQ to the stream handler for one frame. It has no frame to move
+ * until the caller sets stream.tx or stream.rx with the radio locked.
+ *
+ * @param dev       the radio
+ */
+static void SI446X_STREAM_BEGIN( SI446X_DEV *dev )
+{
+    dev->stream.tx = NULL;
+    dev->stream.rx = NULL;
+    dev->stream.done = 0;
+    dev->stream.events = 0;
+    dev->stream.callback = dev->bus->irq_callback;
+    dev->stream.arg = dev->bus->irq_arg;
+    Si4463_BUS_IRQ_INIT( dev->bus, SI446X_STREAM_HANDLER, dev );
+}
+/*!
+ * Give nIRQ back to the handler it had before SI446X_STREAM_BEGIN
+ *
+ * @param dev       the radio
+ */
+static void SI446X_STREAM_END( SI446X_DEV *dev )
+{
+    SI446X_LOCK( dev );
+    dev->stream.tx = NULL;
+    dev->stream.rx = NULL;
+    SI446X_UNLOCK( dev );
+    Si4463_BUS_IRQ_INIT( dev->bus, dev->stream.callback, dev->stream.arg );
+}
+/*!
+ * Read bytes from the RX FIFO
+ *
+ * @param dev       the radio
+ * @param pRxData   where to put the data, NULL drops them
+ * @param numBytes  how many bytes to read
+ */
+static void SI446X_R_RX_FIFO( SI446X_DEV *dev, INT8U *pRxData, INT16U numBytes )
+{
+    SI446X_SELECT( );
+    SI446X_SPI_BYTE( READ_RX_FIFO );
+    SI446X_SPI_BLOCK( NULL, pRxData, numBytes, NULL );
+    SI446X_DESELECT( );
+}
+/*!
+ * Switch the packet handler between normal frames (1 byte length, one FIFO
+ * worth of payload) and stream frames (2 byte length, up to
+ * SI446X_STREAM_MAX_LEN bytes). Both ends of a link must use the same mode.
+ * In stream mode the FIFO almost empty/full events raise nIRQ too, for the
+ * handler SI446X_STREAM_SEND and SI446X_STREAM_READ install.
+ *
+ * @param dev       the radio
+ * @param enable    BOOL_TRUE for stream frames
+ */
+void SI446X_DEV_STREAM_MODE( SI446X_DEV *dev, BOOLEAN enable )
+{
+    SI446X_PROP_BATCH batch;
+
+    SI446X_PROP_BATCH_INIT( &batch );
+    if( enable )
+    {
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_LEN, 0x3A );     //2 byte length in FIFO
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_1_LENGTH_7_0, 0x02 );
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_2_LENGTH_12_8, SI446X_STREAM_MAX_LEN >> 8 );
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_2_LENGTH_7_0, SI446X_STREAM_MAX_LEN & 0xFF );
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_TX_THRESHOLD, SI446X_STREAM_THRESHOLD );
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_RX_THRESHOLD, SI446X_STREAM_THRESHOLD );
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, INT_CTL_PH_ENABLE, PH_PACKET_SENT | PH_PACKET_RX |
+                                   PH_TX_FIFO_ALMOST_EMPTY | PH_RX_FIFO_ALMOST_FULL );
+        dev->filter.offset = SI446X_DST_OFFSET + 1;
+    }
+    else
+    {
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_LEN, 0x2A );
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_1_LENGTH_7_0, 0x01 );
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_2_LENGTH_12_8, 0x00 );
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, PKT_FIELD_2_LENGTH_7_0, 0x20 );
+        SI446X_DEV_PROP_BATCH_ADD( dev, &batch, INT_CTL_PH_ENABLE, PH_PACKET_SENT | PH_PACKET_RX );
+        dev->filter.offset = SI446X_DST_OFFSET;
+    }
+    SI446X_FILTER_ADD( dev, &batch );
+    SI446X_DEV_PROP_BATCH_FLUSH( dev, &batch );
+}
+/*!
+ * Add the destination filter to a batch. Match 1 takes the node address,
+ * match 2 is ORed with it for broadcast, both on the same byte.
+ *
+ * @param dev       the radio
+ * @param batch     the batch to add the writes to
+ */
+static void SI446X_FILTER_ADD( SI446X_DEV *dev, SI446X_PROP_BATCH *batch )
+{
+    if( !dev->filter.on )
+    {
+        SI446X_DEV_PROP_BATCH_ADD( dev, batch, MATCH_CTRL_1, 0x00 );
+        return;
+    }
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, MATCH_VALUE_1, dev->filter.address );
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, MATCH_MASK_1, 0xFF );
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, MATCH_CTRL_1, 0x80 | dev->filter.offset );    //MATCH_EN
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, MATCH_VALUE_2, dev->filter.broadcast );
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, MATCH_MASK_2, 0xFF );
+    SI446X_DEV_PROP_BATCH_ADD( dev, batch, MATCH_CTRL_2, 0x80 | dev->filter.offset );    //OR
+}
+/*!
+ * Have the packet handler drop frames sent to other nodes. The check is made
+ * as the destination byte arrives; a frame which fails it raises no nIRQ and
+ * is not read over SPI. Frames to address or to broadcast are received.
+ *
+ * @param dev       the radio
+ * @param address   address of this node
+ * @param broadcast address every node receives
+ */
+void SI446X_DEV_ADDRESS_FILTER( SI446X_DEV *dev, INT8U address, INT8U broadcast )
+{
+    SI446X_PROP_BATCH batch;
+
+    dev->filter.on = BOOL_TRUE;
+    dev->filter.address = address;
+    dev->filter.broadcast = broadcast;
+    SI446X_PROP_BATCH_INIT( &batch );
+    SI446X_FILTER_ADD( dev, &batch );
+    SI446X_DEV_PROP_BATCH_FLUSH( dev, &batch );
+}
+/*!
+ * Receive every frame again
+ */
+void SI446X_DEV_ADDRESS_FILTER_OFF( SI446X_DEV *dev )
+{
+    SI446X_PROP_BATCH batch;
+
+    dev->filter.on = BOOL_FALSE;
+    SI446X_PROP_BATCH_INIT( &batch );
+    SI446X_FILTER_ADD( dev, &batch );
+    SI446X_DEV_PROP_BATCH_FLUSH( dev, &batch );
+}
+/*!
+ * Send a stream frame. The first FIFO worth is loaded before START_TX, the
+ * nIRQ handler feeds the rest in SI446X_STREAM_THRESHOLD chunks on every TX
+ * FIFO almost empty event while the packet is on air, and the caller sleeps
+ * until PACKET_SENT. Not for handler mode, where nIRQ cannot preempt.
+ *
+ * @param dev       the radio
+ * @param pTxData   payload, not modified
+ * @param numBytes  payload length, up to SI446X_STREAM_MAX_LEN
+ * @param channel   tx channel
+ * @param condition tx condition
+ * @return SI446X_OK once sent, or SI446X_ERR_TIMEOUT if the FIFO stopped draining
+ */
+INT8U SI446X_DEV_STREAM_SEND( SI446X_DEV *dev, const INT8U *pTxData, INT16U numBytes,
+                              INT8U channel, INT8U condition )
+{
+    INT8U status[9], result;
+    INT16U chunk;
+
+    if( numBytes > SI446X_STREAM_MAX_LEN )  { numBytes = SI446X_STREAM_MAX_LEN; }
+
+    SI446X_STREAM_BEGIN( dev );
+    SI446X_LOCK( dev );
+    SI446X_DEV_TX_FIFO_RESET( dev );
+
+    chunk = GetMin( numBytes, SI446X_FIFO_SIZE - 2 );
+    SI446X_SELECT( );
+    SI446X_SPI_BYTE( WRITE_TX_FIFO );
+    SI446X_SPI_BYTE( numBytes >> 8 );
+    SI446X_SPI_BYTE( numBytes );
+    SI446X_SPI_BLOCK( pTxData, NULL, chunk, NULL );
+    SI446X_DESELECT( );
+
+    dev->stream.tx = pTxData;
+    dev->stream.length = numBytes;
+    dev->stream.done = chunk + 2;
+    // Release nIRQ, a stale event would hold it low and hide the next edge
+    SI446X_DEV_INT_STATUS( dev, status );
+    SI446X_DEV_START_TX( dev, channel, condition, numBytes + 2 );
+    SI446X_UNLOCK( dev );
+
+    result = SI446X_STREAM_WAIT( dev, PH_PACKET_SENT, SI446X_STREAM_TIMEOUT_US ) ?
+             SI446X_OK : SI446X_ERR_TIMEOUT;
+    SI446X_STREAM_END( dev );
+    return result;
+}
+/*!
+ * Receive a stream frame. RX must already be started. The nIRQ handler
+ * drains the FIFO in SI446X_STREAM_THRESHOLD chunks on every RX FIFO almost
+ * full event and the tail on PACKET_RX, while the caller sleeps until
+ * PACKET_RX. Not for handler mode, where nIRQ cannot preempt.
+ *
+ * @param dev         the radio
+ * @param pRxData     where to put the payload
+ * @param maxBytes    size of pRxData, longer payloads are truncated
+ * @param timeout_us  how long to wait for the packet to start
+ * @return payload length, 0 on timeout
+ */
+INT16U SI446X_DEV_STREAM_READ( SI446X_DEV *dev, INT8U *pRxData, INT16U maxBytes,
+                               INT32U timeout_us )
+{
+    INT16U length = 0;
+
+    SI446X_STREAM_BEGIN( dev );
+    SI446X_LOCK( dev );
+    dev->stream.rx = pRxData;
+    dev->stream.size = maxBytes;
+    // Take what arrived before the call, which also releases nIRQ
+    SI446X_STREAM_HANDLER( dev );
+    SI446X_UNLOCK( dev );
+
+    if( SI446X_STREAM_WAIT( dev, PH_PACKET_RX, timeout_us ) )
+    {
+        length = GetMin( dev->stream.length, maxBytes );
+    }
+    else if( dev->stream.done )
+    {
+        SI446X_DEV_RX_FIFO_RESET( dev );
+    }
+    SI446X_STREAM_END( dev );
+    return length;
+}
+/*!
+ * Precompute the RX_HOP arguments for a list of channels. The synthesizer
+ * values are derived from the FREQ_CONTROL properties the radio holds, as
+ * RF_FREQ_CONTROL_INTE_8 programmed them:
+ *   N = INTE * 2^19 + FRAC + channel * CHANNEL_STEP_SIZE
+ * with FRAC normalized back into [2^19, 2^20) and INTE = N / 2^19 - 1. The
+ * VCO calibration target is the prescaled (/4) VCO count over W_SIZE
+ * crystal cycles, N * W_SIZE / 2^20, plus the signed VCOCNT_RX_ADJ.
+ *
+ * @param dev       the radio
+ * @param table     the table to fill
+ * @param channels  channel numbers, in hopping order
+ * @param count     number of channels, up to SI446X_HOP_MAX
+ */
+void SI446X_DEV_HOP_TABLE_INIT( SI446X_DEV *dev, SI446X_HOP_TABLE *table,
+                                const INT8U *channels, INT8U count )
+{
+    INT8U freq[8], i;
+    INT32U base, n, vco;
+    INT16U step;
+
+    SI446X_DEV_GET_PROPERTY_X( dev, FREQ_CONTROL_INTE, 8, freq );
+    base = ( ( INT32U )freq[0] << 19 ) + ( ( INT32U )freq[1] << 16 ) +
+           ( ( INT32U )freq[2] << 8 ) + freq[3];
+    step = ( ( INT16U )freq[4] << 8 ) | freq[5];
+
+    table->count = GetMin( count, SI446X_HOP_MAX );
+    table->index = 0;
+    for( i = 0; i < table->count; i ++ )
+    {
+        n = base + ( INT32U )channels[i] * step;
+        vco = ( INT32U )( ( ( INT64U )n * freq[6] ) >> 20 ) + ( INT8S )freq[7];
+
+        table->entry[i].channel = channels[i];
+        table->entry[i].arg[0] = ( n >> 19 ) - 1;
+        table->entry[i].arg[1] = ( ( n >> 16 ) & 0x07 ) | 0x08;   //FRAC bit 19 set
+        table->entry[i].arg[2] = n >> 8;
+        table->entry[i].arg[3] = n;
+        table->entry[i].arg[4] = vco >> 8;
+        table->entry[i].arg[5] = vco;
+    }
+}
+/*!
+ * Retune the receiver to an entry of a hop table. The radio must already be
+ * in RX; the FIFOs and the packet handler are left alone.
+ *
+ * @param dev       the radio
+ * @param table     the table
+ * @param index     entry to hop to
+ * @return SI446X_OK or the error of the command
+ */
+INT8U SI446X_DEV_RX_HOP( SI446X_DEV *dev, SI446X_HOP_TABLE *table, INT8U index )
+{
+    INT8U cmd[7];
+
+    if( index >= table->count ) { return SI446X_ERR_PARAM; }
+
+    cmd[0] = RX_HOP;
+    memcpy( cmd + 1, table->entry[index].arg, 6 );
+    table->index = index;
+    dev->rx_armed.arg[0] = table->entry[index].channel;
+    return SI446X_DEV_CMD( dev, cmd, 7 );
+}
+/*!
+ * Hop to the entry after the current one, wrapping at the end of the table.
+ *
+ * @param dev       the radio
+ * @param table     the table
+ * @return SI446X_OK or the error of the command
+ */
+INT8U SI446X_DEV_HOP_NEXT( SI446X_DEV *dev, SI446X_HOP_TABLE *table )
+{
+    INT8U next = table->index + 1;
+
+    return SI446X_DEV_RX_HOP( dev, table, next < table->count ? next : 0 );
+}
+/*!
+ * Compare the cost of RX_HOP with re-arming the receiver by START_RX. Each
+ * round hops once through the table with each method, timing every change
+ * from the first SPI byte until the radio raises CTS again. The radio is
+ * left in RX on the first entry.
+ *
+ * @param dev       the radio
+ * @param table     the table, 2 entries at least
+ * @param rounds    passes over the table
+ * @param hop       average RX_HOP latency, CPU cycles
+ * @param rearm     average START_RX latency, CPU cycles
+ */
+void SI446X_DEV_HOP_BENCH( SI446X_DEV *dev, SI446X_HOP_TABLE *table, INT8U rounds,
+                           INT32U *hop, INT32U *rearm )
+{
+    INT64U hop_total = 0, rearm_total = 0;
+    INT32U start, changes = 0;
+    INT8U r, i;
+
+    SI446X_DEV_START_RX( dev, table->entry[0].channel, 0, 0, STATE_RX, STATE_RX, STATE_RX );
+    SI446X_DEV_WAIT_CTS( dev );
+    for( r = 0; r < rounds; r ++ )
+    {
+        for( i = 0; i < table->count; i ++ )
+        {
+            start = Si4463_CYCLES( );
+            SI446X_DEV_START_RX( dev, table->entry[i].channel, 0, 0, STATE_RX, STATE_RX, STATE_RX );
+            SI446X_DEV_WAIT_CTS( dev );
+            rearm_total += Si4463_CYCLES( ) - start;
+
+            start = Si4463_CYCLES( );
+            SI446X_DEV_RX_HOP( dev, table, i );
+            SI446X_DEV_WAIT_CTS( dev );
+            hop_total += Si4463_CYCLES( ) - start;
+            changes ++;
+        }
+    }
+    SI446X_DEV_RX_HOP( dev, table, 0 );
+
+    *hop = changes ? hop_total / changes : 0;
+    *rearm = changes ? rearm_total / changes : 0;
+}
+/*!
+ * Send a packet and let the radio fall into RX by itself once it is sent.
+ * START_TX carries STATE_RX as TXCOMPLETE_STATE, so no command is needed
+ * between the end of the packet and the receiver being ready, and the RX
+ * FIFO is cleaned in the same FIFO_INFO that empties the TX FIFO. The radio
+ * reuses the arguments of the last START_RX; only when there was none on
+ * this channel is one sent first, before the packet is loaded.
+ *
+ * @param dev       the radio
+ * @param pTxData   the frame
+ * @param numBytes  its length
+ * @param channel   channel to send and then listen on
+ * @return SI446X_OK or the error of START_TX
+ */
+INT8U SI446X_DEV_SEND_LISTEN( SI446X_DEV *dev, const INT8U *pTxData, INT8U numBytes,
+                              INT8U channel )
+{
+    INT8U cmd[5], status;
+
+    SI446X_LOCK( dev );
+    if( !dev->rx_armed.valid || dev->rx_armed.arg[0] != channel )
+    {
+        SI446X_DEV_START_RX( dev, channel, 0, 0, STATE_RX, STATE_RX, STATE_RX );
+    }
+    SI446X_TX_PREPARE( dev, STATE_RX << 4 );
+
+    cmd[0] = START_TX;
+    cmd[1] = channel;
+    cmd[2] = STATE_RX << 4;
+    cmd[3] = 0;
+    cmd[4] = SI446X_TX_LOAD( dev, pTxData, numBytes );
+    status = SI446X_DEV_CMD( dev, cmd, 5 );
+    SI446X_UNLOCK( dev );
+    return status;
+}
+/*!
+ * Send a packet with SI446X_SEND_LISTEN and time the turnaround by polling
+ * the current state in FRR D, which needs no CTS. The end of TX is the
+ * first read after the radio left STATE_TX, RX ready is the first read
+ * showing STATE_RX; both are accurate to one FRR read (about 2 us at 8 MHz
+ * SPI). The nIRQ handler is held off while polling.
+ *
+ * @param dev       the radio
+ * @param pTxData   the frame
+ * @param numBytes  its length
+ * @param channel   channel to send and then listen on
+ * @return SI446X_OK, SI446X_ERR_TIMEOUT if RX was not reached within
+ *         SI446X_STREAM_TIMEOUT_US
+ */
+INT8U SI446X_DEV_TURNAROUND_MEASURE( SI446X_DEV *dev, const INT8U *pTxData, INT8U numBytes,
+                                     INT8U channel )
+{
+    INT32U start, now, tx_end = 0;
+    INT32U limit = SI446X_US_CYCLES( SI446X_STREAM_TIMEOUT_US );
+    BOOLEAN in_tx = BOOL_FALSE;
+    INT8U state, status;
+
+    SI446X_LOCK( dev );
+    status = SI446X_DEV_SEND_LISTEN( dev, pTxData, numBytes, channel );
+    start = Si4463_CYCLES( );
+    while( status == SI446X_OK )
+    {
+        state = SI446X_DEV_GET_DEVICE_STATE( dev );
+        now = Si4463_CYCLES( );
+        if( state == STATE_TX )
+        {
+            in_tx = BOOL_TRUE;
+        }
+        else if( in_tx )
+        {
+            if( tx_end == 0 )   { tx_end = now; }
+            if( state == STATE_RX )
+            {
+                dev->turnaround.count ++;
+                dev->turnaround.airtime = tx_end - start;
+                dev->turnaround.last = now - tx_end;
+                if( dev->turnaround.last > dev->turnaround.max )  { dev->turnaround.max = dev->turnaround.last; }
+                break;
+            }
+        }
+        if( now - start >= limit )  { status = SI446X_ERR_TIMEOUT; }
+    }
+    SI446X_UNLOCK( dev );
+    return status;
+}
+/*!
+ * Read the turnaround measurements
+ */
+const SI446X_TURNAROUND *SI446X_DEV_TURNAROUND_GET( SI446X_DEV *dev )
+{
+    return &dev->turnaround;
+}
+/*!
+ * Busy wait on the cycle counter
+ *
+ * @param us    how long
+ */
+static void SI446X_DELAY_US( INT32U us )
+{
+    INT32U start = Si4463_CYCLES( );
+    INT32U cycles = SI446X_US_CYCLES( us );
+
+    while( Si4463_CYCLES( ) - start < cycles );
+}
+/*!
+ * Wait for the radio to reach a state, polling FRR D
+ *
+ * @param dev         the radio
+ * @param state       SI446X_STATE to wait for
+ * @param timeout_us  how long to wait
+ * @return BOOL_TRUE once the state is reached
+ */
+static BOOLEAN SI446X_WAIT_STATE( SI446X_DEV *dev, INT8U state, INT32U timeout_us )
+{
+    INT32U start = Si4463_CYCLES( );
+    INT32U limit = SI446X_US_CYCLES( timeout_us );
+
+    do
+    {
+        if( SI446X_DEV_GET_DEVICE_STATE( dev ) == state )   { return BOOL_TRUE; }
+    } while( Si4463_CYCLES( ) - start < limit );
+
+    return BOOL_FALSE;
+}
+/*!
+ * Current RSSI of the channel the receiver is on. Pending modem interrupts
+ * are left alone, so the RX engine still sees them.
+ *
+ * @return raw RSSI, see SI446X_RSSI_DBM
+ */
+static INT8U SI446X_CURR_RSSI( SI446X_DEV *dev )
+{
+    INT8U cmd[3];
+
+    cmd[0] = GET_MODEM_STATUS;
+    cmd[1] = 0xFF;
+    SI446X_LOCK( dev );
+    SI446X_DEV_CMD( dev, cmd, 2 );
+    SI446X_READ_RESPONSE( dev, cmd, 3 );
+    SI446X_UNLOCK( dev );
+    return cmd[2];
+}
+/*!
+ * Measure the energy on a list of channels. The receiver visits each channel
+ * in turn, START_RX for the first and RX_HOP for the others, and takes
+ * samples of the current RSSI spread over dwell_us once it is in RX. The
+ * radio is left in RX on the last channel with its FIFOs reset.
+ *
+ * @param dev       the radio
+ * @param channels  channels to scan, up to SI446X_HOP_MAX
+ * @param count     number of channels
+ * @param dwell_us  time spent on each channel
+ * @param samples   RSSI samples per channel, 1 at least
+ * @param result    one entry per channel
+ * @return SI446X_OK, SI446X_ERR_TIMEOUT if the radio did not reach RX
+ */
+INT8U SI446X_DEV_ENERGY_SCAN( SI446X_DEV *dev, const INT8U *channels, INT8U count,
+                              INT16U dwell_us, INT8U samples, SI446X_SCAN *result )
+{
+    SI446X_HOP_TABLE table;
+    INT8U i, s, rssi;
+    INT16U sum;
+
+    if( count == 0 || count > SI446X_HOP_MAX || samples == 0 ) { return SI446X_ERR_PARAM; }
+
+    SI446X_DEV_HOP_TABLE_INIT( dev, &table, channels, count );
+    for( i = 0; i < count; i ++ )
+    {
+        if( i == 0 )    { SI446X_DEV_START_RX( dev, channels[0], 0, 0, STATE_RX, STATE_RX, STATE_RX ); }
+        else            { SI446X_DEV_RX_HOP( dev, &table, i ); }
+        if( !SI446X_WAIT_STATE( dev, STATE_RX, SI446X_CTS_TIMEOUT_US ) )    { return SI446X_ERR_TIMEOUT; }
+
+        result[i].channel = channels[i];
+        result[i].min = 0xFF;
+        result[i].max = 0;
+        sum = 0;
+        for( s = 0; s < samples; s ++ )
+        {
+            if( s ) { SI446X_DELAY_US( dwell_us / samples ); }
+            rssi = SI446X_CURR_RSSI( dev );
+            sum += rssi;
+            if( rssi < result[i].min )  { result[i].min = rssi; }
+            if( rssi > result[i].max )  { result[i].max = rssi; }
+        }
+        result[i].mean = sum / samples;
+    }
+    return SI446X_OK;
+}
+/*!
+ * The quietest channel of a scan: lowest mean RSSI, then lowest peak.
+ *
+ * @param result    the scan
+ * @param count     number of entries
+ * @return index of the quietest entry
+ */
+INT8U SI446X_SCAN_QUIETEST( const SI446X_SCAN *result, INT8U count )
+{
+    INT8U i, best = 0;
+
+    for( i = 1; i < count; i ++ )
+    {
+        if( result[i].mean < result[best].mean ||
+            ( result[i].mean == result[best].mean && result[i].max < result[best].max ) )
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+/*!
+ * Clear channel assessment. The receiver is brought to RX on channel if it
+ * is not there already, then the current RSSI is sampled for window_us.
+ *
+ * @param dev           the radio
+ * @param channel       channel to check
+ * @param threshold_dbm energy at or above which the channel is busy
+ * @param window_us     how long to listen
+ * @return BOOL_TRUE if the channel is clear
+ */
+BOOLEAN SI446X_DEV_CCA( SI446X_DEV *dev, INT8U channel, INT8S threshold_dbm, INT16U window_us )
+{
+    INT32U start, limit = SI446X_US_CYCLES( window_us );
+    INT16S threshold = ( ( INT16S )threshold_dbm + SI446X_RSSI_CAL ) * 2;
+
+    if( !dev->rx_armed.valid || dev->rx_armed.arg[0] != channel ||
+        SI446X_DEV_GET_DEVICE_STATE( dev ) != STATE_RX )
+    {
+        SI446X_DEV_START_RX( dev, channel, 0, 0, STATE_RX, STATE_RX, STATE_RX );
+        if( !SI446X_WAIT_STATE( dev, STATE_RX, SI446X_CTS_TIMEOUT_US ) ) { return BOOL_FALSE; }
+    }
+
+    start = Si4463_CYCLES( );
+    do
+    {
+        if( SI446X_CURR_RSSI( dev ) >= threshold )  { return BOOL_FALSE; }
+    } while( Si4463_CYCLES( ) - start < limit );
+
+    return BOOL_TRUE;
+}
+/*!
+ * Send a packet once the channel is clear. A busy channel is retried after
+ * a random backoff whose window doubles each time, up to SI446X_LBT_RETRIES.
+ *
+ * @param dev       the radio
+ * @param pTxData   the frame
+ * @param numBytes  its length
+ * @param channel   tx channel
+ * @param condition tx condition
+ * @return SI446X_OK once sent, the error of SI446X_SEND_SEG, SI446X_ERR_BUSY
+ *         if the channel never cleared
+ */
+INT8U SI446X_DEV_SEND_PACKET_LBT( SI446X_DEV *dev, const INT8U *pTxData, INT8U numBytes,
+                                  INT8U channel, INT8U condition )
+{
+    INT32U window = SI446X_LBT_BACKOFF_US;
+    INT8U attempt, status;
+    SI446X_SEG seg;
+
+    seg.data = pTxData;
+    seg.length = numBytes;
+    for( attempt = 0; attempt <= SI446X_LBT_RETRIES; attempt ++ )
+    {
+        if( SI446X_DEV_CCA( dev, channel, SI446X_CCA_THRESHOLD_DBM, SI446X_CCA_WINDOW_US ) )
+        {
+            status = SI446X_DEV_SEND_SEG( dev, &seg, 1, channel, condition );
+            if( status == SI446X_OK )   { dev->lbt_stats.sent ++; }
+            return status;
+        }
+        dev->lbt_stats.busy ++;
+        SI446X_DELAY_US( ( ( Si4463_CYCLES( ) * 2654435761u ) >> 8 ) % window );
+        window <<= 1;
+    }
+    dev->lbt_stats.gave_up ++;
+    return SI446X_ERR_BUSY;
+}
+/*!
+ * Read the listen before talk statistics
+ */
+const SI446X_LBT_STATS *SI446X_DEV_LBT_STATS_GET( SI446X_DEV *dev )
+{
+    return &dev->lbt_stats;
 }
 
 /*
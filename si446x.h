@@ -3,7 +3,7 @@
 #ifndef _SI446X_H_
 #define _SI446X_H_
 
-#include "SI446X_defs.h"
+#include "si446x_defs.h"
 
 /*
 =================================================================================
@@ -11,13 +11,20 @@
 =================================================================================
 */
 
-#include "board.h"   //BSPSi446Xõغ
+#include "Board.h"   //BSPSi446Xõغ
 
-#define SI_CSN_LOW( )   SPI0_nss_clear()
-#define SI_CSN_HIGH( )  SPI0_nss_set()
+extern uint32_t g_ui32SysClock;     //system clock of the BSP, Hz
 
-#define SI_SDN_LOW( )   GPIOPinWrite(SI4463_SDN_PORT, SI4463_SDN_PIN, 0)
-#define SI_SDN_HIGH( )  GPIOPinWrite(SI4463_SDN_PORT, SI4463_SDN_PIN, SI4463_SDN_PIN)
+/*A time in us as Si4463_CYCLES( ) counts, and a count back to us*/
+#define SI446X_US_CYCLES( us )      ( ( g_ui32SysClock / 1000000 ) * ( INT32U )( us ) )
+#define SI446X_CYCLES_US( cycles )  ( ( INT32U )( cycles ) / ( g_ui32SysClock / 1000000 ) )
+
+/*Pins of the radio si446x.c works on, dev*/
+#define SI_CSN_LOW( )   Si4463_BUS_CSN( dev->bus, BOOL_FALSE )
+#define SI_CSN_HIGH( )  Si4463_BUS_CSN( dev->bus, BOOL_TRUE )
+
+#define SI_SDN_LOW( )   Si4463_BUS_SDN( dev->bus, BOOL_FALSE )
+#define SI_SDN_HIGH( )  Si4463_BUS_SDN( dev->bus, BOOL_TRUE )
 
 /*
 =================================================================================
@@ -27,6 +34,340 @@
 
 #define  PACKET_LENGTH	0 //0-64, if = 0: variable mode, else: fixed mode
 
+#define  SI446X_CRC_ENABLE      1       //PH CRC on variable mode frames, both ends must agree
+#define  SI446X_CRC_POLY        0x84    //PKT_CRC_CONFIG: seed all ones, CRC-16 (IBM)
+
+/*dst byte of a frame as the packet handler counts it: length, appkey (2), dst, src*/
+#define  SI446X_DST_OFFSET      ( ( PACKET_LENGTH == 0 ) + 2 )
+
+#define  SI446X_CTS_TIMEOUT_US	10000 //longest wait for CTS before giving up
+
+#define  SI446X_FIFO_SIZE           64      //TX and RX FIFO depth
+#define  SI446X_STREAM_THRESHOLD    48      //FIFO refill/drain chunk in stream mode
+#define  SI446X_STREAM_MAX_LEN      8191    //13-bit field length
+#define  SI446X_STREAM_TIMEOUT_US   200000  //longest wait for a FIFO event
+#define  SI446X_SOURCE_CHUNK        16      //bytes a TX source makes per call, an AES block
+
+#define  SI446X_PROP_BATCH_SIZE     32      //property writes collected by one batch
+#define  SI446X_PROP_MAX_PER_CMD    12      //properties carried by one SET_PROPERTY
+
+#define  SI446X_RX_RING_SIZE        8       //packets buffered by the RX engine, power of 2
+#define  SI446X_RX_SLOT_SIZE        SI446X_FIFO_SIZE
+
+#define  SI446X_HOP_MAX             16      //channels in one hop table
+
+#define  SI446X_RSSI_CAL            130     //RSSI (in dBm) = raw / 2 - SI446X_RSSI_CAL
+#define  SI446X_RSSI_DBM( raw )     ( ( INT16S )( raw ) / 2 - SI446X_RSSI_CAL )
+
+#define  SI446X_CCA_THRESHOLD_DBM   -90     //channel busy at or above this energy
+#define  SI446X_CCA_WINDOW_US       1000    //listen time of a clear channel assessment
+#define  SI446X_LBT_RETRIES         4       //busy channel retries before giving up
+#define  SI446X_LBT_BACKOFF_US      2000    //first backoff window, doubled per retry
+
+#define  SI446X_ACK_MAX             16      //bytes of an auto-ACK frame
+#define  SI446X_ACK_BIN_US          16      //width of an auto-ACK latency bin
+#define  SI446X_ACK_BINS            8       //the last one takes the rest
+
+#define  SI446X_DEDUP_SOURCES       256     //one sequence window per source byte value
+#define  SI446X_DEDUP_WINDOW        32      //sequence numbers a window covers, bits of INT32U
+
+/*1: record every SPI transaction into a RAM ring and per opcode latency
+  histograms, read with SI446X_TRACE_* or the rtrace console command*/
+#ifndef  SI446X_TRACE
+#define  SI446X_TRACE               0
+#endif
+#define  SI446X_TRACE_SIZE          256     //transactions kept, power of 2
+#define  SI446X_TRACE_OPCODES       24      //opcodes with a histogram
+#define  SI446X_TRACE_BINS          12      //bin i: latency below 2^i us, the last one the rest
+
+/*Driver status codes*/
+#define  SI446X_OK              0
+#define  SI446X_ERR_CTS_TIMEOUT 1   //the radio did not raise CTS in time
+#define  SI446X_ERR_READ        2   //READ_CMD_BUFF did not return CTS
+#define  SI446X_ERR_TIMEOUT     3   //the radio did not raise the expected event
+#define  SI446X_ERR_PARAM       4   //an argument is out of range
+#define  SI446X_ERR_BUSY        5   //the channel stayed busy
+#define  SI446X_ERR_STATE       6   //the radio is in a state the call could not restore
+
+/*CTS wait statistics, in CPU cycles*/
+typedef struct
+{
+    INT32U waits;       //number of waits
+    INT32U timeouts;    //waits which gave up
+    INT32U last;        //duration of the last wait
+    INT32U max;         //longest wait
+    INT64U total;       //sum of all waits
+}SI446X_CTS_STATS;
+
+/*Fast response registers as programmed by SI446X_CONFIG_INIT*/
+typedef struct
+{
+    INT8U ph_pend;      //FRR A, INT_PH_PEND, see SI446X_PH_INT
+    INT8U modem_pend;   //FRR B, INT_MODEM_PEND, see SI446X_MODEM_INT
+    INT8U rssi;         //FRR C, latched RSSI, raw value
+    INT8U state;        //FRR D, current state, see SI446X_STATE
+}SI446X_FRR;
+
+/*Property shadow statistics*/
+typedef struct
+{
+    INT32U reads_served;    //GET_PROPERTY answered from RAM
+    INT32U writes_elided;   //SET_PROPERTY skipped, the radio had the values
+}SI446X_SHADOW_STATS;
+
+/*Property writes collected for SI446X_PROP_BATCH_FLUSH*/
+typedef struct
+{
+    INT8U  count;
+    INT16U prop[SI446X_PROP_BATCH_SIZE];    //SI446X_PROPERTY, group in the high byte
+    INT8U  value[SI446X_PROP_BATCH_SIZE];
+}SI446X_PROP_BATCH;
+
+/*A packet received by the RX engine*/
+typedef struct
+{
+    INT32U timestamp;   //Si4463_CYCLES( ) when nIRQ was served
+    INT8U  length;      //payload bytes in data
+    INT8S  rssi;        //latched RSSI in dBm
+    INT8U  data[SI446X_RX_SLOT_SIZE];
+}SI446X_RX_SLOT;
+
+/*RX engine statistics*/
+typedef struct
+{
+    INT32U irqs;        //nIRQ interrupts served
+    INT32U packets;     //packets put in the ring
+    INT32U dropped;     //packets dropped: the ring was full or the RX FIFO overflowed
+    INT32U crc_errors;  //bad frames dropped from the RX FIFO
+    INT32U duplicates;  //packets received before, dropped after their header
+    INT32U seq_restarts;//sources whose sequence number jumped back beyond the window
+}SI446X_RX_STATS;
+
+/*TX to RX turnaround measured by SI446X_TURNAROUND_MEASURE, CPU cycles*/
+typedef struct
+{
+    INT32U count;       //measurements taken
+    INT32U airtime;     //START_TX to the end of TX, last measurement
+    INT32U last;        //end of TX to RX ready, last measurement
+    INT32U max;         //longest end of TX to RX ready
+}SI446X_TURNAROUND;
+
+/*One piece of a frame for SI446X_SEND_SEG*/
+typedef struct
+{
+    const INT8U *data;
+    INT8U length;
+}SI446X_SEG;
+
+/*Makes the next bytes of a frame for SI446X_SEND_SOURCE into chunk,
+  SI446X_SOURCE_CHUNK at most; returns how many*/
+typedef INT8U ( *SI446X_TX_SOURCE )( void *arg, INT8U *chunk );
+
+/*Energy of one channel, raw RSSI, see SI446X_RSSI_DBM*/
+typedef struct
+{
+    INT8U channel;
+    INT8U min;
+    INT8U max;
+    INT8U mean;
+}SI446X_SCAN;
+
+/*Listen before talk statistics*/
+typedef struct
+{
+    INT32U sent;        //packets sent after a clear assessment
+    INT32U busy;        //assessments which found the channel busy
+    INT32U gave_up;     //packets not sent, SI446X_ERR_BUSY
+}SI446X_LBT_STATS;
+
+/*Frame the nIRQ handler answers received frames with. Offsets count from the
+appkey, as in SI446X_RX_SLOT.data*/
+typedef struct
+{
+    INT8U frame[SI446X_ACK_MAX];    //appkey, dst (the sender, patched), src, then anything
+    INT8U length;
+    INT8U seq_from;                 //byte of the received frame copied...
+    INT8U seq_to;                   //...into this byte of the ACK
+    INT8U match_offset;             //frames answered: ( byte & mask ) == value
+    INT8U match_mask;
+    INT8U match_value;
+}SI446X_ACK_TEMPLATE;
+
+/*Packets SI446X_DEDUP_ON checks. Offsets count from the appkey, as in
+SI446X_RX_SLOT.data; the source is the byte at key_offset, 3 for src*/
+typedef struct
+{
+    INT8U seq_offset;               //byte holding the sequence number
+    INT8U match_offset;             //packets checked: ( byte & mask ) == value
+    INT8U match_mask;
+    INT8U match_value;
+    INT8U key_offset;               //byte naming the source, e.g. an origin relayed by others
+    INT8U address;                  //only packets with this dst, 0 for every packet
+}SI446X_DEDUP_RULE;
+
+/*Auto-ACK statistics, latency from nIRQ to START_TX accepted*/
+typedef struct
+{
+    INT32U acked;
+    INT32U skipped;     //answerable frames drained along with a later one or ahead of a send
+    INT32U last;        //CPU cycles
+    INT32U max;         //CPU cycles
+    INT32U bin[SI446X_ACK_BINS];    //SI446X_ACK_BIN_US wide
+}SI446X_ACK_STATS;
+
+/*Channels prepared for RX_HOP by SI446X_HOP_TABLE_INIT*/
+typedef struct
+{
+    INT8U count;        //entries in use
+    INT8U index;        //entry the receiver is on
+    struct
+    {
+        INT8U channel;  //channel number, for START_RX
+        INT8U arg[6];   //INTE, FRAC2, FRAC1, FRAC0, VCO_CNT1, VCO_CNT0
+    }entry[SI446X_HOP_MAX];
+}SI446X_HOP_TABLE;
+
+/*One SPI transaction: a chip select window and the CTS wait before it*/
+typedef struct
+{
+    INT32U timestamp;   //Si4463_CYCLES( ) at chip select
+    INT32U cts;         //CTS wait before it, CPU cycles
+    INT32U duration;    //chip select low, CPU cycles
+    INT16U bytes;       //bytes clocked
+    INT8U  opcode;      //first byte, SI446X_CMD or FRR/FIFO access
+}SI446X_TRACE_ENTRY;
+
+/*Latency, CTS wait and window, of the transactions of one opcode*/
+typedef struct
+{
+    INT8U  opcode;
+    INT32U count;
+    INT32U max;         //CPU cycles
+    INT64U total;       //CPU cycles
+    INT32U bin[SI446X_TRACE_BINS];
+}SI446X_TRACE_HIST;
+
+/*A modem profile: SET_PROPERTY commands as SI446X_CFG_ENTRY, 0 terminated*/
+typedef struct
+{
+    const INT8U *stream;
+    INT32U symbol_rate;     //symbols per second, for timing by the caller
+    INT8S  min_rssi_dbm;    //weakest link SI446X_PROFILE_FOR_RSSI picks it for
+}SI446X_PROFILE;
+
+/*Profile switch statistics, times in CPU cycles*/
+typedef struct
+{
+    INT32U switches;
+    INT16U props;           //properties of the last profile loaded
+    INT16U written;         //of which differed from the radio and were written
+    INT8U  commands;        //SET_PROPERTY commands of the last switch
+    INT32U last;            //duration of the last switch, RX re-armed included
+    INT32U max;
+}SI446X_PROFILE_STATS;
+
+#define  SI446X_SHADOW_SIZE     325     //properties kept in the shadow, checked in si446x.c
+
+/*One radio and the driver state that goes with it. Set up with
+SI446X_DEV_INIT, then only touched by the driver*/
+typedef struct
+{
+    SI4463_BUS *bus;                //SPI bus and pins
+    const INT8U *config;            //configuration stream, see SI446X_CFG_ENTRY
+
+    volatile INT8U lock_depth;      //nesting depth of SI446X_LOCK( )
+    SI446X_CTS_STATS cts_stats;
+
+    /*Packets handed from the nIRQ handler to the main loop*/
+    struct
+    {
+        SI446X_RX_SLOT slot[SI446X_RX_RING_SIZE];
+        volatile INT8U head;        //next slot to fill, written by the nIRQ handler only
+        volatile INT8U tail;        //next slot to consume, written by the main loop only
+    }rx_ring;
+
+    SI446X_RX_STATS rx_stats;
+    volatile BOOLEAN rx_tx_done;
+    INT8U rx_length;                //length of the packet at the FIFO head, 0 if not read yet
+
+    /*Frames answered by the nIRQ handler*/
+    struct
+    {
+        BOOLEAN on;
+        volatile BOOLEAN on_air;    //the next PACKET_SENT is the ACK's
+        SI446X_ACK_TEMPLATE tpl;
+        SI446X_ACK_STATS stats;
+    }ack;
+
+    /*Sequence numbers received per source, for SI446X_DEDUP_ON*/
+    struct
+    {
+        INT32U  seen[SI446X_DEDUP_SOURCES]; //bit i: top - i received; 0, nothing yet
+        INT8U   top[SI446X_DEDUP_SOURCES];  //newest sequence number
+        BOOLEAN on;
+        INT8U   header;             //bytes read before the check
+        SI446X_DEDUP_RULE rule;
+    }dedup;
+
+    /*Destination filter of the packet handler*/
+    struct
+    {
+        BOOLEAN on;
+        INT8U   offset;             //dst byte in the frame, the length field included
+        INT8U   address;
+        INT8U   broadcast;
+    }filter;
+
+    /*Arguments of the last START_RX, which the radio reuses when TX falls into RX*/
+    struct
+    {
+        BOOLEAN valid;
+        INT8U   arg[7];             //CHANNEL, CONDITION, RX_LEN, NEXT_STATE1..3
+    }rx_armed;
+
+    /*Stream frame the nIRQ handler moves through the FIFO*/
+    struct
+    {
+        const INT8U *tx;            //payload being sent, NULL while receiving
+        INT8U   *rx;                //where the payload being received goes
+        INT16U  size;               //room at rx
+        INT16U  length;             //payload length, known on RX once its field is read
+        volatile INT16U done;       //frame bytes through the FIFO, the length field included
+        volatile INT8U events;      //PACKET_SENT and PACKET_RX seen by the handler
+        SI4463_BUS_CALLBACK callback;   //nIRQ handler given back at the end of the frame
+        void    *arg;
+    }stream;
+
+    SI446X_TURNAROUND turnaround;
+    SI446X_LBT_STATS lbt_stats;
+
+    /*Every property value written to the radio since the last reset*/
+    struct
+    {
+        INT8U value[SI446X_SHADOW_SIZE];
+        INT8U valid[( SI446X_SHADOW_SIZE + 7 ) / 8];
+    }shadow;
+
+    SI446X_SHADOW_STATS shadow_stats;
+
+    const SI446X_PROFILE *profile;  //last profile loaded, NULL for the configuration stream
+    SI446X_PROFILE_STATS profile_stats;
+
+#if SI446X_TRACE
+    /*Transaction being traced*/
+    struct
+    {
+        INT32U start;
+        INT32U cts;                 //last CTS wait, taken by the next transaction
+        INT16U bytes;
+        INT8U  opcode;
+    }trace;
+#endif
+}SI446X_DEV;
+
+/*A command of a configuration stream: its length, then the RF_* macro*/
+#define SI446X_CFG_LEN( ... )           sizeof( ( const INT8U[] ){ __VA_ARGS__ } )
+#define SI446X_CFG_ENTRY( cmd )         SI446X_CFG_LEN( cmd ), cmd,
 
 
 /*
@@ -35,81 +376,375 @@
 =================================================================================
 */
 
+/*Set up a radio on bus, configured by config, NULL for radio_config.h*/
+void SI446X_DEV_INIT( SI446X_DEV *radio, SI4463_BUS *bus, const INT8U *config );
+
+/*The radio on SPI0, the one the single radio API below works on*/
+extern SI446X_DEV g_sSi446xDev0;
+
+#ifdef SI446X_SIM
+/*Bring up the simulated radio index on its own bus, reset and configured*/
+void SI446X_SIM_RADIO_UP( SI446X_DEV *radio, uint8_t index );
+#endif
+
 /*Read the PART_INFO of the device, 8 bytes needed*/
-void SI446X_PART_INFO( INT8U *buffer );
+void SI446X_DEV_PART_INFO( SI446X_DEV *dev, INT8U *buffer );
 
 /*Read the FUNC_INFO of the device, 7 bytes needed*/
-void SI446X_FUNC_INFO( INT8U *buffer );
+void SI446X_DEV_FUNC_INFO( SI446X_DEV *dev, INT8U *buffer );
 
 /*Send a command to the device*/
-void SI446X_CMD( INT8U *cmd, INT8U cmdsize );
+INT8U SI446X_DEV_CMD( SI446X_DEV *dev, const INT8U *cmd, INT8U cmdsize );
+
+/*Wait the device ready to response a command*/
+INT8U SI446X_DEV_WAIT_CTS( SI446X_DEV *dev );
+
+/*Read the CTS wait statistics*/
+const SI446X_CTS_STATS *SI446X_DEV_CTS_STATS_GET( SI446X_DEV *dev );
+
+/*Clear the CTS wait statistics*/
+void SI446X_DEV_CTS_STATS_CLEAR( SI446X_DEV *dev );
 
 /*Read the INT status of the device, 9 bytes needed*/
-void SI446X_INT_STATUS( INT8U *buffer );
+void SI446X_DEV_INT_STATUS( SI446X_DEV *dev, INT8U *buffer );
 
 /*Read the PROPERTY of the device*/
-void SI446X_GET_PROPERTY_X( SI446X_PROPERTY GROUP_NUM, INT8U NUM_PROPS, INT8U *buffer  );
+void SI446X_DEV_GET_PROPERTY_X( SI446X_DEV *dev, SI446X_PROPERTY GROUP_NUM, INT8U NUM_PROPS,
+                                INT8U *buffer  );
 
 /*configuration the device*/
-void SI446X_CONFIG_INIT( void );
+void SI446X_DEV_CONFIG_INIT( SI446X_DEV *dev );
 
 /*reset the SI446x device*/
-void SI446X_RESET( void );
+void SI446X_DEV_RESET( SI446X_DEV *dev );
 
 /*write data to TX fifo*/
-void SI446X_W_TX_FIFO( INT8U *txbuffer, INT8U size );
+void SI446X_DEV_W_TX_FIFO( SI446X_DEV *dev, INT8U *txbuffer, INT8U size );
 
 /*start TX command*/
-void SI446X_START_TX( INT8U channel, INT8U condition, INT16U tx_len );
+void SI446X_DEV_START_TX( SI446X_DEV *dev, INT8U channel, INT8U condition, INT16U tx_len );
 
 /*read RX fifo*/
-INT8U SI446X_READ_PACKET( INT8U *buffer );
+INT8U SI446X_DEV_READ_PACKET( SI446X_DEV *dev, INT8U *buffer );
 
 /*start RX state*/
-void SI446X_START_RX( INT8U channel, INT8U condition, INT16U rx_len,
-                      INT8U n_state1, INT8U n_state2, INT8U n_state3 );
+void SI446X_DEV_START_RX( SI446X_DEV *dev, INT8U channel, INT8U condition, INT16U rx_len,
+                          INT8U n_state1, INT8U n_state2, INT8U n_state3 );
 
 /*read packet information*/
-void SI446X_PKT_INFO( INT8U *buffer, INT8U FIELD, INT16U length, INT16U diff_len );
+void SI446X_DEV_PKT_INFO( SI446X_DEV *dev, INT8U *buffer, INT8U FIELD, INT16U length,
+                          INT16U diff_len );
 
 /*read fifo information*/
-void SI446X_FIFO_INFO( INT8U *buffer );
+void SI446X_DEV_FIFO_INFO( SI446X_DEV *dev, INT8U *buffer );
 
 /*Power up the device*/
-void SI446X_POWER_UP( INT32U f_xtal );
+void SI446X_DEV_POWER_UP( SI446X_DEV *dev, INT32U f_xtal );
 
 /*send a packet*/
-void SI446X_SEND_PACKET( INT8U *txbuffer, INT8U size, INT8U channel, INT8U condition );
+void SI446X_DEV_SEND_PACKET( SI446X_DEV *dev, const INT8U *txbuffer, INT8U size,
+                             INT8U channel, INT8U condition );
+
+/*send a frame gathered from several buffers*/
+INT8U SI446X_DEV_SEND_SEG( SI446X_DEV *dev, const SI446X_SEG *seg, INT8U count,
+                           INT8U channel, INT8U condition );
+
+/*send a frame of a header and bytes made while they are written to the TX FIFO*/
+INT8U SI446X_DEV_SEND_SOURCE( SI446X_DEV *dev, const SI446X_SEG *seg, INT8U count,
+                              SI446X_TX_SOURCE source, void *arg, INT8U length,
+                              INT8U channel, INT8U condition );
 
 /*Set the PROPERTY of the device*/
-void SI446X_SET_PROPERTY_X( SI446X_PROPERTY GROUP_NUM, INT8U NUM_PROPS, INT8U *PAR_BUFF );
+void SI446X_DEV_SET_PROPERTY_X( SI446X_DEV *dev, SI446X_PROPERTY GROUP_NUM, INT8U NUM_PROPS,
+                                INT8U *PAR_BUFF );
+
+/*compare the property shadow with the radio, returns the differences*/
+INT16U SI446X_DEV_SHADOW_VERIFY( SI446X_DEV *dev );
+
+/*read the property shadow statistics*/
+const SI446X_SHADOW_STATS *SI446X_DEV_SHADOW_STATS_GET( SI446X_DEV *dev );
+
+/*start an empty property batch*/
+void SI446X_PROP_BATCH_INIT( SI446X_PROP_BATCH *batch );
+
+/*add a property write to a batch, a full batch is flushed first*/
+void SI446X_DEV_PROP_BATCH_ADD( SI446X_DEV *dev, SI446X_PROP_BATCH *batch,
+                                SI446X_PROPERTY GROUP_NUM, INT8U value );
+
+/*write a batch with the fewest SET_PROPERTY commands, returns the command count*/
+INT8U SI446X_DEV_PROP_BATCH_FLUSH( SI446X_DEV *dev, SI446X_PROP_BATCH *batch );
 
 /*config the CRC, PROPERTY 0x1200*/
 void SI446X_CRC_CONFIG( INT8U PKT_CRC_CONFIG );
 
 /*Get the PROPERTY of the device, only 1 byte*/
-INT8U SI446X_GET_PROPERTY_1( SI446X_PROPERTY GROUP_NUM );
+INT8U SI446X_DEV_GET_PROPERTY_1( SI446X_DEV *dev, SI446X_PROPERTY GROUP_NUM );
 
 /*Set the PROPERTY of the device, only 1 byte*/
-void SI446X_SET_PROPERTY_1( SI446X_PROPERTY GROUP_NUM, INT8U proirity );
+void SI446X_DEV_SET_PROPERTY_1( SI446X_DEV *dev, SI446X_PROPERTY GROUP_NUM, INT8U proirity );
 
 /*config the GPIOs, IRQ, SDO*/
-void SI446X_GPIO_CONFIG( INT8U G0, INT8U G1, INT8U G2, INT8U G3,
-                         INT8U IRQ, INT8U SDO, INT8U GEN_CONFIG );
+void SI446X_DEV_GPIO_CONFIG( SI446X_DEV *dev, INT8U G0, INT8U G1, INT8U G2, INT8U G3,
+                             INT8U IRQ, INT8U SDO, INT8U GEN_CONFIG );
 
 /*reset the RX FIFO of the device*/
-void SI446X_RX_FIFO_RESET( void );
+void SI446X_DEV_RX_FIFO_RESET( SI446X_DEV *dev );
 
 /*reset the TX FIFO of the device*/
-void SI446X_TX_FIFO_RESET( void );
+void SI446X_DEV_TX_FIFO_RESET( SI446X_DEV *dev );
+
+INT8U SI446X_DEV_GET_DEVICE_STATE( SI446X_DEV *dev );
+
+/*BOOL_TRUE while the radio is in TX or TX_TUNE*/
+BOOLEAN SI446X_DEV_TX_BUSY( SI446X_DEV *dev );
+
+void SI446X_DEV_CHANGE_STATE( SI446X_DEV *dev, INT8U NewState );
+
+void SI446X_DEV_SET_POWER( SI446X_DEV *dev, INT8U Power_Level );
+
+INT8S SI446X_DEV_RSSI_INFO( SI446X_DEV *dev );
+
+/*read all four fast response registers, no CTS needed*/
+void SI446X_DEV_FRR_SNAPSHOT( SI446X_DEV *dev, SI446X_FRR *frr );
+
+/*start receiving into the RX ring from the nIRQ handler*/
+void SI446X_DEV_RX_ENGINE_START( SI446X_DEV *dev, INT8U channel );
+
+/*stop the RX engine, packets in the ring are kept*/
+void SI446X_DEV_RX_ENGINE_STOP( SI446X_DEV *dev );
+
+/*oldest packet in the RX ring, NULL if empty; no SPI traffic*/
+const SI446X_RX_SLOT *SI446X_DEV_RX_PEEK( SI446X_DEV *dev );
+
+/*release the packet returned by SI446X_RX_PEEK*/
+void SI446X_DEV_RX_RELEASE( SI446X_DEV *dev );
+
+/*BOOL_TRUE once after the RX engine saw PACKET_SENT*/
+BOOLEAN SI446X_DEV_RX_ENGINE_TX_DONE( SI446X_DEV *dev );
+
+/*read the RX engine statistics*/
+const SI446X_RX_STATS *SI446X_DEV_RX_STATS_GET( SI446X_DEV *dev );
+
+/*answer frames to the template's src address from the nIRQ handler*/
+INT8U SI446X_DEV_AUTO_ACK_ON( SI446X_DEV *dev, const SI446X_ACK_TEMPLATE *ack );
+
+/*stop answering frames*/
+void SI446X_DEV_AUTO_ACK_OFF( SI446X_DEV *dev );
+
+/*read the auto-ACK statistics*/
+const SI446X_ACK_STATS *SI446X_DEV_AUTO_ACK_STATS_GET( SI446X_DEV *dev );
+
+/*drop packets received before, keyed on a source byte and a sequence byte*/
+INT8U SI446X_DEV_DEDUP_ON( SI446X_DEV *dev, const SI446X_DEDUP_RULE *rule );
+
+/*deliver every packet again*/
+void SI446X_DEV_DEDUP_OFF( SI446X_DEV *dev );
+
+/*forget the sequence numbers of a source*/
+void SI446X_DEV_DEDUP_FORGET( SI446X_DEV *dev, INT8U src );
+
+/*have the copy sent again of a packet the layer above dropped delivered*/
+void SI446X_DEV_DEDUP_UNMARK( SI446X_DEV *dev, const INT8U *data );
+
+/*switch the packet handler between normal and stream (2 byte length) frames*/
+void SI446X_DEV_STREAM_MODE( SI446X_DEV *dev, BOOLEAN enable );
+
+/*drop frames which are not sent to address or broadcast*/
+void SI446X_DEV_ADDRESS_FILTER( SI446X_DEV *dev, INT8U address, INT8U broadcast );
+
+/*receive every frame*/
+void SI446X_DEV_ADDRESS_FILTER_OFF( SI446X_DEV *dev );
+
+/*send a packet of up to SI446X_STREAM_MAX_LEN bytes, stream mode only*/
+INT8U SI446X_DEV_STREAM_SEND( SI446X_DEV *dev, const INT8U *txbuffer, INT16U size,
+                              INT8U channel, INT8U condition );
+
+/*receive a packet of up to SI446X_STREAM_MAX_LEN bytes, stream mode only*/
+INT16U SI446X_DEV_STREAM_READ( SI446X_DEV *dev, INT8U *buffer, INT16U size,
+                               INT32U timeout_us );
+
+/*precompute the RX_HOP arguments for a channel list*/
+void SI446X_DEV_HOP_TABLE_INIT( SI446X_DEV *dev, SI446X_HOP_TABLE *table,
+                                const INT8U *channels, INT8U count );
+
+/*retune the receiver to an entry of a hop table, the radio must be in RX*/
+INT8U SI446X_DEV_RX_HOP( SI446X_DEV *dev, SI446X_HOP_TABLE *table, INT8U index );
 
-INT8U SI446X_GET_DEVICE_STATE( void );
+/*hop to the next entry of a hop table*/
+INT8U SI446X_DEV_HOP_NEXT( SI446X_DEV *dev, SI446X_HOP_TABLE *table );
 
-void SI446X_CHANGE_STATE( INT8U NewState );
+/*average RX_HOP and START_RX channel change latency, CPU cycles*/
+void SI446X_DEV_HOP_BENCH( SI446X_DEV *dev, SI446X_HOP_TABLE *table, INT8U rounds,
+                           INT32U *hop, INT32U *rearm );
 
-void SI446X_SET_POWER( INT8U Power_Level );
+/*the modem profile of radio_config.h*/
+const SI446X_PROFILE *SI446X_PROFILE_BASE( void );
 
-INT8S SI446X_RSSI_INFO(void);
+/*switch the modem profile, writing only the properties which differ*/
+INT8U SI446X_DEV_PROFILE_LOAD( SI446X_DEV *dev, const SI446X_PROFILE *profile );
+
+/*fastest profile of a table, slowest first, a link of rssi_dbm can use*/
+INT8U SI446X_PROFILE_FOR_RSSI( const SI446X_PROFILE *table, INT8U count, INT8S rssi_dbm );
+
+/*read the profile switch statistics*/
+const SI446X_PROFILE_STATS *SI446X_DEV_PROFILE_STATS_GET( SI446X_DEV *dev );
+
+#if SI446X_TRACE
+/*take the oldest traced transactions out of the ring, returns how many*/
+INT16U SI446X_DEV_TRACE_READ( SI446X_DEV *dev, SI446X_TRACE_ENTRY *entry, INT16U max );
+
+/*per opcode histograms, count set to the number in use*/
+const SI446X_TRACE_HIST *SI446X_TRACE_HIST_GET( INT8U *count );
+
+/*empty the ring and the histograms*/
+void SI446X_DEV_TRACE_CLEAR( SI446X_DEV *dev );
+
+/*print the ring as CSV for a host, emptying it*/
+void SI446X_DEV_TRACE_DUMP( SI446X_DEV *dev );
+
+/*print the histograms, the costliest opcode first*/
+void SI446X_TRACE_REPORT( void );
+
+/*console command: rtrace [dump|clear]*/
+int Cmd_rtrace( int argc, char *argv[] );
+#endif
+
+/*send a packet, the radio enters RX by itself when it is sent*/
+INT8U SI446X_DEV_SEND_LISTEN( SI446X_DEV *dev, const INT8U *txbuffer, INT8U size,
+                              INT8U channel );
+
+/*send with SI446X_SEND_LISTEN and time the TX end to RX ready turnaround*/
+INT8U SI446X_DEV_TURNAROUND_MEASURE( SI446X_DEV *dev, const INT8U *txbuffer, INT8U size,
+                                     INT8U channel );
+
+/*read the turnaround measurements*/
+const SI446X_TURNAROUND *SI446X_DEV_TURNAROUND_GET( SI446X_DEV *dev );
+
+/*sample the energy on a list of channels*/
+INT8U SI446X_DEV_ENERGY_SCAN( SI446X_DEV *dev, const INT8U *channels, INT8U count,
+                              INT16U dwell_us, INT8U samples, SI446X_SCAN *result );
+
+/*index of the quietest channel of a scan*/
+INT8U SI446X_SCAN_QUIETEST( const SI446X_SCAN *result, INT8U count );
+
+/*clear channel assessment, BOOL_TRUE if the channel is clear*/
+BOOLEAN SI446X_DEV_CCA( SI446X_DEV *dev, INT8U channel, INT8S threshold_dbm,
+                        INT16U window_us );
+
+/*send a packet once the channel is clear, with random backoff*/
+INT8U SI446X_DEV_SEND_PACKET_LBT( SI446X_DEV *dev, const INT8U *txbuffer, INT8U size,
+                                  INT8U channel, INT8U condition );
+
+/*read the listen before talk statistics*/
+const SI446X_LBT_STATS *SI446X_DEV_LBT_STATS_GET( SI446X_DEV *dev );
+
+/*The single radio API, each call on the radio on SPI0*/
+#define SI446X_PART_INFO( ... ) \
+        SI446X_DEV_PART_INFO( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_FUNC_INFO( ... ) \
+        SI446X_DEV_FUNC_INFO( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_CMD( ... )                 SI446X_DEV_CMD( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_WAIT_CTS( )                SI446X_DEV_WAIT_CTS( &g_sSi446xDev0 )
+#define SI446X_CTS_STATS_GET( )           SI446X_DEV_CTS_STATS_GET( &g_sSi446xDev0 )
+#define SI446X_CTS_STATS_CLEAR( )         SI446X_DEV_CTS_STATS_CLEAR( &g_sSi446xDev0 )
+#define SI446X_INT_STATUS( ... ) \
+        SI446X_DEV_INT_STATUS( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_GET_PROPERTY_X( ... ) \
+        SI446X_DEV_GET_PROPERTY_X( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_CONFIG_INIT( )             SI446X_DEV_CONFIG_INIT( &g_sSi446xDev0 )
+#define SI446X_RESET( )                   SI446X_DEV_RESET( &g_sSi446xDev0 )
+#define SI446X_W_TX_FIFO( ... ) \
+        SI446X_DEV_W_TX_FIFO( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_START_TX( ... )            SI446X_DEV_START_TX( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_READ_PACKET( ... ) \
+        SI446X_DEV_READ_PACKET( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_START_RX( ... )            SI446X_DEV_START_RX( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_PKT_INFO( ... )            SI446X_DEV_PKT_INFO( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_FIFO_INFO( ... ) \
+        SI446X_DEV_FIFO_INFO( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_POWER_UP( ... )            SI446X_DEV_POWER_UP( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_SEND_PACKET( ... ) \
+        SI446X_DEV_SEND_PACKET( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_SEND_SEG( ... )            SI446X_DEV_SEND_SEG( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_SEND_SOURCE( ... ) \
+        SI446X_DEV_SEND_SOURCE( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_SET_PROPERTY_X( ... ) \
+        SI446X_DEV_SET_PROPERTY_X( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_SHADOW_VERIFY( )           SI446X_DEV_SHADOW_VERIFY( &g_sSi446xDev0 )
+#define SI446X_SHADOW_STATS_GET( )        SI446X_DEV_SHADOW_STATS_GET( &g_sSi446xDev0 )
+#define SI446X_PROP_BATCH_ADD( ... ) \
+        SI446X_DEV_PROP_BATCH_ADD( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_PROP_BATCH_FLUSH( ... ) \
+        SI446X_DEV_PROP_BATCH_FLUSH( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_GET_PROPERTY_1( ... ) \
+        SI446X_DEV_GET_PROPERTY_1( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_SET_PROPERTY_1( ... ) \
+        SI446X_DEV_SET_PROPERTY_1( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_GPIO_CONFIG( ... ) \
+        SI446X_DEV_GPIO_CONFIG( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_RX_FIFO_RESET( )           SI446X_DEV_RX_FIFO_RESET( &g_sSi446xDev0 )
+#define SI446X_TX_FIFO_RESET( )           SI446X_DEV_TX_FIFO_RESET( &g_sSi446xDev0 )
+#define SI446X_GET_DEVICE_STATE( )        SI446X_DEV_GET_DEVICE_STATE( &g_sSi446xDev0 )
+#define SI446X_TX_BUSY( )                 SI446X_DEV_TX_BUSY( &g_sSi446xDev0 )
+#define SI446X_CHANGE_STATE( ... ) \
+        SI446X_DEV_CHANGE_STATE( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_SET_POWER( ... ) \
+        SI446X_DEV_SET_POWER( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_RSSI_INFO( )               SI446X_DEV_RSSI_INFO( &g_sSi446xDev0 )
+#define SI446X_FRR_SNAPSHOT( ... ) \
+        SI446X_DEV_FRR_SNAPSHOT( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_RX_ENGINE_START( ... ) \
+        SI446X_DEV_RX_ENGINE_START( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_RX_ENGINE_STOP( )          SI446X_DEV_RX_ENGINE_STOP( &g_sSi446xDev0 )
+#define SI446X_RX_PEEK( )                 SI446X_DEV_RX_PEEK( &g_sSi446xDev0 )
+#define SI446X_RX_RELEASE( )              SI446X_DEV_RX_RELEASE( &g_sSi446xDev0 )
+#define SI446X_RX_ENGINE_TX_DONE( )       SI446X_DEV_RX_ENGINE_TX_DONE( &g_sSi446xDev0 )
+#define SI446X_RX_STATS_GET( )            SI446X_DEV_RX_STATS_GET( &g_sSi446xDev0 )
+#define SI446X_AUTO_ACK_ON( ... ) \
+        SI446X_DEV_AUTO_ACK_ON( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_AUTO_ACK_OFF( )            SI446X_DEV_AUTO_ACK_OFF( &g_sSi446xDev0 )
+#define SI446X_AUTO_ACK_STATS_GET( )      SI446X_DEV_AUTO_ACK_STATS_GET( &g_sSi446xDev0 )
+#define SI446X_DEDUP_ON( ... )            SI446X_DEV_DEDUP_ON( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_DEDUP_OFF( )               SI446X_DEV_DEDUP_OFF( &g_sSi446xDev0 )
+#define SI446X_DEDUP_FORGET( ... ) \
+        SI446X_DEV_DEDUP_FORGET( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_DEDUP_UNMARK( ... ) \
+        SI446X_DEV_DEDUP_UNMARK( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_STREAM_MODE( ... ) \
+        SI446X_DEV_STREAM_MODE( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_ADDRESS_FILTER( ... ) \
+        SI446X_DEV_ADDRESS_FILTER( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_ADDRESS_FILTER_OFF( )      SI446X_DEV_ADDRESS_FILTER_OFF( &g_sSi446xDev0 )
+#define SI446X_STREAM_SEND( ... ) \
+        SI446X_DEV_STREAM_SEND( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_STREAM_READ( ... ) \
+        SI446X_DEV_STREAM_READ( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_HOP_TABLE_INIT( ... ) \
+        SI446X_DEV_HOP_TABLE_INIT( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_RX_HOP( ... )              SI446X_DEV_RX_HOP( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_HOP_NEXT( ... )            SI446X_DEV_HOP_NEXT( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_HOP_BENCH( ... ) \
+        SI446X_DEV_HOP_BENCH( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_PROFILE_LOAD( ... ) \
+        SI446X_DEV_PROFILE_LOAD( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_PROFILE_STATS_GET( )       SI446X_DEV_PROFILE_STATS_GET( &g_sSi446xDev0 )
+#define SI446X_SEND_LISTEN( ... ) \
+        SI446X_DEV_SEND_LISTEN( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_TURNAROUND_MEASURE( ... ) \
+        SI446X_DEV_TURNAROUND_MEASURE( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_TURNAROUND_GET( )          SI446X_DEV_TURNAROUND_GET( &g_sSi446xDev0 )
+#define SI446X_ENERGY_SCAN( ... ) \
+        SI446X_DEV_ENERGY_SCAN( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_CCA( ... )                 SI446X_DEV_CCA( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_SEND_PACKET_LBT( ... ) \
+        SI446X_DEV_SEND_PACKET_LBT( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_LBT_STATS_GET( )           SI446X_DEV_LBT_STATS_GET( &g_sSi446xDev0 )
+#if SI446X_TRACE
+#define SI446X_TRACE_READ( ... ) \
+        SI446X_DEV_TRACE_READ( &g_sSi446xDev0, __VA_ARGS__ )
+#define SI446X_TRACE_CLEAR( )             SI446X_DEV_TRACE_CLEAR( &g_sSi446xDev0 )
+#define SI446X_TRACE_DUMP( )              SI446X_DEV_TRACE_DUMP( &g_sSi446xDev0 )
+#endif
 /*
 =================================================================================
 ----------------------------PROPERTY fast setting macros-------------------------
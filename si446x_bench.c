@@ -0,0 +1,754 @@
+/*
+================================================================================
+Function : Cost of the SI446x driver paths, on the host simulation
+================================================================================
+*/
+
+/*
+    gcc -std=c99 -O2 -DSI446X_SIM -I. -o si446x_bench \
+        si446x_bench.c si446x_sim.c si446x.c
+    ./si446x_bench
+
+Build with -DSI446X_TRACE=1 to also print the transaction tracer's report.
+
+For each driver path the SPI bytes, chip select windows, commands needing CTS,
+bus time, time idled for CTS and elapsed time are reported per call, as the
+simulated radio 0 saw them. Radio 0 runs the driver, frames to receive are put
+on the air by the simulation's injector.
+*/
+
+#include "si446x.h"
+
+#define BENCH_ROUNDS    20
+#define BENCH_CHANNEL   0
+#define BENCH_RSSI      120         //-70 dBm
+#define BENCH_ACK_LOOP_US   2000    //main loop period when it sends the ACKs
+#define BENCH_ACK_STEP_US   10      //time resolution of the ACK round trips
+
+/*Counters at the start of a measured section, and their sums*/
+typedef struct
+{
+    SI446X_SIM_STATS start;
+    uint64_t started;
+    SI446X_SIM_STATS sum;
+    uint64_t elapsed;
+    uint32_t calls;
+}BENCH;
+
+static int failures;
+
+/*A profile for the profile switch only, 4x the data rate; not a working
+modem setting, real ones come from WDS*/
+#define BENCH_FAST_RATE     0x11, 0x20, 0x03, 0x03, 0x18, 0x6A, 0x00
+#define BENCH_FAST_BCR      0x11, 0x20, 0x02, 0x22, 0x00, 0x7D
+static const INT8U bench_fast_stream[] =
+{
+    SI446X_CFG_ENTRY( BENCH_FAST_RATE )
+    SI446X_CFG_ENTRY( BENCH_FAST_BCR )
+    0
+};
+
+static void BENCH_MARK( BENCH *b )
+{
+    b->start = *SI446X_SIM_STATS_GET( );
+    b->started = SI446X_SIM_NOW( );
+}
+static void BENCH_ADD( BENCH *b )
+{
+    const SI446X_SIM_STATS *s = SI446X_SIM_STATS_GET( );
+
+    b->sum.spi_bytes    += s->spi_bytes - b->start.spi_bytes;
+    b->sum.transactions += s->transactions - b->start.transactions;
+    b->sum.commands     += s->commands - b->start.commands;
+    b->sum.bus_ns       += s->bus_ns - b->start.bus_ns;
+    b->sum.cts_wait_ns  += s->cts_wait_ns - b->start.cts_wait_ns;
+    b->elapsed += SI446X_SIM_NOW( ) - b->started;
+    b->calls ++;
+}
+static void BENCH_PRINT( const char *name, BENCH *b )
+{
+    uint32_t n = b->calls ? b->calls : 1;
+
+    printf( "%-26s %7.1f %6.1f %6.1f %9.1f %9.1f %10.1f\n", name,
+            ( double )b->sum.spi_bytes / n, ( double )b->sum.transactions / n,
+            ( double )b->sum.commands / n, b->sum.bus_ns / 1000.0 / n,
+            b->sum.cts_wait_ns / 1000.0 / n, b->elapsed / 1000.0 / n );
+    memset( b, 0, sizeof( *b ) );
+}
+static void BENCH_CHECK( int ok, const char *what )
+{
+    if( !ok )
+    {
+        printf( "FAIL: %s\n", what );
+        failures ++;
+    }
+}
+/*Wait for the radio to leave TX, as seen by the simulation*/
+static void BENCH_WAIT_TX( void )
+{
+    while( SI446X_SIM_STATE( ) == STATE_TX_TUNE || SI446X_SIM_STATE( ) == STATE_TX )
+    {
+        SI446X_SIM_RUN( 100 );
+    }
+}
+/*A normal frame, the TX FIFO image: length byte and payload*/
+static uint16_t BENCH_FRAME( uint8_t *frame, uint8_t size, uint8_t seed )
+{
+    uint8_t i;
+
+    frame[0] = size;
+    for( i = 0; i < size; i ++ )    { frame[1 + i] = seed + i; }
+    return size + 1;
+}
+
+/*Tail of a frame for SEND_SOURCE, copied out of a buffer a chunk at a time*/
+typedef struct
+{
+    const INT8U *data;
+    INT8U left;
+}BENCH_SOURCE;
+
+static INT8U BENCH_SOURCE_NEXT( void *arg, INT8U *chunk )
+{
+    BENCH_SOURCE *source = ( BENCH_SOURCE * )arg;
+    INT8U n = GetMin( source->left, SI446X_SOURCE_CHUNK );
+
+    memcpy( chunk, source->data, n );
+    source->data += n;
+    source->left -= n;
+    return n;
+}
+
+/*Round trips of BENCH_ROUNDS frames from radio 0 to radio 1 and their ACKs,
+sent by the nIRQ handler of radio 1 or by its main loop; mean and max in us*/
+static void BENCH_ACK_RUN( SI446X_DEV *radio, BOOLEAN automatic, double *mean, double *max )
+{
+    static const SI446X_ACK_TEMPLATE ack =
+    {
+        { 0xA5, 0x5A, 0x00, 0x11, 0x02, 0x00 }, 6,  //appkey, dst, src, ACK, seq
+        5, 5, 4, 0xFF, 0x01                         //seq of DATA frames
+    };
+    INT8U data[24], reply[SI446X_ACK_MAX];
+    const SI446X_RX_SLOT *slot;
+    SI446X_SEG seg;
+    INT32U sent_at, rtt;
+    uint64_t polled = 0, sum = 0, limit;
+    INT16U r, acked = 0;
+    INT8U i;
+
+    *max = 0;
+    SI446X_SIM_INIT( 2, 3 );
+    for( i = 0; i < 2; i ++ )
+    {
+        SI446X_SIM_RADIO_UP( &radio[i], i );
+        SI446X_DEV_RX_ENGINE_START( &radio[i], BENCH_CHANNEL );
+    }
+    if( automatic ) { BENCH_CHECK( SI446X_DEV_AUTO_ACK_ON( &radio[1], &ack ) == SI446X_OK, "auto-ACK on" ); }
+    SI446X_SIM_RUN( 1000 );
+
+    memcpy( data, ack.frame, 4 );
+    data[2] = 0x11;
+    data[3] = 0x10;
+    data[4] = 0x01;
+    seg.data = data;
+    seg.length = sizeof( data );
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        data[5] = ( INT8U )r;
+        sent_at = Si4463_CYCLES( );
+        SI446X_DEV_SEND_SEG( &radio[0], &seg, 1, BENCH_CHANNEL, STATE_RX << 4 );
+        for( limit = SI446X_SIM_NOW( ) + 50000000ULL; SI446X_SIM_NOW( ) < limit; )
+        {
+            SI446X_SIM_RUN( BENCH_ACK_STEP_US );
+            if( !automatic && SI446X_SIM_NOW( ) - polled >= BENCH_ACK_LOOP_US * 1000ULL )
+            {
+                polled = SI446X_SIM_NOW( );
+                while( ( slot = SI446X_DEV_RX_PEEK( &radio[1] ) ) != NULL )
+                {
+                    memcpy( reply, ack.frame, ack.length );
+                    reply[2] = slot->data[3];
+                    reply[5] = slot->data[5];
+                    SI446X_DEV_RX_RELEASE( &radio[1] );
+                    seg.data = reply;
+                    seg.length = ack.length;
+                    SI446X_DEV_SEND_SEG( &radio[1], &seg, 1, BENCH_CHANNEL, STATE_RX << 4 );
+                    seg.data = data;
+                    seg.length = sizeof( data );
+                }
+            }
+            while( automatic && SI446X_DEV_RX_PEEK( &radio[1] ) != NULL )
+            {
+                SI446X_DEV_RX_RELEASE( &radio[1] );
+            }
+            if( ( slot = SI446X_DEV_RX_PEEK( &radio[0] ) ) != NULL )
+            {
+                if( slot->data[4] == 0x02 && slot->data[5] == ( INT8U )r )
+                {
+                    rtt = ( slot->timestamp - sent_at ) / ( SI446X_SIM_SYSCLK_HZ / 1000000 );
+                    sum += rtt;
+                    if( rtt > *max )    { *max = rtt; }
+                    acked ++;
+                }
+                SI446X_DEV_RX_RELEASE( &radio[0] );
+                break;
+            }
+        }
+        SI446X_SIM_RUN( 1000 );
+    }
+    BENCH_CHECK( acked == BENCH_ROUNDS, "every frame acknowledged" );
+    *mean = acked ? ( double )sum / acked : 0;
+}
+int main( void )
+{
+    static INT8U frame[2 + SI446X_STREAM_MAX_LEN], buffer[2 + SI446X_STREAM_MAX_LEN];
+    const SI446X_RX_SLOT *slot;
+    const SI446X_TURNAROUND *turn;
+    SI446X_HOP_TABLE hops;
+    INT8U channels[4] = { 0, 5, 10, 15 }, status[9];
+    SI446X_SCAN scan[4];
+    SI446X_SEG seg[4];
+    BENCH_SOURCE source;
+    static SI446X_DEV radio[2];
+    INT32U hop, rearm, irqs;
+    uint64_t streamed, chunked;
+    INT16U i, length, r, kept;
+    BENCH b;
+
+    memset( &b, 0, sizeof( b ) );
+    SI446X_SIM_INIT( 1, 1 );
+    SI446X_SIM_SELECT( 0 );
+
+    printf( "%-26s %7s %6s %6s %9s %9s %10s\n", "path, per call", "bytes", "txns",
+            "cmds", "bus us", "cts us", "elapsed us" );
+
+    BENCH_MARK( &b );
+    SI446X_RESET( );
+    SI446X_CONFIG_INIT( );
+    BENCH_ADD( &b );
+    BENCH_PRINT( "CONFIG_INIT", &b );
+    BENCH_CHECK( SI446X_SIM_STATE( ) == STATE_READY, "radio ready after CONFIG_INIT" );
+    BENCH_CHECK( SI446X_SHADOW_VERIFY( ) == 0, "property shadow matches the radio" );
+    {
+        const SI446X_PROFILE fast = { bench_fast_stream, 40000, -80 };
+
+        // RX without a START_RX since the reset, nothing to re-arm it with
+        SI446X_CHANGE_STATE( STATE_RX );
+        SI446X_SIM_RUN( 1000 );
+        BENCH_CHECK( SI446X_PROFILE_LOAD( &fast ) == SI446X_ERR_STATE &&
+                     SI446X_SIM_STATE( ) == STATE_RX, "PROFILE_LOAD refused in RX it cannot re-arm" );
+        SI446X_CHANGE_STATE( STATE_READY );
+    }
+
+    // TX paths
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        BENCH_FRAME( frame, 32, r );
+        BENCH_MARK( &b );
+        SI446X_SEND_PACKET( frame + 1, 32, BENCH_CHANNEL, 0 );
+        BENCH_ADD( &b );
+        BENCH_WAIT_TX( );
+    }
+    BENCH_PRINT( "SEND_PACKET 32", &b );
+    SI446X_INT_STATUS( status );
+
+    // The same frame as appkey, dst, src and payload where they lie
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        BENCH_FRAME( frame, 32, r );
+        memcpy( buffer, frame, 34 );
+        seg[0].data = buffer + 1;   seg[0].length = 2;
+        seg[1].data = buffer + 3;   seg[1].length = 1;
+        seg[2].data = buffer + 4;   seg[2].length = 1;
+        seg[3].data = buffer + 5;   seg[3].length = 28;
+        BENCH_MARK( &b );
+        SI446X_SEND_SEG( seg, 4, BENCH_CHANNEL, 0 );
+        BENCH_ADD( &b );
+        BENCH_WAIT_TX( );
+        length = SI446X_SIM_LAST_FRAME( frame + 64 );
+        BENCH_CHECK( length == 33 && memcmp( frame + 64, frame, 33 ) == 0, "SEND_SEG frame" );
+        BENCH_CHECK( memcmp( buffer, frame, 34 ) == 0, "SEND_SEG leaves the buffers alone" );
+    }
+    BENCH_PRINT( "SEND_SEG 2+1+1+28", &b );
+    SI446X_INT_STATUS( status );
+
+    // The same frame with the payload made while it is written
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        BENCH_FRAME( frame, 32, r );
+        seg[0].data = frame + 1;
+        seg[0].length = 4;
+        source.data = frame + 5;
+        source.left = 28;
+        BENCH_MARK( &b );
+        SI446X_SEND_SOURCE( seg, 1, BENCH_SOURCE_NEXT, &source, 28, BENCH_CHANNEL, 0 );
+        BENCH_ADD( &b );
+        BENCH_WAIT_TX( );
+        length = SI446X_SIM_LAST_FRAME( frame + 64 );
+        BENCH_CHECK( length == 33 && memcmp( frame + 64, frame, 33 ) == 0, "SEND_SOURCE frame" );
+    }
+    BENCH_PRINT( "SEND_SOURCE 4+16+12", &b );
+    SI446X_INT_STATUS( status );
+
+    // Blocks left in flight as on the board, the short last chunk follows one
+    SI446X_SIM_DMA_ASYNC( true );
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        BENCH_FRAME( frame, 24, r );
+        seg[0].data = frame + 1;
+        seg[0].length = 4;
+        source.data = frame + 5;
+        source.left = 20;
+        BENCH_MARK( &b );
+        SI446X_SEND_SOURCE( seg, 1, BENCH_SOURCE_NEXT, &source, 20, BENCH_CHANNEL, 0 );
+        BENCH_ADD( &b );
+        BENCH_WAIT_TX( );
+        length = SI446X_SIM_LAST_FRAME( frame + 64 );
+        BENCH_CHECK( length == 25 && memcmp( frame + 64, frame, 25 ) == 0,
+                     "SEND_SOURCE frame, async uDMA" );
+    }
+    BENCH_PRINT( "SEND_SOURCE 4+16+4 async", &b );
+    BENCH_CHECK( SI446X_SIM_STATS_GET( )->dma_conflicts == 0, "no bus access with a block in flight" );
+    SI446X_SIM_DMA_ASYNC( false );
+    SI446X_INT_STATUS( status );
+
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        BENCH_FRAME( frame, 32, r );
+        BENCH_MARK( &b );
+        SI446X_SEND_LISTEN( frame + 1, 32, BENCH_CHANNEL );
+        BENCH_ADD( &b );
+        BENCH_WAIT_TX( );
+        BENCH_CHECK( SI446X_SIM_STATE( ) == STATE_RX_TUNE || SI446X_SIM_STATE( ) == STATE_RX,
+                     "SEND_LISTEN falls into RX" );
+    }
+    BENCH_PRINT( "SEND_LISTEN 32", &b );
+    SI446X_TURNAROUND_MEASURE( frame + 1, 32, BENCH_CHANNEL );
+    turn = SI446X_TURNAROUND_GET( );
+    BENCH_CHECK( turn->count == 1, "turnaround measured" );
+    SI446X_INT_STATUS( status );
+
+    // Legacy RX path: poll, read, clear, re-arm
+    SI446X_START_RX( BENCH_CHANNEL, 0, 0, STATE_RX, STATE_RX, STATE_RX );
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        length = BENCH_FRAME( frame, 32, r );
+        SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+        SI446X_SIM_RUN( 50000 );
+        BENCH_MARK( &b );
+        SI446X_INT_STATUS( status );
+        length = SI446X_READ_PACKET( buffer );
+        SI446X_START_RX( BENCH_CHANNEL, 0, 0, STATE_RX, STATE_RX, STATE_RX );
+        BENCH_ADD( &b );
+        BENCH_CHECK( ( status[2] & PH_PACKET_RX ) && length == 32 &&
+                     memcmp( buffer, frame + 1, 32 ) == 0, "READ_PACKET payload" );
+    }
+    BENCH_PRINT( "READ_PACKET 32 + re-arm", &b );
+
+    // RX engine, the handler cost per packet
+    SI446X_RX_ENGINE_START( BENCH_CHANNEL );
+    SI446X_SIM_RUN( 1000 );
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        length = BENCH_FRAME( frame, 32, r );
+        SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+        BENCH_MARK( &b );
+        SI446X_SIM_RUN( 50000 );
+        BENCH_ADD( &b );
+        slot = SI446X_RX_PEEK( );
+        BENCH_CHECK( slot && slot->length == 32 && memcmp( slot->data, frame + 1, 32 ) == 0,
+                     "RX engine payload" );
+        if( slot )  { SI446X_RX_RELEASE( ); }
+    }
+    b.elapsed = 0;                  //air time, not driver time
+    BENCH_PRINT( "RX engine 32 (handler)", &b );
+
+    // Back to back burst into the ring
+    for( r = 0; r < SI446X_RX_RING_SIZE; r ++ )
+    {
+        length = BENCH_FRAME( frame, 40, r );
+        SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+    }
+    SI446X_SIM_RUN( 500000 );
+    for( r = 0; SI446X_RX_PEEK( ); r ++ )   { SI446X_RX_RELEASE( ); }
+    BENCH_CHECK( r == SI446X_RX_RING_SIZE, "RX engine keeps a back to back burst" );
+
+    // Bad frames alternating with good ones, the radio re-arms by itself
+    for( r = 0; r < 4; r ++ )
+    {
+        length = BENCH_FRAME( frame, 24, r );
+        SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, true );
+        SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+    }
+    BENCH_MARK( &b );
+    SI446X_SIM_RUN( 500000 );
+    BENCH_ADD( &b );
+    b.calls = 8;
+    b.elapsed = 0;
+    BENCH_PRINT( "RX engine, half CRC bad", &b );
+    for( r = 0; ( slot = SI446X_RX_PEEK( ) ) != NULL; r ++ )
+    {
+        BENCH_FRAME( frame, 24, r );
+        BENCH_CHECK( slot->length == 24 && memcmp( slot->data, frame + 1, 24 ) == 0,
+                     "only good frames reach the ring" );
+        SI446X_RX_RELEASE( );
+    }
+    BENCH_CHECK( r == 4 && SI446X_RX_STATS_GET( )->crc_errors == 4,
+                 "bad frames dropped, the good ones behind them kept" );
+
+    // A good frame too long to fit behind a bad one overflows the FIFO
+    {
+        INT32U dropped = SI446X_RX_STATS_GET( )->dropped;
+
+        length = BENCH_FRAME( frame, 40, 0 );
+        SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, true );
+        SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+        SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+        SI446X_SIM_RUN( 500000 );
+        for( r = 0; SI446X_RX_PEEK( ); r ++ )   { SI446X_RX_RELEASE( ); }
+        BENCH_CHECK( r == 1 && SI446X_RX_STATS_GET( )->crc_errors == 5 &&
+                     SI446X_RX_STATS_GET( )->dropped == dropped + 1,
+                     "RX FIFO overflow flushed, the next frame received" );
+    }
+    BENCH_CHECK( SI446X_SIM_STATE( ) == STATE_RX, "radio still in RX" );
+
+    // A frame complete in the RX FIFO while nIRQ is held off, then a send
+    Si4463_BUS_IRQ_MASK( &g_sSi4463Bus0, BOOL_TRUE );
+    length = BENCH_FRAME( frame, 40, 9 );
+    SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+    SI446X_SIM_RUN( 50000 );
+    seg[0].data = buffer;
+    seg[0].length = 24;
+    BENCH_CHECK( SI446X_SEND_SEG( seg, 1, BENCH_CHANNEL, STATE_RX << 4 ) == SI446X_OK, "SEND_SEG" );
+    Si4463_BUS_IRQ_MASK( &g_sSi4463Bus0, BOOL_FALSE );
+    SI446X_SIM_RUN( 50000 );
+    slot = SI446X_RX_PEEK( );
+    BENCH_CHECK( slot && slot->length == 40 && memcmp( slot->data, frame + 1, 40 ) == 0,
+                 "a frame waiting for its PACKET_RX survives a send" );
+    if( slot )  { SI446X_RX_RELEASE( ); }
+    BENCH_CHECK( SI446X_RX_PEEK( ) == NULL && SI446X_RX_ENGINE_TX_DONE( ), "and the send went out" );
+
+    // Busy channel, one frame in eight for this node and one broadcast
+    for( i = 0; i < 2; i ++ )
+    {
+        if( i ) { SI446X_ADDRESS_FILTER( 0x01, 0xFF ); }
+        irqs = SI446X_RX_STATS_GET( )->irqs;
+        kept = 0;
+        BENCH_MARK( &b );
+        for( r = 0; r < 16; r ++ )
+        {
+            length = BENCH_FRAME( frame, 40, r );
+            frame[SI446X_DST_OFFSET] = r == 15 ? 0xFF : r % 8;
+            SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+            SI446X_SIM_RUN( 60000 );
+            if( SI446X_RX_PEEK( ) ) { kept ++; SI446X_RX_RELEASE( ); }
+        }
+        BENCH_ADD( &b );
+        irqs = SI446X_RX_STATS_GET( )->irqs - irqs;
+        printf( "%-26s %7.1f SPI bytes and %u irqs per 16 frames\n",
+                i ? "busy channel, filtered" : "busy channel, unfiltered",
+                ( double )b.sum.spi_bytes, irqs );
+        BENCH_CHECK( kept == ( i ? 3 : 16 ), "frames for this node and broadcast kept" );
+        BENCH_CHECK( irqs == ( i ? 3u : 16u ), "one interrupt per frame kept" );
+        memset( &b, 0, sizeof( b ) );
+    }
+    BENCH_CHECK( SI446X_SIM_STATS_GET( )->frames_filtered == 13, "other nodes' frames dropped by the radio" );
+    SI446X_ADDRESS_FILTER_OFF( );
+    SI446X_RX_ENGINE_STOP( );
+
+    // Stream frames
+    SI446X_STREAM_MODE( BOOL_TRUE );
+    for( i = 0; i < 1000; i ++ )    { frame[i] = i * 7; }
+    for( r = 0; r < 4; r ++ )
+    {
+        BENCH_MARK( &b );
+        BENCH_CHECK( SI446X_STREAM_SEND( frame, 1000, BENCH_CHANNEL, 0 ) == SI446X_OK,
+                     "STREAM_SEND" );
+        BENCH_ADD( &b );
+        BENCH_WAIT_TX( );
+    }
+    streamed = b.elapsed / b.calls;     //the call returns once the frame is sent
+    BENCH_CHECK( b.sum.spi_bytes / b.calls < 2000,
+                 "STREAM_SEND moves the FIFO from nIRQ, no polling" );
+    BENCH_PRINT( "STREAM_SEND 1000", &b );
+
+    SI446X_START_RX( BENCH_CHANNEL, 0, 0, STATE_RX, STATE_RX, STATE_RX );
+    buffer[0] = 1000 >> 8;
+    buffer[1] = 1000 & 0xFF;
+    memcpy( buffer + 2, frame, 1000 );
+    for( r = 0; r < 4; r ++ )
+    {
+        SI446X_SIM_INJECT( BENCH_CHANNEL, buffer, 1002, BENCH_RSSI, false );
+        BENCH_MARK( &b );
+        length = SI446X_STREAM_READ( frame + 1024, 1000, 1000000 );
+        BENCH_ADD( &b );
+        BENCH_CHECK( length == 1000 && memcmp( frame + 1024, frame, 1000 ) == 0,
+                     "STREAM_READ payload" );
+        SI446X_START_RX( BENCH_CHANNEL, 0, 0, STATE_RX, STATE_RX, STATE_RX );
+    }
+    BENCH_PRINT( "STREAM_READ 1000", &b );
+    SI446X_STREAM_MODE( BOOL_FALSE );
+
+    // The same 1000 bytes as normal frames, one SEND_PACKET after the other
+    for( r = 0; r < 4; r ++ )
+    {
+        BENCH_MARK( &b );
+        for( i = 0; i < 1000; i += length )
+        {
+            length = GetMin( 1000 - i, VMX_MAX_BUFFER + 4 );
+            SI446X_SEND_PACKET( frame + i, length, BENCH_CHANNEL, 0 );
+            BENCH_WAIT_TX( );
+        }
+        BENCH_ADD( &b );
+    }
+    chunked = b.elapsed / b.calls;
+    BENCH_PRINT( "SEND_PACKET 1000, chunks", &b );
+    printf( "%-26s %7.1f kbit/s streamed, %.1f kbit/s in SEND_PACKET chunks\n",
+            "goodput 1000 bytes", 8000.0 * 1e6 / streamed, 8000.0 * 1e6 / chunked );
+    BENCH_CHECK( streamed < chunked, "one stream frame beats chunked SEND_PACKET" );
+
+    // Channel changes
+    SI446X_HOP_TABLE_INIT( &hops, channels, 4 );
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        BENCH_MARK( &b );
+        SI446X_START_RX( channels[r % 4], 0, 0, STATE_RX, STATE_RX, STATE_RX );
+        SI446X_WAIT_CTS( );
+        BENCH_ADD( &b );
+    }
+    BENCH_PRINT( "channel by START_RX", &b );
+    SI446X_SIM_RUN( 1000 );
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        BENCH_MARK( &b );
+        SI446X_HOP_NEXT( &hops );
+        SI446X_WAIT_CTS( );
+        BENCH_ADD( &b );
+        SI446X_SIM_RUN( 100 );
+    }
+    BENCH_PRINT( "channel by RX_HOP", &b );
+    SI446X_HOP_BENCH( &hops, 2, &hop, &rearm );
+    BENCH_CHECK( hop < rearm, "RX_HOP faster than START_RX" );
+
+    // Energy scan, listen before talk
+    SI446X_SIM_NOISE( 0, 90 );
+    SI446X_SIM_NOISE( 5, 70 );      //-95 dBm, the quietest
+    SI446X_SIM_NOISE( 10, 100 );
+    SI446X_SIM_NOISE( 15, 80 );
+    BENCH_MARK( &b );
+    BENCH_CHECK( SI446X_ENERGY_SCAN( channels, 4, 1000, 8, scan ) == SI446X_OK, "ENERGY_SCAN" );
+    BENCH_ADD( &b );
+    BENCH_PRINT( "ENERGY_SCAN 4 x 8", &b );
+    BENCH_CHECK( channels[SI446X_SCAN_QUIETEST( scan, 4 )] == 5, "quietest channel found" );
+    SI446X_SIM_NOISE( BENCH_CHANNEL, 40 );
+
+    length = BENCH_FRAME( frame, 56, 3 );
+    SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+    SI446X_SIM_RUN( 2000 );
+    BENCH_CHECK( !SI446X_CCA( BENCH_CHANNEL, SI446X_CCA_THRESHOLD_DBM, 200 ),
+                 "CCA busy while a frame is on air" );
+    SI446X_SIM_RUN( 100000 );
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        BENCH_MARK( &b );
+        BENCH_CHECK( SI446X_CCA( BENCH_CHANNEL, SI446X_CCA_THRESHOLD_DBM, 200 ),
+                     "CCA clear on an idle channel" );
+        BENCH_ADD( &b );
+    }
+    BENCH_PRINT( "CCA 200 us", &b );
+    for( r = 0; r < 4; r ++ )
+    {
+        length = BENCH_FRAME( frame, 32, r );
+        BENCH_MARK( &b );
+        BENCH_CHECK( SI446X_SEND_PACKET_LBT( frame + 1, 32, BENCH_CHANNEL, 0 ) == SI446X_OK,
+                     "SEND_PACKET_LBT" );
+        BENCH_ADD( &b );
+        BENCH_WAIT_TX( );
+    }
+    BENCH_PRINT( "SEND_PACKET_LBT 32", &b );
+    SI446X_SIM_NOISE( BENCH_CHANNEL, 200 );
+    BENCH_CHECK( SI446X_SEND_PACKET_LBT( frame + 1, 32, BENCH_CHANNEL, 0 ) == SI446X_ERR_BUSY,
+                 "SEND_PACKET_LBT gives up on a jammed channel" );
+    BENCH_CHECK( SI446X_LBT_STATS_GET( )->gave_up == 1, "LBT statistics" );
+    SI446X_SIM_NOISE( BENCH_CHANNEL, 40 );
+
+    // Properties
+    for( r = 0; r < BENCH_ROUNDS; r ++ )
+    {
+        BENCH_MARK( &b );
+        SI446X_GET_PROPERTY_1( PKT_LEN );
+        BENCH_ADD( &b );
+    }
+    BENCH_PRINT( "GET_PROPERTY_1 (shadow)", &b );
+    BENCH_MARK( &b );
+    SI446X_SHADOW_VERIFY( );
+    BENCH_ADD( &b );
+    BENCH_PRINT( "SHADOW_VERIFY", &b );
+
+    // Modem profile switch in RX, there and back
+    {
+        const SI446X_PROFILE profiles[2] =
+        {
+            *SI446X_PROFILE_BASE( ), { bench_fast_stream, 40000, -80 }
+        };
+        const SI446X_PROFILE_STATS *ps = SI446X_PROFILE_STATS_GET( );
+        SI446X_PROFILE_STATS fast;
+
+        SI446X_RX_ENGINE_START( BENCH_CHANNEL );
+        SI446X_SIM_RUN( 1000 );
+        BENCH_CHECK( SI446X_PROFILE_FOR_RSSI( profiles, 2, -70 ) == 1 &&
+                     SI446X_PROFILE_FOR_RSSI( profiles, 2, -100 ) == 0, "profile for RSSI" );
+        for( r = 0; r < 3; r ++ )
+        {
+            BENCH_MARK( &b );
+            BENCH_CHECK( SI446X_PROFILE_LOAD( &profiles[r == 0] ) == SI446X_OK, "PROFILE_LOAD" );
+            BENCH_ADD( &b );
+            if( r == 0 )    { fast = *ps; }
+            BENCH_PRINT( r == 0 ? "PROFILE_LOAD fast" : r == 1 ? "PROFILE_LOAD base" :
+                         "PROFILE_LOAD base again", &b );
+            BENCH_CHECK( ps->written == ( r < 2 ? 5 : 0 ) && ps->commands == ( r < 2 ? 2 : 0 ),
+                         "profile switch writes only the differences" );
+            SI446X_SIM_RUN( 1000 );
+            BENCH_CHECK( SI446X_SIM_STATE( ) == STATE_RX, "RX re-armed after the switch" );
+        }
+        BENCH_CHECK( SI446X_SHADOW_VERIFY( ) == 0, "shadow matches after the switches" );
+        printf( "profile switch to fast: %u of %u properties, %.1f us\n", fast.written, fast.props,
+                fast.last / ( double )( SI446X_SIM_SYSCLK_HZ / 1000000 ) );
+        SI446X_RX_ENGINE_STOP( );
+    }
+
+    printf( "\nturnaround TX end to RX %.1f us, air time %.1f us\n",
+            turn->last / ( double )( SI446X_SIM_SYSCLK_HZ / 1000000 ),
+            turn->airtime / ( double )( SI446X_SIM_SYSCLK_HZ / 1000000 ) );
+    printf( "channel change RX_HOP %.1f us, START_RX %.1f us\n",
+            hop / ( double )( SI446X_SIM_SYSCLK_HZ / 1000000 ),
+            rearm / ( double )( SI446X_SIM_SYSCLK_HZ / 1000000 ) );
+    printf( "CTS waits %u, timeouts %u\n", SI446X_CTS_STATS_GET( )->waits,
+            SI446X_CTS_STATS_GET( )->timeouts );
+    printf( "radio: busy commands %u, FIFO errors %u\n",
+            SI446X_SIM_STATS_GET( )->busy_commands, SI446X_SIM_STATS_GET( )->fifo_errors );
+
+    BENCH_CHECK( SI446X_SIM_STATS_GET( )->busy_commands == 0, "no command sent while busy" );
+
+#if SI446X_TRACE
+    // Transaction tracer, against the radio's own count of windows
+    {
+        SI446X_TRACE_ENTRY entry[SI446X_TRACE_SIZE];
+        INT32U windows, traced = 0;
+        INT8U n;
+
+        SI446X_TRACE_CLEAR( );
+        windows = SI446X_SIM_STATS_GET( )->transactions;
+        for( r = 0; r < BENCH_ROUNDS; r ++ )
+        {
+            BENCH_FRAME( frame, 32, r );
+            SI446X_SEND_PACKET( frame + 1, 32, BENCH_CHANNEL, 0 );
+            BENCH_WAIT_TX( );
+        }
+        windows = SI446X_SIM_STATS_GET( )->transactions - windows;
+        SI446X_TRACE_HIST_GET( &n );
+        BENCH_CHECK( n > 0, "opcodes traced" );
+        printf( "\ntrace of %u x SEND_PACKET 32\n", BENCH_ROUNDS );
+        SI446X_TRACE_REPORT( );
+        length = SI446X_TRACE_READ( entry, SI446X_TRACE_SIZE );
+        for( i = 0; i < length; i ++ )  { traced += entry[i].bytes != 0; }
+        BENCH_CHECK( windows <= SI446X_TRACE_SIZE ? traced == windows : length == SI446X_TRACE_SIZE,
+                     "one trace entry per chip select window" );
+    }
+
+#endif
+    // Two more radios on buses of their own, receiving at the same time
+    SI446X_SIM_INIT( 3, 2 );
+    SI446X_SIM_SELECT( 2 );
+    SI446X_RESET( );
+    SI446X_CONFIG_INIT( );
+    for( i = 0; i < 2; i ++ )
+    {
+        SI446X_SIM_RADIO_UP( &radio[i], i );
+        SI446X_DEV_RX_ENGINE_START( &radio[i], channels[i + 1] );
+    }
+    SI446X_SIM_RUN( 1000 );
+    length = BENCH_FRAME( frame, 24, 7 );
+    SI446X_SIM_INJECT( channels[1], frame, length, BENCH_RSSI, false );
+    SI446X_SEND_PACKET( frame + 1, 24, channels[2], 0 );
+    SI446X_SIM_RUN( 50000 );
+    for( i = 0; i < 2; i ++ )
+    {
+        slot = SI446X_DEV_RX_PEEK( &radio[i] );
+        BENCH_CHECK( slot && slot->length == 24 && memcmp( slot->data, frame + 1, 24 ) == 0,
+                     "each radio receives on its own channel" );
+        if( slot )  { SI446X_DEV_RX_RELEASE( &radio[i] ); }
+        BENCH_CHECK( SI446X_DEV_RX_PEEK( &radio[i] ) == NULL, "and nothing else" );
+        SI446X_DEV_RX_ENGINE_STOP( &radio[i] );
+    }
+
+    // ACKs sent by the main loop, then by the nIRQ handler
+    {
+        const SI446X_ACK_STATS *ack;
+        double mean, max;
+
+        BENCH_ACK_RUN( radio, BOOL_FALSE, &mean, &max );
+        printf( "\nACK round trip, main loop every %u us: mean %.0f us, max %.0f us\n",
+                BENCH_ACK_LOOP_US, mean, max );
+        BENCH_ACK_RUN( radio, BOOL_TRUE, &mean, &max );
+        printf( "ACK round trip, auto-ACK: mean %.0f us, max %.0f us\n", mean, max );
+        ack = SI446X_DEV_AUTO_ACK_STATS_GET( &radio[1] );
+        printf( "auto-ACK nIRQ to START_TX: %u acked, last %.1f us, max %.1f us, bins of %u us:",
+                ack->acked, ack->last / ( double )( SI446X_SIM_SYSCLK_HZ / 1000000 ),
+                ack->max / ( double )( SI446X_SIM_SYSCLK_HZ / 1000000 ), SI446X_ACK_BIN_US );
+        for( i = 0; i < SI446X_ACK_BINS; i ++ ) { printf( " %u", ack->bin[i] ); }
+        printf( "\n" );
+        BENCH_CHECK( ack->acked == BENCH_ROUNDS && ack->skipped == 0, "auto-ACK answered every frame" );
+        BENCH_CHECK( SI446X_DEV_RX_ENGINE_TX_DONE( &radio[1] ) == BOOL_FALSE, "ACKs not reported as sends" );
+        SI446X_DEV_RX_ENGINE_STOP( &radio[1] );
+    }
+
+    // Duplicate suppression: src, seq and whether the packet is new
+    {
+        static const SI446X_DEDUP_RULE rule = { 5, 4, 0xFF, 0x01, 3, 0 }; //seq of DATA frames, by src
+        static const INT8U sequence[][3] =
+        {
+            { 0x20, 0, 1 }, { 0x20, 1, 1 }, { 0x20, 1, 0 }, { 0x20, 0, 0 },
+            { 0x20, 5, 1 }, { 0x20, 3, 1 }, { 0x20, 3, 0 }, { 0x21, 5, 1 },
+            { 0x20, 30, 1 }, { 0x20, 240, 1 }, { 0x20, 240, 0 }, { 0x21, 5, 0 },
+        };
+        INT32U delivered = 0, expected = 0;
+
+        SI446X_SIM_INIT( 1, 4 );
+        SI446X_RESET( );
+        SI446X_CONFIG_INIT( );
+        SI446X_RX_ENGINE_START( BENCH_CHANNEL );
+        BENCH_CHECK( SI446X_DEDUP_ON( &rule ) == SI446X_OK, "duplicate suppression on" );
+        SI446X_SIM_RUN( 1000 );
+        length = BENCH_FRAME( frame, 40, 0 );
+        frame[5] = 0x01;
+        for( i = 0; i < sizeof( sequence ) / sizeof( sequence[0] ); i ++ )
+        {
+            frame[4] = sequence[i][0];
+            frame[6] = sequence[i][1];
+            SI446X_SIM_INJECT( BENCH_CHANNEL, frame, length, BENCH_RSSI, false );
+            SI446X_SIM_RUN( 50000 );
+            expected += sequence[i][2];
+            while( ( slot = SI446X_RX_PEEK( ) ) != NULL )
+            {
+                BENCH_CHECK( sequence[i][2] && slot->data[3] == sequence[i][0] &&
+                             slot->data[5] == sequence[i][1], "only new packets delivered" );
+                delivered ++;
+                SI446X_RX_RELEASE( );
+            }
+        }
+        printf( "\nduplicates: %u delivered, %u dropped, %u restarts\n", delivered,
+                SI446X_RX_STATS_GET( )->duplicates, SI446X_RX_STATS_GET( )->seq_restarts );
+        BENCH_CHECK( delivered == expected && SI446X_RX_STATS_GET( )->duplicates == i - expected,
+                     "every duplicate dropped" );
+        BENCH_CHECK( SI446X_RX_STATS_GET( )->seq_restarts == 1, "jump back taken as a restart" );
+        SI446X_DEDUP_OFF( );
+        SI446X_RX_ENGINE_STOP( );
+    }
+    return failures ? 1 : 0;
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
@@ -63,6 +63,83 @@ typedef enum
 }SI446X_CMD_X;
 
 
+//  fast response register sources, FRR_CTL_x_MODE
+typedef enum
+{
+    FRR_MODE_DISABLED       = 0x00,
+    FRR_MODE_INT_STATUS     = 0x01,
+    FRR_MODE_INT_PEND       = 0x02,
+    FRR_MODE_INT_PH_STATUS  = 0x03,
+    FRR_MODE_INT_PH_PEND    = 0x04,
+    FRR_MODE_INT_MODEM_STATUS   = 0x05,
+    FRR_MODE_INT_MODEM_PEND     = 0x06,
+    FRR_MODE_INT_CHIP_STATUS    = 0x07,
+    FRR_MODE_INT_CHIP_PEND      = 0x08,
+    FRR_MODE_CURRENT_STATE  = 0x09,
+    FRR_MODE_LATCHED_RSSI   = 0x0A
+
+}SI446X_FRR_MODE;
+
+
+//  packet handler interrupt bits, INT_PH_STATUS/INT_PH_PEND
+typedef enum
+{
+    PH_FILTER_MATCH         = 0x80,
+    PH_FILTER_MISS          = 0x40,
+    PH_PACKET_SENT          = 0x20,
+    PH_PACKET_RX            = 0x10,
+    PH_CRC_ERROR            = 0x08,
+    PH_ALT_CRC_ERROR        = 0x04,
+    PH_TX_FIFO_ALMOST_EMPTY = 0x02,
+    PH_RX_FIFO_ALMOST_FULL  = 0x01
+
+}SI446X_PH_INT;
+
+
+//  modem interrupt bits, INT_MODEM_STATUS/INT_MODEM_PEND
+typedef enum
+{
+    MODEM_POSTAMBLE_DETECT  = 0x40,
+    MODEM_INVALID_SYNC      = 0x20,
+    MODEM_RSSI_JUMP         = 0x10,
+    MODEM_RSSI              = 0x08,
+    MODEM_INVALID_PREAMBLE  = 0x04,
+    MODEM_PREAMBLE_DETECT   = 0x02,
+    MODEM_SYNC_DETECT       = 0x01
+
+}SI446X_MODEM_INT;
+
+
+//  chip interrupt bits, INT_CHIP_STATUS/INT_CHIP_PEND
+typedef enum
+{
+    CHIP_CAL                = 0x40,
+    CHIP_FIFO_UNDERFLOW_OVERFLOW_ERROR = 0x20,
+    CHIP_STATE_CHANGE       = 0x10,
+    CHIP_CMD_ERROR          = 0x08,
+    CHIP_READY              = 0x04,
+    CHIP_LOW_BATT           = 0x02,
+    CHIP_WUT                = 0x01
+
+}SI446X_CHIP_INT;
+
+
+//  device states, CHANGE_STATE/REQUEST_DEVICE_STATE/START_xX next states
+typedef enum
+{
+    STATE_NO_CHANGE         = 0x00,
+    STATE_SLEEP             = 0x01,
+    STATE_SPI_ACTIVE        = 0x02,
+    STATE_READY             = 0x03,
+    STATE_READY2            = 0x04,
+    STATE_TX_TUNE           = 0x05,
+    STATE_RX_TUNE           = 0x06,
+    STATE_TX                = 0x07,
+    STATE_RX                = 0x08
+
+}SI446X_STATE;
+
+
 //  priority for SI446x
 typedef enum
 {
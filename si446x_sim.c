@@ -0,0 +1,1225 @@
+/*
+================================================================================
+Function : Host simulation of the Si4463 and of the board functions it uses
+================================================================================
+*/
+
+#include <stdarg.h>
+
+#include "Board.h"
+#include "si446x_defs.h"
+#include "si446x.h"
+
+uint32_t g_ui32SysClock = SI446X_SIM_SYSCLK_HZ;
+
+#define SIM_GROUPS          0x52    //property groups 0x00..0x51
+#define SIM_FIFO_SIZE       64
+#define SIM_SOURCES         ( SI446X_SIM_RADIOS + 1 )   //radios and the injector
+#define SIM_INJECTOR        SI446X_SIM_RADIOS
+#define SIM_SPI_BYTE_NS     ( 8000000000ULL / SI446X_SIM_SPI_HZ )
+#define SIM_POR_NS          1000000ULL  //SDN released to CTS
+#define SIM_TX_TUNE_NS      80000ULL    //START_TX to the first preamble bit
+#define SIM_RX_TUNE_NS      80000ULL    //START_RX to RX
+#define SIM_HOP_NS          40000ULL    //RX_HOP to RX
+#define SIM_CRC_BYTES       2
+#define SIM_NOISE_RSSI      40          //-110 dBm
+#define SIM_LINK_RSSI       0xC0        //-34 dBm, radios next to each other
+#define SIM_CAPTURE_RSSI    20          //10 dB: a frame this much louder survives a collision
+
+/*One radio*/
+typedef struct
+{
+    /*chip*/
+    bool     shutdown;
+    uint8_t  state;
+    uint8_t  channel;
+    uint8_t  prop[SIM_GROUPS][256];
+    uint64_t cts_at;            //CTS rises at this time
+    uint8_t  resp[16];          //response of the last command
+
+    /*SPI window*/
+    bool     selected;
+    bool     busy;              //the window started while CTS was low
+    bool     read_cts;          //READ_CMD_BUFF found CTS high
+    uint16_t nbytes;
+    uint8_t  cmd[16];
+
+    /*FIFOs*/
+    uint8_t  tx_fifo[SIM_FIFO_SIZE];
+    uint8_t  tx_head, tx_count;
+    bool     tx_empty;          //TX FIFO almost empty condition
+    uint8_t  rx_fifo[SIM_FIFO_SIZE];
+    uint8_t  rx_head, rx_count;
+    bool     rx_full;           //RX FIFO almost full condition
+
+    /*interrupts*/
+    uint8_t  ph_pend, modem_pend, chip_pend;
+    bool     nirq_low;
+    bool     irq_edge;          //falling edge not yet served
+    bool     irq_masked;
+    bool     in_irq;
+    SI4463_BUS_CALLBACK irq;
+    void    *irq_arg;
+
+    /*tuning, TX and RX*/
+    uint64_t tune_at;           //0, or the time the synthesizer settles
+    uint8_t  tune_to;           //STATE_TX or STATE_RX
+    uint8_t  prior_state;       //state START_TX was issued in
+    uint8_t  tx_complete;       //TXCOMPLETE_STATE
+    uint16_t tx_len, tx_left;
+    uint8_t  tx_phase;          //0 idle, 1 preamble and data, 2 CRC
+    uint64_t tx_next;
+    bool     tx_bad;
+    uint8_t  rx_args[7];        //arguments of the last START_RX
+    int8_t   rx_src;            //source the receiver locked on, -1 for none
+    bool     rx_bad;
+    uint16_t rx_len;
+    uint8_t  rx_match[32];      //first bytes of the frame, for the packet match
+    uint8_t  latched_rssi;
+    uint16_t last_len;
+
+    SI446X_SIM_STATS stats;
+}SIM_RADIO;
+
+/*A frame waiting to be injected*/
+typedef struct
+{
+    uint8_t  channel;
+    uint8_t  rssi;
+    bool     corrupt;
+    uint16_t size;
+    uint8_t  data[2 + 8191];
+}SIM_FRAME;
+
+static struct
+{
+    uint8_t   radios;
+    uint8_t   cur;
+    uint64_t  now;
+    uint64_t  byte_ns;          //air time of one byte
+    uint8_t   loss;
+    uint32_t  seed;
+    uint8_t   noise[SI446X_SIM_CHANNELS];
+    SIM_RADIO radio[SI446X_SIM_RADIOS];
+
+    /*what radio a hears from radio b: RSSI, 0 out of range, and frame loss %*/
+    struct
+    {
+        uint8_t rssi;
+        uint8_t loss;
+    }link[SI446X_SIM_RADIOS][SI446X_SIM_RADIOS];
+
+    /*transmissions on the air, per source*/
+    struct
+    {
+        bool    on;
+        uint8_t channel;
+        uint8_t rssi;
+        uint16_t size;          //bytes of the frame so far
+        uint8_t frame[2 + 8191];
+    }air[SIM_SOURCES];
+
+    /*the injector, a transmitter outside the simulated radios*/
+    SIM_FRAME queue[SI446X_SIM_INJECT_QUEUE];
+    uint8_t   q_head, q_count;
+    uint16_t  inj_pos;
+    uint64_t  inj_next;
+    uint8_t   inj_phase;        //0 idle, 1 preamble and data, 2 CRC
+
+    /*blocks left in flight by SI446X_SIM_DMA_ASYNC, per bus, bus 0 last*/
+    bool      dma_async;
+    struct
+    {
+        const INT8U *txbuf;
+        INT8U   *rxbuf;
+        INT16U  size;
+        SPI_BLOCK_CALLBACK callback;
+    }dma[SI446X_SIM_RADIOS + 1];
+}sim;
+
+static void SIM_ADVANCE( uint64_t until );
+
+/*
+=================================================================================
+-------------------------------------Helpers-------------------------------------
+=================================================================================
+*/
+static uint32_t SIM_RANDOM( void )
+{
+    sim.seed ^= sim.seed << 13;
+    sim.seed ^= sim.seed >> 17;
+    sim.seed ^= sim.seed << 5;
+    return sim.seed;
+}
+static uint8_t SIM_PROP( SIM_RADIO *r, uint16_t prop )
+{
+    return r->prop[prop >> 8][prop & 0xFF];
+}
+/*Preamble and sync, sent before the first FIFO byte*/
+static uint64_t SIM_HEADER_NS( SIM_RADIO *r )
+{
+    uint8_t preamble = r ? SIM_PROP( r, PREAMBLE_TX_LENGTH ) : 8;
+    uint8_t sync = r ? ( SIM_PROP( r, SYNC_CONFIG ) & 0x03 ) + 1 : 2;
+
+    return ( uint64_t )( preamble + sync ) * sim.byte_ns;
+}
+static uint64_t SIM_CMD_NS( uint8_t op )
+{
+    switch( op )
+    {
+    case POWER_UP:          return 6000000;
+    case PART_INFO:
+    case FUNC_INFO:         return 20000;
+    case SET_PROPERTY:
+    case GET_PROPERTY:      return 25000;
+    case GPIO_PIN_CFG:      return 30000;
+    case FIFO_INFO:         return 10000;
+    case PACKET_INFO:       return 15000;
+    case GET_INT_STATUS:
+    case GET_PH_STATUS:
+    case GET_MODEM_STATUS:
+    case GET_CHIP_STATUS:   return 15000;
+    case START_TX:
+    case START_RX:          return 40000;
+    case RX_HOP:            return 10000;
+    case CHANGE_STATE:      return 20000;
+    case REQUEST_DEVICE_STATE:  return 10000;
+    default:                return 10000;
+    }
+}
+/*Power on reset of the property table*/
+static void SIM_DEFAULTS( SIM_RADIO *r )
+{
+    memset( r->prop, 0, sizeof( r->prop ) );
+    r->prop[0x01][0x00] = 0x04;     //INT_CTL_ENABLE
+    r->prop[0x02][0x00] = FRR_MODE_INT_STATUS;
+    r->prop[0x02][0x01] = FRR_MODE_INT_PH_PEND;
+    r->prop[0x02][0x02] = FRR_MODE_CURRENT_STATE;
+    r->prop[0x10][0x00] = 0x08;     //PREAMBLE_TX_LENGTH
+    r->prop[0x11][0x00] = 0x01;     //SYNC_CONFIG
+    r->prop[0x12][0x0B] = 0x30;     //PKT_TX_THRESHOLD
+    r->prop[0x12][0x0C] = 0x30;     //PKT_RX_THRESHOLD
+    r->prop[0x40][0x00] = 0x3C;     //FREQ_CONTROL_INTE
+    r->prop[0x40][0x01] = 0x08;
+    r->prop[0x40][0x06] = 0x20;     //FREQ_CONTROL_W_SIZE
+    r->prop[0x40][0x07] = 0xFF;
+}
+/*
+=================================================================================
+------------------------------------Interrupts-----------------------------------
+=================================================================================
+*/
+static void SIM_IRQ_UPDATE( SIM_RADIO *r )
+{
+    uint8_t enable = SIM_PROP( r, INT_CTL_ENABLE );
+    bool low;
+
+    low = ( ( enable & 0x01 ) && ( r->ph_pend & SIM_PROP( r, INT_CTL_PH_ENABLE ) ) ) ||
+          ( ( enable & 0x02 ) && ( r->modem_pend & SIM_PROP( r, INT_CTL_MODEM_ENABLE ) ) ) ||
+          ( ( enable & 0x04 ) && ( r->chip_pend & SIM_PROP( r, INT_CTL_CHIP_ENABLE ) ) );
+    if( low && !r->nirq_low )   { r->irq_edge = true; }
+    r->nirq_low = low;
+}
+/*Run the nIRQ handler of a radio if its edge is pending and unmasked*/
+static void SIM_IRQ_DISPATCH( SIM_RADIO *r )
+{
+    uint8_t saved = sim.cur;
+
+    while( r->irq_edge && r->irq && !r->irq_masked && !r->in_irq )
+    {
+        r->irq_edge = false;
+        r->in_irq = true;
+        sim.cur = ( uint8_t )( r - sim.radio );
+        r->irq( r->irq_arg );
+        sim.cur = saved;
+        r->in_irq = false;
+    }
+}
+static void SIM_CHIP_ERROR( SIM_RADIO *r, uint8_t bit )
+{
+    r->chip_pend |= bit;
+    if( bit == CHIP_FIFO_UNDERFLOW_OVERFLOW_ERROR )    { r->stats.fifo_errors ++; }
+    SIM_IRQ_UPDATE( r );
+}
+/*
+=================================================================================
+--------------------------------------FIFOs--------------------------------------
+=================================================================================
+*/
+static void SIM_FIFO_LEVELS( SIM_RADIO *r )
+{
+    bool empty = SIM_FIFO_SIZE - r->tx_count >= SIM_PROP( r, PKT_TX_THRESHOLD );
+    bool full = r->rx_count >= SIM_PROP( r, PKT_RX_THRESHOLD );
+
+    if( empty && !r->tx_empty ) { r->ph_pend |= PH_TX_FIFO_ALMOST_EMPTY; }
+    if( full && !r->rx_full )   { r->ph_pend |= PH_RX_FIFO_ALMOST_FULL; }
+    r->tx_empty = empty;
+    r->rx_full = full;
+    SIM_IRQ_UPDATE( r );
+}
+static void SIM_TX_PUSH( SIM_RADIO *r, uint8_t b )
+{
+    if( r->tx_count == SIM_FIFO_SIZE )
+    {
+        SIM_CHIP_ERROR( r, CHIP_FIFO_UNDERFLOW_OVERFLOW_ERROR );
+        return;
+    }
+    r->tx_fifo[( r->tx_head + r->tx_count ) % SIM_FIFO_SIZE] = b;
+    r->tx_count ++;
+    SIM_FIFO_LEVELS( r );
+}
+static bool SIM_TX_POP( SIM_RADIO *r, uint8_t *b )
+{
+    if( r->tx_count == 0 )  { return false; }
+    *b = r->tx_fifo[r->tx_head];
+    r->tx_head = ( r->tx_head + 1 ) % SIM_FIFO_SIZE;
+    r->tx_count --;
+    SIM_FIFO_LEVELS( r );
+    return true;
+}
+static bool SIM_RX_PUSH( SIM_RADIO *r, uint8_t b )
+{
+    if( r->rx_count == SIM_FIFO_SIZE )
+    {
+        SIM_CHIP_ERROR( r, CHIP_FIFO_UNDERFLOW_OVERFLOW_ERROR );
+        return false;
+    }
+    r->rx_fifo[( r->rx_head + r->rx_count ) % SIM_FIFO_SIZE] = b;
+    r->rx_count ++;
+    SIM_FIFO_LEVELS( r );
+    return true;
+}
+static uint8_t SIM_RX_POP( SIM_RADIO *r )
+{
+    uint8_t b;
+
+    if( r->rx_count == 0 )
+    {
+        SIM_CHIP_ERROR( r, CHIP_FIFO_UNDERFLOW_OVERFLOW_ERROR );
+        return 0;
+    }
+    b = r->rx_fifo[r->rx_head];
+    r->rx_head = ( r->rx_head + 1 ) % SIM_FIFO_SIZE;
+    r->rx_count --;
+    SIM_FIFO_LEVELS( r );
+    return b;
+}
+/*
+=================================================================================
+--------------------------------------Medium-------------------------------------
+=================================================================================
+*/
+/*RSSI radio i sees a source with, 0 if out of range*/
+static uint8_t SIM_HEARD( uint8_t src, uint8_t i )
+{
+    return src == SIM_INJECTOR ? sim.air[src].rssi : sim.link[i][src].rssi;
+}
+static uint8_t SIM_CURR_RSSI( SIM_RADIO *r )
+{
+    uint8_t rssi = sim.noise[r->channel % SI446X_SIM_CHANNELS], s, heard;
+
+    for( s = 0; s < SIM_SOURCES; s ++ )
+    {
+        if( !sim.air[s].on || sim.air[s].channel != r->channel )    { continue; }
+        heard = SIM_HEARD( s, ( uint8_t )( r - sim.radio ) );
+        if( heard > rssi )  { rssi = heard; }
+    }
+    return rssi;
+}
+/*A transmission starts: a frame being received on the channel collides,
+unless it is heard SIM_CAPTURE_RSSI louder than the new one*/
+static void SIM_AIR_START( uint8_t src, uint8_t channel, uint8_t rssi )
+{
+    SIM_RADIO *r;
+    uint8_t i;
+
+    sim.air[src].on = true;
+    sim.air[src].channel = channel;
+    sim.air[src].rssi = rssi;
+    for( i = 0; i < sim.radios; i ++ )
+    {
+        r = &sim.radio[i];
+        if( r->rx_src >= 0 && r->channel == channel && SIM_HEARD( src, i ) &&
+            SIM_HEARD( src, i ) + SIM_CAPTURE_RSSI > SIM_HEARD( ( uint8_t )r->rx_src, i ) )
+        {
+            r->rx_bad = true;
+        }
+    }
+}
+/*The sync word is over: receivers ready on the channel lock on the frame*/
+static void SIM_AIR_SYNC( uint8_t src )
+{
+    SIM_RADIO *r;
+    uint8_t i, loss;
+
+    for( i = 0; i < sim.radios; i ++ )
+    {
+        r = &sim.radio[i];
+        if( i == src || r->shutdown || r->state != STATE_RX || r->rx_src >= 0 ||
+            r->channel != sim.air[src].channel || !SIM_HEARD( src, i ) )
+        {
+            continue;
+        }
+        loss = src == SIM_INJECTOR || sim.loss > sim.link[i][src].loss ? sim.loss : sim.link[i][src].loss;
+        if( loss && SIM_RANDOM( ) % 100 < loss )
+        {
+            r->stats.frames_lost ++;
+            continue;
+        }
+        r->rx_src = src;
+        r->rx_bad = false;
+        r->rx_len = 0;
+        r->latched_rssi = SIM_HEARD( src, i );
+        r->modem_pend |= MODEM_SYNC_DETECT;
+        SIM_IRQ_UPDATE( r );
+    }
+}
+/*Packet match once the last byte it looks at has arrived, true until then*/
+static bool SIM_MATCH( SIM_RADIO *r )
+{
+    uint8_t ctrl, k, last = 0, byte;
+    bool result = true, hit;
+
+    if( !( SIM_PROP( r, MATCH_CTRL_1 ) & 0x80 ) )  { return true; }
+    for( k = 0; k < 4; k ++ )
+    {
+        ctrl = SIM_PROP( r, MATCH_CTRL_1 + 3 * k ) & 0x1F;
+        if( ctrl > last )   { last = ctrl; }
+    }
+    if( r->rx_len != last + 1u )    { return true; }
+
+    for( k = 0; k < 4; k ++ )
+    {
+        ctrl = SIM_PROP( r, MATCH_CTRL_1 + 3 * k );
+        byte = r->rx_match[ctrl & 0x1F] & SIM_PROP( r, MATCH_MASK_1 + 3 * k );
+        hit = ( byte == SIM_PROP( r, MATCH_VALUE_1 + 3 * k ) ) != ( ( ctrl & 0x40 ) != 0 );
+        if( k == 0 )            { result = hit; }
+        else if( ctrl & 0x80 )  { result = result || hit; }
+        else                    { result = result && hit; }
+    }
+    return result;
+}
+static void SIM_AIR_BYTE( uint8_t src, uint8_t b, bool first )
+{
+    SIM_RADIO *r;
+    uint8_t i;
+
+    if( first )
+    {
+        SIM_AIR_SYNC( src );
+        sim.air[src].size = 0;
+    }
+    if( sim.air[src].size < sizeof( sim.air[src].frame ) )
+    {
+        sim.air[src].frame[sim.air[src].size ++] = b;
+    }
+    for( i = 0; i < sim.radios; i ++ )
+    {
+        r = &sim.radio[i];
+        if( r->rx_src != src )  { continue; }
+        if( r->state != STATE_RX )
+        {
+            r->rx_src = -1;         //left RX in the middle of the frame
+            r->stats.frames_lost ++;
+            continue;
+        }
+        if( !SIM_RX_PUSH( r, b ) )  { r->rx_bad = true; }
+        if( r->rx_len < sizeof( r->rx_match ) ) { r->rx_match[r->rx_len] = b; }
+        r->rx_len ++;
+        if( !SIM_MATCH( r ) )
+        {
+            // Filter miss: the frame is dropped and the receiver hunts again
+            r->rx_count -= r->rx_count < r->rx_len ? r->rx_count : r->rx_len;
+            SIM_FIFO_LEVELS( r );
+            r->rx_src = -1;
+            r->ph_pend |= PH_FILTER_MISS;
+            r->stats.frames_filtered ++;
+            SIM_IRQ_UPDATE( r );
+        }
+    }
+}
+/*Apply a START_RX next state*/
+static void SIM_RX_NEXT( SIM_RADIO *r, uint8_t next )
+{
+    if( next != STATE_NO_CHANGE && next != STATE_RX )   { r->state = next; }
+}
+/*The packet handler checks a CRC on the payload field*/
+static bool SIM_CRC_CHECKED( SIM_RADIO *r )
+{
+    return ( SIM_PROP( r, PKT_CRC_CONFIG ) & 0x0F ) &&
+           ( SIM_PROP( r, PKT_FIELD_2_CRC_CONFIG ) & 0x0A ) == 0x0A;
+}
+/*The frame is over: the receivers locked on it check it, bad frames without
+a CRC are delivered like good ones*/
+static void SIM_AIR_END( uint8_t src, bool bad )
+{
+    SIM_RADIO *r;
+    uint8_t i;
+
+    sim.air[src].on = false;
+    for( i = 0; i < sim.radios; i ++ )
+    {
+        r = &sim.radio[i];
+        if( r->rx_src != src )  { continue; }
+        r->rx_src = -1;
+        r->last_len = r->rx_len;
+        if( ( bad || r->rx_bad ) && SIM_CRC_CHECKED( r ) )
+        {
+            r->ph_pend |= PH_CRC_ERROR;
+            r->stats.frames_bad ++;
+            SIM_RX_NEXT( r, r->rx_args[6] );
+        }
+        else
+        {
+            if( bad || r->rx_bad )  { r->stats.frames_bad ++; }
+            r->ph_pend |= PH_PACKET_RX;
+            r->stats.frames_received ++;
+            SIM_RX_NEXT( r, r->rx_args[5] );
+        }
+        SIM_IRQ_UPDATE( r );
+    }
+}
+/*
+=================================================================================
+-------------------------------------Radio model---------------------------------
+=================================================================================
+*/
+static void SIM_ENTER_RX( SIM_RADIO *r, uint64_t tune_ns )
+{
+    r->state = STATE_RX_TUNE;
+    r->tune_to = STATE_RX;
+    r->tune_at = sim.now + tune_ns;
+}
+/*TX is over: PACKET_SENT, then TXCOMPLETE_STATE*/
+static void SIM_TX_END( SIM_RADIO *r )
+{
+    uint8_t next = r->tx_complete;
+
+    SIM_AIR_END( ( uint8_t )( r - sim.radio ), r->tx_bad );
+    r->tx_phase = 0;
+    r->ph_pend |= PH_PACKET_SENT;
+    r->stats.frames_sent ++;
+    SIM_IRQ_UPDATE( r );
+
+    if( next == STATE_NO_CHANGE )   { next = r->prior_state; }
+    if( next == STATE_RX )          { SIM_ENTER_RX( r, SIM_RX_TUNE_NS ); }
+    else if( next == STATE_TX || next == STATE_NO_CHANGE )  { r->state = STATE_READY; }
+    else                            { r->state = next; }
+}
+/*Next pending event of a radio, 0 if none*/
+static uint64_t SIM_NEXT_EVENT( SIM_RADIO *r )
+{
+    uint64_t t = 0;
+
+    if( r->tune_at )                        { t = r->tune_at; }
+    if( r->tx_phase && ( !t || r->tx_next < t ) )   { t = r->tx_next; }
+    return t;
+}
+static void SIM_EVENT( SIM_RADIO *r )
+{
+    uint8_t b;
+
+    if( r->tune_at && r->tune_at <= sim.now )
+    {
+        r->tune_at = 0;
+        r->state = r->tune_to;
+        if( r->tune_to == STATE_TX )
+        {
+            SIM_AIR_START( ( uint8_t )( r - sim.radio ), r->channel, SIM_LINK_RSSI );
+            r->tx_phase = 1;
+            r->tx_bad = false;
+            r->tx_left = r->tx_len;
+            r->tx_next = sim.now + SIM_HEADER_NS( r );
+        }
+        return;
+    }
+    if( r->tx_phase == 1 && r->tx_next <= sim.now )
+    {
+        if( !SIM_TX_POP( r, &b ) )
+        {
+            // Underflow: the packet is aborted, receivers see a bad frame
+            SIM_CHIP_ERROR( r, CHIP_FIFO_UNDERFLOW_OVERFLOW_ERROR );
+            r->tx_bad = true;
+            r->tx_complete = STATE_READY;
+            SIM_TX_END( r );
+            return;
+        }
+        SIM_AIR_BYTE( ( uint8_t )( r - sim.radio ), b, r->tx_left == r->tx_len );
+        r->tx_next += sim.byte_ns;
+        if( -- r->tx_left == 0 )
+        {
+            r->tx_phase = 2;
+            r->tx_next += ( SIM_CRC_BYTES - 1 ) * sim.byte_ns;
+        }
+        return;
+    }
+    if( r->tx_phase == 2 && r->tx_next <= sim.now )
+    {
+        SIM_TX_END( r );
+    }
+}
+static void SIM_INJECT_EVENT( void )
+{
+    SIM_FRAME *f = &sim.queue[sim.q_head];
+    uint8_t b;
+
+    if( sim.inj_phase == 1 )
+    {
+        b = f->data[sim.inj_pos];
+        if( f->corrupt && sim.inj_pos + 1 == f->size )  { b ^= 0x5A; }
+        SIM_AIR_BYTE( SIM_INJECTOR, b, sim.inj_pos == 0 );
+        sim.inj_pos ++;
+        sim.inj_next += sim.byte_ns;
+        if( sim.inj_pos == f->size )
+        {
+            sim.inj_phase = 2;
+            sim.inj_next += ( SIM_CRC_BYTES - 1 ) * sim.byte_ns;
+        }
+        return;
+    }
+    SIM_AIR_END( SIM_INJECTOR, f->corrupt );
+    sim.inj_phase = 0;
+    sim.q_head = ( sim.q_head + 1 ) % SI446X_SIM_INJECT_QUEUE;
+    sim.q_count --;
+}
+static void SIM_INJECT_START( void )
+{
+    SIM_FRAME *f = &sim.queue[sim.q_head];
+
+    SIM_AIR_START( SIM_INJECTOR, f->channel, f->rssi );
+    sim.inj_phase = 1;
+    sim.inj_pos = 0;
+    sim.inj_next = sim.now + SIM_HEADER_NS( NULL );
+}
+/*Process every event up to until, in time order*/
+static void SIM_ADVANCE( uint64_t until )
+{
+    SIM_RADIO *first;
+    uint64_t t, best;
+    uint8_t i;
+
+    for( ;; )
+    {
+        if( sim.q_count && sim.inj_phase == 0 ) { SIM_INJECT_START( ); }
+
+        first = NULL;
+        best = until + 1;
+        for( i = 0; i < sim.radios; i ++ )
+        {
+            t = SIM_NEXT_EVENT( &sim.radio[i] );
+            if( t && t < best ) { best = t; first = &sim.radio[i]; }
+        }
+        if( sim.inj_phase && sim.inj_next < best )
+        {
+            best = sim.inj_next;
+            first = NULL;
+        }
+        if( best > until )  { break; }
+
+        if( best > sim.now )    { sim.now = best; }
+        if( first ) { SIM_EVENT( first ); }
+        else        { SIM_INJECT_EVENT( ); }
+    }
+    if( until > sim.now )   { sim.now = until; }
+}
+/*Start a radio after SDN is released*/
+static void SIM_POWER_ON( SIM_RADIO *r )
+{
+    SI4463_BUS_CALLBACK irq = r->irq;
+    void *irq_arg = r->irq_arg;
+    bool masked = r->irq_masked;
+    SI446X_SIM_STATS stats = r->stats;
+
+    memset( r, 0, sizeof( *r ) );
+    r->irq = irq;
+    r->irq_arg = irq_arg;
+    r->irq_masked = masked;
+    r->stats = stats;
+    r->rx_src = -1;
+    r->state = STATE_SPI_ACTIVE;
+    r->cts_at = sim.now + SIM_POR_NS;
+    SIM_DEFAULTS( r );
+    SIM_FIFO_LEVELS( r );
+}
+/*Fast response register, index 0 to 3 for A to D*/
+static uint8_t SIM_FRR( SIM_RADIO *r, uint8_t index )
+{
+    switch( SIM_PROP( r, FRR_CTL_A_MODE + index ) )
+    {
+    case FRR_MODE_INT_STATUS:
+    case FRR_MODE_INT_PEND:         return ( r->ph_pend ? 0x01 : 0 ) | ( r->modem_pend ? 0x02 : 0 ) |
+                                           ( r->chip_pend ? 0x04 : 0 );
+    case FRR_MODE_INT_PH_STATUS:
+    case FRR_MODE_INT_PH_PEND:      return r->ph_pend;
+    case FRR_MODE_INT_MODEM_STATUS:
+    case FRR_MODE_INT_MODEM_PEND:   return r->modem_pend;
+    case FRR_MODE_INT_CHIP_STATUS:
+    case FRR_MODE_INT_CHIP_PEND:    return r->chip_pend;
+    case FRR_MODE_CURRENT_STATE:    return r->state;
+    case FRR_MODE_LATCHED_RSSI:     return r->latched_rssi;
+    default:                        return 0;
+    }
+}
+/*Channel a RX_HOP frequency stands for, from the FREQ_CONTROL properties*/
+static uint8_t SIM_HOP_CHANNEL( SIM_RADIO *r, const uint8_t *arg )
+{
+    uint32_t base, n;
+    uint16_t step;
+
+    base = ( ( uint32_t )SIM_PROP( r, FREQ_CONTROL_INTE ) << 19 ) +
+           ( ( uint32_t )SIM_PROP( r, FREQ_CONTROL_FRAC_2 ) << 16 ) +
+           ( ( uint32_t )SIM_PROP( r, FREQ_CONTROL_FRAC_1 ) << 8 ) +
+           SIM_PROP( r, FREQ_CONTROL_FRAC_0 );
+    n = ( ( uint32_t )arg[0] << 19 ) + ( ( uint32_t )arg[1] << 16 ) +
+        ( ( uint32_t )arg[2] << 8 ) + arg[3];
+    step = ( ( uint16_t )SIM_PROP( r, FREQ_CONTROL_CHANNEL_STEP_SIZE_1 ) << 8 ) |
+           SIM_PROP( r, FREQ_CONTROL_CHANNEL_STEP_SIZE_0 );
+    if( step == 0 || n < base ) { return r->channel; }
+    return ( n - base ) / step;
+}
+/*Leave TX or RX, a frame in progress is cut*/
+static void SIM_ABORT( SIM_RADIO *r )
+{
+    if( r->tx_phase )
+    {
+        r->tx_bad = true;
+        SIM_AIR_END( ( uint8_t )( r - sim.radio ), true );
+        r->tx_phase = 0;
+    }
+    if( r->rx_src >= 0 )
+    {
+        r->rx_src = -1;
+        r->stats.frames_lost ++;
+    }
+    r->tune_at = 0;
+}
+static void SIM_EXECUTE( SIM_RADIO *r, const uint8_t *cmd, uint8_t n )
+{
+    uint8_t i, clear[3];
+    uint16_t prop;
+
+    memset( r->resp, 0, sizeof( r->resp ) );
+    r->stats.commands ++;
+    if( r->busy || ( r->state == STATE_SPI_ACTIVE && cmd[0] != POWER_UP ) )
+    {
+        r->stats.busy_commands ++;
+        SIM_CHIP_ERROR( r, CHIP_CMD_ERROR );
+        return;
+    }
+    r->cts_at = sim.now + SIM_CMD_NS( cmd[0] );
+
+    switch( cmd[0] )
+    {
+    case POWER_UP:
+        SIM_DEFAULTS( r );
+        r->state = STATE_READY;
+        break;
+    case NOP:
+        break;
+    case PART_INFO:
+        r->resp[0] = 0x11;          //CHIPREV
+        r->resp[1] = 0x44;          //PART 0x4463
+        r->resp[2] = 0x63;
+        r->resp[7] = 0x06;          //ROMID, rev B1
+        break;
+    case FUNC_INFO:
+        r->resp[0] = 0x06;
+        r->resp[5] = 0x01;          //FUNC, pro
+        break;
+    case SET_PROPERTY:
+        prop = ( ( uint16_t )cmd[1] << 8 ) | cmd[3];
+        for( i = 0; i < cmd[2] && 4 + i < n; i ++ )
+        {
+            if( ( prop >> 8 ) < SIM_GROUPS )    { r->prop[prop >> 8][( prop + i ) & 0xFF] = cmd[4 + i]; }
+        }
+        SIM_FIFO_LEVELS( r );
+        break;
+    case GET_PROPERTY:
+        for( i = 0; i < cmd[2] && i < 16; i ++ )
+        {
+            if( cmd[1] < SIM_GROUPS )   { r->resp[i] = r->prop[cmd[1]][( cmd[3] + i ) & 0xFF]; }
+        }
+        break;
+    case GPIO_PIN_CFG:
+        memcpy( r->resp, cmd + 1, n > 1 ? n - 1 : 0 );
+        break;
+    case FIFO_INFO:
+        if( n > 1 && ( cmd[1] & 0x01 ) )    { r->tx_head = r->tx_count = 0; }
+        if( n > 1 && ( cmd[1] & 0x02 ) )    { r->rx_head = r->rx_count = 0; }
+        SIM_FIFO_LEVELS( r );
+        r->resp[0] = r->rx_count;
+        r->resp[1] = SIM_FIFO_SIZE - r->tx_count;
+        break;
+    case PACKET_INFO:
+        r->resp[0] = r->last_len >> 8;
+        r->resp[1] = r->last_len;
+        break;
+    case GET_INT_STATUS:
+        r->resp[0] = ( r->ph_pend ? 0x01 : 0 ) |
+                     ( r->modem_pend ? 0x02 : 0 ) | ( r->chip_pend ? 0x04 : 0 );
+        r->resp[1] = r->resp[0];
+        r->resp[2] = r->resp[3] = r->ph_pend;
+        r->resp[4] = r->resp[5] = r->modem_pend;
+        r->resp[6] = r->resp[7] = r->chip_pend;
+        for( i = 0; i < 3; i ++ )   { clear[i] = n > 1 + i ? cmd[1 + i] : 0; }
+        r->ph_pend &= clear[0];
+        r->modem_pend &= clear[1];
+        r->chip_pend &= clear[2];
+        break;
+    case GET_PH_STATUS:
+        r->resp[0] = r->resp[1] = r->ph_pend;
+        r->ph_pend &= n > 1 ? cmd[1] : 0;
+        break;
+    case GET_MODEM_STATUS:
+        r->resp[0] = r->resp[1] = r->modem_pend;
+        r->resp[2] = SIM_CURR_RSSI( r );
+        r->resp[3] = r->latched_rssi;
+        r->modem_pend &= n > 1 ? cmd[1] : 0;
+        break;
+    case GET_CHIP_STATUS:
+        r->resp[0] = r->resp[1] = r->chip_pend;
+        r->chip_pend &= n > 1 ? cmd[1] : 0;
+        break;
+    case REQUEST_DEVICE_STATE:
+        r->resp[0] = r->state;
+        r->resp[1] = r->channel;
+        break;
+    case CHANGE_STATE:
+        SIM_ABORT( r );
+        if( cmd[1] == STATE_RX )    { SIM_ENTER_RX( r, SIM_RX_TUNE_NS ); }
+        else if( cmd[1] == STATE_TX ) { r->state = STATE_READY; }
+        else if( cmd[1] != STATE_NO_CHANGE )    { r->state = cmd[1]; }
+        break;
+    case START_TX:
+        SIM_ABORT( r );
+        r->prior_state = r->state == STATE_RX_TUNE ? STATE_RX : r->state;
+        r->channel = cmd[1];
+        r->tx_complete = n > 2 ? cmd[2] >> 4 : 0;
+        r->tx_len = n > 4 ? ( ( ( uint16_t )cmd[3] << 8 ) | cmd[4] ) & 0x1FFF : 0;
+        if( r->tx_len == 0 )    { r->tx_len = r->tx_count; }
+        r->state = STATE_TX_TUNE;
+        r->tune_to = STATE_TX;
+        r->tune_at = sim.now + SIM_TX_TUNE_NS;
+        break;
+    case START_RX:
+        SIM_ABORT( r );
+        memset( r->rx_args, 0, sizeof( r->rx_args ) );
+        memcpy( r->rx_args, cmd + 1, n > 8 ? 7 : n - 1 );
+        r->channel = cmd[1];
+        SIM_ENTER_RX( r, SIM_RX_TUNE_NS );
+        break;
+    case RX_HOP:
+        if( r->state != STATE_RX || n < 7 )
+        {
+            SIM_CHIP_ERROR( r, CHIP_CMD_ERROR );
+            break;
+        }
+        SIM_ABORT( r );
+        r->channel = SIM_HOP_CHANNEL( r, cmd + 1 );
+        SIM_ENTER_RX( r, SIM_HOP_NS );
+        break;
+    default:
+        SIM_CHIP_ERROR( r, CHIP_CMD_ERROR );
+        break;
+    }
+    SIM_IRQ_UPDATE( r );
+}
+/*
+=================================================================================
+-----------------------------Board and SPI0 functions----------------------------
+=================================================================================
+*/
+INT8U SPI_ExchangeByte( INT8U input )
+{
+    SIM_RADIO *r = &sim.radio[sim.cur];
+    INT8U output = 0xFF;
+    uint16_t index;
+
+    SIM_ADVANCE( sim.now + SIM_SPI_BYTE_NS );
+    if( !r->selected || r->shutdown )   { return 0xFF; }
+
+    r->stats.spi_bytes ++;
+    r->stats.bus_ns += SIM_SPI_BYTE_NS;
+    index = r->nbytes ++;
+    if( index == 0 )
+    {
+        r->cmd[0] = input;
+        r->busy = sim.now < r->cts_at;
+        return 0xFF;
+    }
+    switch( r->cmd[0] )
+    {
+    case READ_CMD_BUFF:
+        if( index == 1 )
+        {
+            r->read_cts = sim.now >= r->cts_at;
+            output = r->read_cts ? 0xFF : 0x00;
+        }
+        else if( r->read_cts && index - 2u < sizeof( r->resp ) )
+        {
+            output = r->resp[index - 2];
+        }
+        break;
+    case FRR_A_READ:    if( index <= 4 ) { output = SIM_FRR( r, index - 1 ); }   break;
+    case FRR_B_READ:    if( index <= 3 ) { output = SIM_FRR( r, index ); }       break;
+    case FRR_C_READ:    if( index <= 2 ) { output = SIM_FRR( r, index + 1 ); }   break;
+    case FRR_D_READ:    if( index <= 1 ) { output = SIM_FRR( r, 3 ); }           break;
+    case WRITE_TX_FIFO: SIM_TX_PUSH( r, input );    break;
+    case READ_RX_FIFO:  output = SIM_RX_POP( r );   break;
+    default:
+        if( index < sizeof( r->cmd ) )  { r->cmd[index] = input; }
+        break;
+    }
+    return output;
+}
+void SPI_ExchangeBlock( const INT8U *txbuf, INT8U *rxbuf, INT16U size,
+                        SPI_BLOCK_CALLBACK callback )
+{
+    INT8U rx;
+
+    while( size -- )
+    {
+        rx = SPI_ExchangeByte( txbuf ? *txbuf++ : 0xFF );
+        if( rxbuf ) { *rxbuf++ = rx; }
+    }
+    if( callback )  { callback( ); }
+}
+void SPI0_nss_clear( void )
+{
+    SIM_RADIO *r = &sim.radio[sim.cur];
+
+    if( r->selected )   { return; }
+    r->selected = true;
+    r->nbytes = 0;
+    r->stats.transactions ++;
+}
+void SPI0_nss_set( void )
+{
+    SIM_RADIO *r = &sim.radio[sim.cur];
+    uint8_t op = r->cmd[0];
+
+    if( !r->selected )  { return; }
+    r->selected = false;
+    if( r->nbytes == 0 || r->shutdown ) { return; }
+    if( op == READ_CMD_BUFF || op == FRR_A_READ || op == FRR_B_READ || op == FRR_C_READ ||
+        op == FRR_D_READ || op == WRITE_TX_FIFO || op == READ_RX_FIFO )
+    {
+        return;
+    }
+    SIM_EXECUTE( r, r->cmd, r->nbytes < sizeof( r->cmd ) ? r->nbytes : sizeof( r->cmd ) );
+}
+int32_t GPIOPinRead( uint32_t ui32Port, uint8_t ui8Pins )
+{
+    SIM_RADIO *r = &sim.radio[sim.cur];
+    int32_t pins = 0;
+
+    ( void )ui32Port;
+    if( !r->shutdown && sim.now >= r->cts_at )  { pins |= SI4463_CTS_PIN; }
+    if( !r->nirq_low )                          { pins |= SI4463_IRQ_PIN; }
+    return pins & ui8Pins;
+}
+void GPIOPinWrite( uint32_t ui32Port, uint8_t ui8Pins, uint8_t ui8Val )
+{
+    SIM_RADIO *r = &sim.radio[sim.cur];
+
+    ( void )ui32Port;
+    if( !( ui8Pins & SI4463_SDN_PIN ) ) { return; }
+    if( ui8Val & SI4463_SDN_PIN )
+    {
+        SIM_ABORT( r );
+        r->shutdown = true;
+        r->nirq_low = false;
+    }
+    else if( r->shutdown )
+    {
+        SIM_POWER_ON( r );
+    }
+}
+void UARTprintf( const char *pcString, ... )
+{
+    va_list args;
+
+    va_start( args, pcString );
+    vprintf( pcString, args );
+    va_end( args );
+}
+int UARTFlushTx( bool bDiscard )
+{
+    ( void )bDiscard;
+    fflush( stdout );
+    return 0;
+}
+void Si4463_DMA_INIT( void )        { }
+void Si4463_SSI_IntHandler( void )  { }
+void Si4463_SPI_INIT( void )        { }
+void Si4463_GPIO_INIT( void )       { }
+void Si4463_GPIO_IntHandler( void ) { }
+void Si4463_CYCLES_INIT( void )     { }
+/*
+=================================================================================
+-----------------------------------Radio buses-----------------------------------
+=================================================================================
+*/
+/*Bus 0 follows SI446X_SIM_SELECT( ), the others are wired to one radio each*/
+SI4463_BUS g_sSi4463Bus0;
+static SI4463_BUS sim_bus[SI446X_SIM_RADIOS];
+
+/*Point the board functions above at the radio of a bus, returns the previous*/
+static uint8_t SIM_BUS_ENTER( SI4463_BUS *bus )
+{
+    uint8_t saved = sim.cur;
+
+    if( bus != &g_sSi4463Bus0 ) { sim.cur = ( uint8_t )( bus - sim_bus ); }
+    return saved;
+}
+
+/*Slot of a bus in sim.dma*/
+static uint8_t SIM_BUS_INDEX( SI4463_BUS *bus )
+{
+    return bus == &g_sSi4463Bus0 ? SI446X_SIM_RADIOS : ( uint8_t )( bus - sim_bus );
+}
+
+/*End the block in flight on a bus, if any: its bytes go out, then its callback runs*/
+static void SIM_DMA_END( SI4463_BUS *bus )
+{
+    uint8_t n = SIM_BUS_INDEX( bus ), saved;
+
+    if( !bus->dma_busy )    { return; }
+    saved = SIM_BUS_ENTER( bus );
+    SPI_ExchangeBlock( sim.dma[n].txbuf, sim.dma[n].rxbuf, sim.dma[n].size, NULL );
+    sim.cur = saved;
+    bus->dma_busy = BOOL_FALSE;
+    sim.dma[n].callback( );
+}
+void Si4463_BUS_INIT( SI4463_BUS *bus )             { ( void )bus; }
+void Si4463_BUS_GPIO_IntHandler( SI4463_BUS *bus )  { ( void )bus; }
+void Si4463_BUS_SSI_IntHandler( SI4463_BUS *bus )   { ( void )bus; }
+void Si4463_BUS_WAIT( SI4463_BUS *bus )             { SIM_DMA_END( bus ); }
+
+INT8U Si4463_BUS_BYTE( SI4463_BUS *bus, INT8U input )
+{
+    uint8_t saved = SIM_BUS_ENTER( bus );
+
+    // The CPU takes the SSI from a block in flight: the block's bytes go
+    // after this one, as the two would interleave on the board
+    if( bus->dma_busy ) { sim.radio[sim.cur].stats.dma_conflicts ++; }
+    input = SPI_ExchangeByte( input );
+    sim.cur = saved;
+    SIM_DMA_END( bus );
+    return input;
+}
+void Si4463_BUS_BLOCK( SI4463_BUS *bus, const INT8U *txbuf, INT8U *rxbuf, INT16U size,
+                       SPI_BLOCK_CALLBACK callback )
+{
+    uint8_t saved, n = SIM_BUS_INDEX( bus );
+
+    // board.c waits for the block in flight, whatever the size of this one
+    SIM_DMA_END( bus );
+    if( sim.dma_async && callback && size >= SPI_DMA_MIN_BLOCK )
+    {
+        sim.dma[n].txbuf = txbuf;
+        sim.dma[n].rxbuf = rxbuf;
+        sim.dma[n].size = size;
+        sim.dma[n].callback = callback;
+        bus->dma_busy = BOOL_TRUE;
+        return;
+    }
+    saved = SIM_BUS_ENTER( bus );
+    SPI_ExchangeBlock( txbuf, rxbuf, size, NULL );
+    sim.cur = saved;
+    if( callback )  { callback( ); }
+}
+void Si4463_BUS_CSN( SI4463_BUS *bus, BOOLEAN high )
+{
+    uint8_t saved = SIM_BUS_ENTER( bus );
+
+    if( bus->dma_busy ) { sim.radio[sim.cur].stats.dma_conflicts ++; }
+    if( high )  { SPI0_nss_set( ); }
+    else        { SPI0_nss_clear( ); }
+    sim.cur = saved;
+    SIM_DMA_END( bus );
+}
+void Si4463_BUS_SDN( SI4463_BUS *bus, BOOLEAN high )
+{
+    uint8_t saved = SIM_BUS_ENTER( bus );
+
+    GPIOPinWrite( SI4463_SDN_PORT, SI4463_SDN_PIN, high ? SI4463_SDN_PIN : 0 );
+    sim.cur = saved;
+}
+BOOLEAN Si4463_BUS_CTS( SI4463_BUS *bus )
+{
+    uint8_t saved = SIM_BUS_ENTER( bus );
+    BOOLEAN cts = GPIOPinRead( SI4463_CTS_PORT, SI4463_CTS_PIN ) ? BOOL_TRUE : BOOL_FALSE;
+
+    sim.cur = saved;
+    return cts;
+}
+void Si4463_BUS_IRQ_INIT( SI4463_BUS *bus, SI4463_BUS_CALLBACK callback, void *arg )
+{
+    uint8_t saved = SIM_BUS_ENTER( bus );
+    SIM_RADIO *r = &sim.radio[sim.cur];
+
+    sim.cur = saved;
+    r->irq = callback;
+    r->irq_arg = arg;
+    SIM_IRQ_DISPATCH( r );
+}
+void Si4463_BUS_IRQ_MASK( SI4463_BUS *bus, BOOLEAN mask )
+{
+    uint8_t saved = SIM_BUS_ENTER( bus );
+    SIM_RADIO *r = &sim.radio[sim.cur];
+
+    sim.cur = saved;
+    r->irq_masked = mask;
+    if( !mask ) { SIM_IRQ_DISPATCH( r ); }
+}
+/*The core sleeps until CTS rises*/
+void Si4463_BUS_CTS_IDLE( SI4463_BUS *bus )
+{
+    uint8_t saved = SIM_BUS_ENTER( bus );
+    SIM_RADIO *r = &sim.radio[sim.cur];
+    uint64_t until = r->cts_at > sim.now ? r->cts_at : sim.now + 1000;
+
+    sim.cur = saved;
+    r->stats.cts_wait_ns += until - sim.now;
+    SIM_ADVANCE( until );
+    bus->cts_edge = BOOL_FALSE;
+}
+/*The core sleeps until an interrupt, the nIRQ handlers run as it wakes*/
+void Si4463_BUS_IRQ_IDLE( SI4463_BUS *bus, volatile const INT8U *events )
+{
+    uint8_t i;
+
+    if( *events )   { return; }
+    SIM_ADVANCE( sim.now + 1000 );
+    for( i = 0; i < sim.radios; i ++ )  { SIM_IRQ_DISPATCH( &sim.radio[i] ); }
+}
+/*
+=================================================================================
+---------------------------------Simulation control------------------------------
+=================================================================================
+*/
+void SI446X_SIM_INIT( uint8_t radios, uint32_t seed )
+{
+    uint8_t i, j;
+
+    memset( &sim, 0, sizeof( sim ) );
+    g_sSi4463Bus0.dma_busy = BOOL_FALSE;
+    for( i = 0; i < SI446X_SIM_RADIOS; i ++ )   { sim_bus[i].dma_busy = BOOL_FALSE; }
+    sim.radios = radios > SI446X_SIM_RADIOS ? SI446X_SIM_RADIOS : radios;
+    sim.seed = seed ? seed : 1;
+    sim.byte_ns = 8000000000ULL / 10000;
+    memset( sim.noise, SIM_NOISE_RSSI, sizeof( sim.noise ) );
+    for( i = 0; i < SI446X_SIM_RADIOS; i ++ )
+    {
+        sim.radio[i].shutdown = true;
+        sim.radio[i].rx_src = -1;
+        for( j = 0; j < SI446X_SIM_RADIOS; j ++ )   { sim.link[i][j].rssi = SIM_LINK_RSSI; }
+    }
+}
+void SI446X_SIM_SELECT( uint8_t radio )
+{
+    if( radio < sim.radios )    { sim.cur = radio; }
+}
+uint8_t SI446X_SIM_SELECTED( void )
+{
+    return sim.cur;
+}
+SI4463_BUS *SI446X_SIM_BUS( uint8_t radio )
+{
+    return &sim_bus[radio < SI446X_SIM_RADIOS ? radio : 0];
+}
+uint64_t SI446X_SIM_NOW( void )
+{
+    return sim.now;
+}
+uint32_t SI446X_SIM_CYCLES( void )
+{
+    // Reading the counter takes a few cycles, so spin loops see time pass
+    SIM_ADVANCE( sim.now + 25 );
+    return ( uint32_t )( sim.now * ( SI446X_SIM_SYSCLK_HZ / 1000000 ) / 1000 );
+}
+void SI446X_SIM_RUN( uint32_t us )
+{
+    uint64_t until = sim.now + ( uint64_t )us * 1000;
+    uint64_t step;
+    uint8_t i;
+
+    // Step in slices short enough that handlers run close to their edges
+    while( sim.now < until )
+    {
+        step = until - sim.now < 10000 ? until - sim.now : 10000;
+        SIM_ADVANCE( sim.now + step );
+        for( i = 0; i < sim.radios; i ++ )  { SIM_IRQ_DISPATCH( &sim.radio[i] ); }
+    }
+}
+void SI446X_SIM_INJECT( uint8_t channel, const uint8_t *frame, uint16_t size,
+                        uint8_t rssi, bool corrupt )
+{
+    SIM_FRAME *f;
+
+    if( sim.q_count == SI446X_SIM_INJECT_QUEUE || size == 0 || size > sizeof( f->data ) )
+    {
+        return;
+    }
+    f = &sim.queue[( sim.q_head + sim.q_count ) % SI446X_SIM_INJECT_QUEUE];
+    f->channel = channel;
+    f->rssi = rssi;
+    f->corrupt = corrupt;
+    f->size = size;
+    memcpy( f->data, frame, size );
+    sim.q_count ++;
+}
+void SI446X_SIM_LOSS( uint8_t percent )
+{
+    sim.loss = percent;
+}
+void SI446X_SIM_DMA_ASYNC( bool on )
+{
+    sim.dma_async = on;
+}
+void SI446X_SIM_LINK( uint8_t a, uint8_t b, uint8_t rssi, uint8_t loss )
+{
+    if( a >= SI446X_SIM_RADIOS || b >= SI446X_SIM_RADIOS )  { return; }
+    sim.link[a][b].rssi = sim.link[b][a].rssi = rssi;
+    sim.link[a][b].loss = sim.link[b][a].loss = loss;
+}
+void SI446X_SIM_BITRATE( uint32_t bps )
+{
+    if( bps )   { sim.byte_ns = 8000000000ULL / bps; }
+}
+uint16_t SI446X_SIM_LAST_FRAME( uint8_t *frame )
+{
+    uint8_t src = sim.cur;
+
+    memcpy( frame, sim.air[src].frame, sim.air[src].size );
+    return sim.air[src].size;
+}
+void SI446X_SIM_NOISE( uint8_t channel, uint8_t rssi )
+{
+    sim.noise[channel % SI446X_SIM_CHANNELS] = rssi;
+}
+uint8_t SI446X_SIM_STATE( void )
+{
+    return sim.radio[sim.cur].state;
+}
+const SI446X_SIM_STATS *SI446X_SIM_STATS_GET( void )
+{
+    return &sim.radio[sim.cur].stats;
+}
+void SI446X_SIM_STATS_CLEAR( void )
+{
+    memset( &sim.radio[sim.cur].stats, 0, sizeof( SI446X_SIM_STATS ) );
+}
+void SI446X_SIM_RADIO_UP( SI446X_DEV *radio, uint8_t index )
+{
+    SI446X_DEV_INIT( radio, SI446X_SIM_BUS( index ), NULL );
+    SI446X_DEV_RESET( radio );
+    SI446X_DEV_CONFIG_INIT( radio );
+}
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/
@@ -0,0 +1,135 @@
+/*
+================================================================================
+Function : Host simulation of the Si4463 and of the board functions it uses
+================================================================================
+*/
+#ifndef _SI446X_SIM_H_
+#define _SI446X_SIM_H_
+
+/*
+Built with SI446X_SIM defined, Board.h takes its TivaWare names from here and
+si446x_sim.c stands in for board.c, the SPI0 driver and the radio itself, so
+si446x.c runs unchanged on a Linux host:
+
+    gcc -std=c99 -O2 -DSI446X_SIM -I. -o si446x_bench \
+        si446x_bench.c si446x_sim.c si446x.c
+
+The model covers the SPI command protocol (CTS, READ_CMD_BUFF, FRRs, FIFO
+access), the property table, both 64 byte FIFOs with their thresholds, the
+START_TX/START_RX/RX_HOP state machine, the packet handler and modem
+interrupts and nIRQ. Time is virtual: it moves with every SPI byte, while the
+driver idles for CTS and in SI446X_SIM_RUN, and Si4463_CYCLES( ) counts it at
+g_ui32SysClock. Several radios share one medium, with per frame loss and
+collisions, so both ends of a link can be driven from one process; the range
+and loss between each pair of radios can be set for multi-hop topologies.
+
+Command times, tune times and the power on reset are rough figures for a
+Si4463 rev B1 at 30 MHz; absolute numbers are indicative, comparisons between
+driver paths are what the model is for.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+/*TivaWare names used by the driver*/
+#define GPIO_PORTG_BASE     0x40066000
+#define GPIO_PIN_0          0x01
+#define GPIO_PIN_1          0x02
+#define GPIO_PIN_2          0x04
+#define GPIO_PIN_3          0x08
+#define GPIO_PIN_4          0x10
+#define GPIO_PIN_5          0x20
+#define GPIO_PIN_6          0x40
+#define GPIO_PIN_7          0x80
+
+int32_t GPIOPinRead( uint32_t ui32Port, uint8_t ui8Pins );
+void GPIOPinWrite( uint32_t ui32Port, uint8_t ui8Pins, uint8_t ui8Val );
+void SPI0_nss_set( void );
+void SPI0_nss_clear( void );
+void UARTprintf( const char *pcString, ... );
+int UARTFlushTx( bool bDiscard );
+
+/*Frame size of the application, normally from ../global.h*/
+#ifndef VMX_MAX_BUFFER
+#define VMX_MAX_BUFFER      56
+#endif
+
+#define SI446X_SIM_RADIOS       8       //radios on the medium
+#define SI446X_SIM_CHANNELS     64      //channels with their own noise floor
+#define SI446X_SIM_INJECT_QUEUE 8       //frames waiting to be injected
+#define SI446X_SIM_SPI_HZ       8000000 //SPI clock of Si4463_SPI_INIT
+#define SI446X_SIM_SYSCLK_HZ    120000000
+
+/*Counters of one simulated radio*/
+typedef struct
+{
+    uint32_t spi_bytes;         //bytes clocked while selected
+    uint32_t transactions;      //chip select windows
+    uint32_t commands;          //commands which need CTS, READ_CMD_BUFF excluded
+    uint32_t busy_commands;     //commands sent while CTS was low, ignored by the radio
+    uint32_t fifo_errors;       //TX underflows and RX overflows
+    uint32_t frames_sent;
+    uint32_t frames_received;   //PACKET_RX raised
+    uint32_t frames_bad;        //collisions and corrupted frames, CRC_ERROR if checked
+    uint32_t frames_lost;       //frames this radio did not catch
+    uint32_t frames_filtered;   //frames dropped by the packet match
+    uint64_t bus_ns;            //time with the chip selected
+    uint64_t cts_wait_ns;       //time the driver idled for CTS
+    uint32_t dma_conflicts;     //byte or chip select accesses while a block was in flight
+}SI446X_SIM_STATS;
+
+/*reset the simulation, all radios off*/
+void SI446X_SIM_INIT( uint8_t radios, uint32_t seed );
+
+/*radio the SPI and GPIO calls go to*/
+void SI446X_SIM_SELECT( uint8_t radio );
+uint8_t SI446X_SIM_SELECTED( void );
+
+/*simulated time, ns, and as CPU cycles*/
+uint64_t SI446X_SIM_NOW( void );
+uint32_t SI446X_SIM_CYCLES( void );
+
+/*let time pass, nIRQ handlers run as their edges arrive*/
+void SI446X_SIM_RUN( uint32_t us );
+
+/*put a frame on the air from outside; frame is the TX FIFO image*/
+void SI446X_SIM_INJECT( uint8_t channel, const uint8_t *frame, uint16_t size,
+                        uint8_t rssi, bool corrupt );
+
+/*frames lost per receiver, percent*/
+void SI446X_SIM_LOSS( uint8_t percent );
+
+/*leave a block sent with a callback in flight, dma_busy set, until Si4463_BUS_WAIT
+or the next access of its bus, as the uDMA would; off after SI446X_SIM_INIT*/
+void SI446X_SIM_DMA_ASYNC( bool on );
+
+/*what radios a and b hear of each other: raw RSSI, 0 out of range, and frame
+loss in percent; every radio hears every other one at -34 dBm by default*/
+void SI446X_SIM_LINK( uint8_t a, uint8_t b, uint8_t rssi, uint8_t loss );
+
+/*air bit rate, bps*/
+void SI446X_SIM_BITRATE( uint32_t bps );
+
+/*last frame the selected radio put on the air, as its TX FIFO image*/
+uint16_t SI446X_SIM_LAST_FRAME( uint8_t *frame );
+
+/*raw RSSI seen on an idle channel*/
+void SI446X_SIM_NOISE( uint8_t channel, uint8_t rssi );
+
+/*state of the selected radio, without SPI traffic*/
+uint8_t SI446X_SIM_STATE( void );
+
+/*counters of the selected radio*/
+const SI446X_SIM_STATS *SI446X_SIM_STATS_GET( void );
+void SI446X_SIM_STATS_CLEAR( void );
+
+#endif //_SI446X_SIM_H_
+
+/*
+=================================================================================
+------------------------------------End of FILE----------------------------------
+=================================================================================
+*/